@@ -0,0 +1,106 @@
+"""Measures cache misses per similarity search with and without locality=True.
+
+    python benchmarks/cache_misses.py [words.txt] [--queries N] [--cost C]
+
+Each layout is written to a file and searched in a child process under
+`perf stat`; misses of a run without searches are subtracted. Needs perf and
+access to hardware counters (see /proc/sys/kernel/perf_event_paranoid).
+"""
+from __future__ import print_function
+
+import argparse
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+
+import simtrie
+
+from layouts import random_keys
+
+LAYOUTS = [
+    ("double array", {}),
+    ("locality", {"locality": True}),
+    ("interleaved", {"interleaved": True}),
+    ("both", {"locality": True, "interleaved": True}),
+]
+
+EVENTS = "cache-references,cache-misses,dTLB-load-misses"
+
+SEARCH = """
+import sys, simtrie
+s = simtrie.open(sys.argv[1])
+queries = open(sys.argv[2], encoding="utf8").read().split("\\n")
+cost = float(sys.argv[3])
+for key in queries[:int(sys.argv[4])]:
+    for _ in s.similar(key, cost):
+        pass
+"""
+
+
+def perf_stat(path, queries_path, cost, num_of_queries):
+    # returns counts of EVENTS for a child process that searches a file.
+    result = subprocess.run(
+        ["perf", "stat", "-x", ",", "-e", EVENTS, sys.executable, "-c", SEARCH,
+         path, queries_path, str(cost), str(num_of_queries)],
+        stderr=subprocess.PIPE, universal_newlines=True, check=True)
+    counts = {}
+    for line in result.stderr.splitlines():
+        fields = line.split(",")
+        if len(fields) > 2 and fields[0].isdigit():
+            counts[fields[2]] = int(fields[0])
+    return counts
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("words", nargs="?", help="file with one key per line")
+    parser.add_argument("--keys", type=int, default=1000000,
+                        help="number of random keys without a word list")
+    parser.add_argument("--queries", type=int, default=1000,
+                        help="number of similarity searches")
+    parser.add_argument("--cost", type=float, default=1,
+                        help="maximum cost of similarity searches")
+    args = parser.parse_args()
+
+    if shutil.which("perf") is None:
+        sys.exit("perf is needed to count cache misses")
+
+    if args.words:
+        with open(args.words, encoding="utf8") as f:
+            keys = set(line.rstrip("\n") for line in f if line.strip())
+    else:
+        keys = random_keys(args.keys)
+    keys = sorted(keys)
+    searches = random.Random(1).sample(keys, min(len(keys), args.queries))
+
+    tmp_dir = tempfile.mkdtemp()
+    try:
+        queries_path = os.path.join(tmp_dir, "queries.txt")
+        with open(queries_path, "w", encoding="utf8") as f:
+            f.write("\n".join(searches))
+
+        print("%d keys, %d searches up to cost %g" % (
+            len(keys), len(searches), args.cost))
+        print("%-14s %10s %14s %14s %14s" % (
+            "layout", "bytes", "references/q", "misses/q", "TLB misses/q"))
+        for name, options in LAYOUTS:
+            path = os.path.join(tmp_dir, "set")
+            with open(path, "wb") as f:
+                simtrie.Set(keys, sorted=True, **options).dump(f)
+            base = perf_stat(path, queries_path, args.cost, 0)
+            counts = perf_stat(path, queries_path, args.cost, len(searches))
+            per_query = [
+                float(counts.get(event, 0) - base.get(event, 0)) / len(searches)
+                for event in EVENTS.split(",")]
+            print("%-14s %10d %14.0f %14.0f %14.0f" % (
+                name, os.path.getsize(path), per_query[0], per_query[1],
+                per_query[2]))
+    finally:
+        shutil.rmtree(tmp_dir)
+
+
+if __name__ == "__main__":
+    main()
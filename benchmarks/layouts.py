@@ -0,0 +1,74 @@
+"""Compares memory and speed of the layouts a Set can be stored in.
+
+    python benchmarks/layouts.py [words.txt] [--queries N]
+
+Without a word list, random keys are generated.
+"""
+from __future__ import print_function
+
+import argparse
+import random
+import time
+
+import simtrie
+
+LAYOUTS = [
+    ("double array", {}),
+    ("wide", {"wide": True}),
+    ("locality", {"locality": True}),
+    ("interleaved", {"interleaved": True}),
+    ("both", {"locality": True, "interleaved": True}),
+    ("succinct", {"succinct": True}),
+]
+
+
+def random_keys(n, seed=0):
+    rng = random.Random(seed)
+    alphabet = "abcdefghijklmnopqrstuvwxyz"
+    return set("".join(rng.choice(alphabet) for _ in range(rng.randint(3, 12)))
+               for _ in range(n))
+
+
+def timed(f):
+    start = time.perf_counter()
+    result = f()
+    return time.perf_counter() - start, result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("words", nargs="?", help="file with one key per line")
+    parser.add_argument("--keys", type=int, default=200000,
+                        help="number of random keys without a word list")
+    parser.add_argument("--queries", type=int, default=200,
+                        help="number of similarity searches")
+    args = parser.parse_args()
+
+    if args.words:
+        with open(args.words, encoding="utf8") as f:
+            keys = set(line.rstrip("\n") for line in f if line.strip())
+    else:
+        keys = random_keys(args.keys)
+    keys = sorted(keys)
+    rng = random.Random(1)
+    lookups = rng.sample(keys, min(len(keys), 100000))
+    searches = rng.sample(keys, min(len(keys), args.queries))
+
+    print("%d keys" % len(keys))
+    print("%-14s %10s %9s %12s %12s %12s %12s" % (
+        "layout", "bytes", "build s", "contains/s", "batch/s", "keys/s",
+        "similar/s"))
+    for name, options in LAYOUTS:
+        build, s = timed(lambda: simtrie.Set(keys, sorted=True, **options))
+        size = len(s.tobytes())
+        contains, _ = timed(lambda: sum(1 for key in lookups if key in s))
+        batch, _ = timed(lambda: s.contains_many(lookups))
+        iterate, _ = timed(lambda: sum(1 for _ in s.keys()))
+        similar, _ = timed(lambda: [list(s.similar(key, 1)) for key in searches])
+        print("%-14s %10d %9.2f %12.0f %12.0f %12.0f %12.1f" % (
+            name, size, build, len(lookups) / contains, len(lookups) / batch,
+            len(keys) / iterate, len(searches) / similar))
+
+
+if __name__ == "__main__":
+    main()
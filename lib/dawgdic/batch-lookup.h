@@ -0,0 +1,180 @@
+#ifndef DAWGDIC_BATCH_LOOKUP_H
+#define DAWGDIC_BATCH_LOOKUP_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "base-types.h"
+#include "dictionary.h"
+#include "louds.h"
+
+namespace dawgdic {
+
+// Exact matching of many keys at once. Each transition of a lookup loads
+// a unit whose index depends on the unit before, so a single lookup
+// waits for memory on every byte of a key. Here several lookups are in
+// flight: a step advances one of them by a transition and prefetches the
+// unit it moves to, then turns to the next, so that the loads of all of
+// them overlap (asynchronous memory access chaining).
+//
+// Keys are given as one array of bytes, in which key i takes the bytes
+// from offsets[i] up to offsets[i + 1].
+class BatchLookup {
+ public:
+  enum {
+    // Number of lookups in flight.
+    DEFAULT_WIDTH = 16
+  };
+
+  // Checks which keys a dictionary contains.
+  template <typename Unit>
+  static void Contains(const BasicDictionary<Unit> &dic, const CharType *keys,
+                       const SizeType *offsets, SizeType num_of_keys,
+                       bool *found, SizeType width = DEFAULT_WIDTH) {
+    Lookup<Unit>(dic, keys, offsets, num_of_keys, found,
+                 static_cast<int64_t *>(NULL), width);
+  }
+  // Finds the values of keys, or -1 for keys not found.
+  template <typename Unit>
+  static void Find(const BasicDictionary<Unit> &dic, const CharType *keys,
+                   const SizeType *offsets, SizeType num_of_keys,
+                   int64_t *values, SizeType width = DEFAULT_WIDTH) {
+    Lookup<Unit>(dic, keys, offsets, num_of_keys, static_cast<bool *>(NULL),
+                 values, width);
+  }
+
+  // A LOUDS trie looks up keys one after another, as finding a child
+  // takes several dependent loads within its bit vectors.
+  static void Contains(const Louds &louds, const CharType *keys,
+                       const SizeType *offsets, SizeType num_of_keys,
+                       bool *found, SizeType = DEFAULT_WIDTH) {
+    for (SizeType i = 0; i < num_of_keys; ++i) {
+      found[i] = louds.Contains(keys + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+  }
+  static void Find(const Louds &louds, const CharType *keys,
+                   const SizeType *offsets, SizeType num_of_keys,
+                   int64_t *values, SizeType = DEFAULT_WIDTH) {
+    for (SizeType i = 0; i < num_of_keys; ++i) {
+      values[i] = louds.Find(keys + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+  }
+
+ private:
+  enum State {
+    // The unit at index is where the lookup is.
+    AT_UNIT,
+    // The unit at index is reached if its label matches.
+    CHECK_LABEL,
+    // The unit at index holds the value of the key.
+    AT_VALUE
+  };
+
+  template <typename Unit>
+  struct Cursor {
+    typename Unit::IndexType index;
+    SizeType key_id;
+    SizeType pos;
+    UCharType label;
+    State state;
+  };
+
+  // Disallows copies.
+  BatchLookup(const BatchLookup &);
+  BatchLookup &operator=(const BatchLookup &);
+
+  // Either found or values is given.
+  template <typename Unit>
+  static void Lookup(const BasicDictionary<Unit> &dic, const CharType *keys,
+                     const SizeType *offsets, SizeType num_of_keys,
+                     bool *found, int64_t *values, SizeType width) {
+    if (dic.size() == 0) {
+      for (SizeType i = 0; i < num_of_keys; ++i) {
+        Finish(i, false, -1, found, values);
+      }
+      return;
+    }
+
+    std::vector<Cursor<Unit> > cursors(width != 0 ? width : 1);
+    SizeType num_of_cursors = 0;
+    SizeType next_key_id = 0;
+    while (num_of_cursors < cursors.size() && next_key_id < num_of_keys) {
+      Start(dic, offsets, next_key_id++, &cursors[num_of_cursors++]);
+    }
+
+    while (num_of_cursors != 0) {
+      for (SizeType i = 0; i < num_of_cursors; ) {
+        if (!Step(dic, keys, offsets, &cursors[i], found, values)) {
+          ++i;
+        } else if (next_key_id < num_of_keys) {
+          Start(dic, offsets, next_key_id++, &cursors[i++]);
+        } else {
+          cursors[i] = cursors[--num_of_cursors];
+        }
+      }
+    }
+  }
+
+  template <typename Unit>
+  static void Start(const BasicDictionary<Unit> &dic, const SizeType *offsets,
+                    SizeType key_id, Cursor<Unit> *cursor) {
+    cursor->index = dic.root();
+    cursor->key_id = key_id;
+    cursor->pos = offsets[key_id];
+    cursor->label = '\0';
+    cursor->state = AT_UNIT;
+  }
+
+  // Advances a lookup by a load, and returns true when it is finished.
+  template <typename Unit>
+  static bool Step(const BasicDictionary<Unit> &dic, const CharType *keys,
+                   const SizeType *offsets, Cursor<Unit> *cursor,
+                   bool *found, int64_t *values) {
+    const Unit &unit = dic.units()[cursor->index];
+    if (cursor->state == AT_VALUE) {
+      Finish(cursor->key_id, true, unit.value(), found, values);
+      return true;
+    }
+    if (cursor->state == CHECK_LABEL && unit.label() != cursor->label) {
+      Finish(cursor->key_id, false, -1, found, values);
+      return true;
+    }
+
+    if (cursor->pos == offsets[cursor->key_id + 1]) {
+      if (!unit.has_leaf() || values == NULL) {
+        Finish(cursor->key_id, unit.has_leaf(), -1, found, values);
+        return true;
+      }
+      cursor->index ^= unit.offset();
+      cursor->state = AT_VALUE;
+    } else {
+      cursor->label = static_cast<UCharType>(keys[cursor->pos++]);
+      cursor->index ^= unit.offset() ^ cursor->label;
+      cursor->state = CHECK_LABEL;
+    }
+    Prefetch(dic.units() + cursor->index);
+    return false;
+  }
+
+  static void Finish(SizeType key_id, bool is_found, int64_t value,
+                     bool *found, int64_t *values) {
+    if (found != NULL) {
+      found[key_id] = is_found;
+    } else {
+      values[key_id] = is_found ? value : -1;
+    }
+  }
+
+  static void Prefetch(const void *address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#else
+    static_cast<void>(address);
+#endif
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_BATCH_LOOKUP_H
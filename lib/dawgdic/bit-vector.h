@@ -0,0 +1,189 @@
+#ifndef DAWGDIC_BIT_VECTOR_H
+#define DAWGDIC_BIT_VECTOR_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "base-types.h"
+
+namespace dawgdic {
+
+// Read-only bit vector with rank and select. It is stored in 64-bit words,
+// so that it can be mapped from a file and converted between byte orders
+// word by word:
+//
+//   size, number of ones,
+//   bits (one word more than needed, so that the bit at size can be read),
+//   ones before each block of BLOCK_SIZE bits and in total,
+//   block of every SAMPLE_INTERVAL-th one and a sentinel,
+//   block of every SAMPLE_INTERVAL-th zero and a sentinel.
+class BitVector {
+ public:
+  enum {
+    BLOCK_SIZE = 512,
+    SAMPLE_INTERVAL = 512
+  };
+
+  BitVector()
+    : bits_(NULL), ranks_(NULL), ones_(NULL), zeros_(NULL), size_(0),
+      num_of_ones_(0) {}
+
+  // Number of bits.
+  SizeType size() const {
+    return size_;
+  }
+  SizeType num_of_ones() const {
+    return num_of_ones_;
+  }
+
+  bool operator[](SizeType index) const {
+    return ((bits_[index / 64] >> (index % 64)) & 1) != 0;
+  }
+
+  // Counts ones before a given position.
+  SizeType Rank1(SizeType index) const {
+    SizeType block = index / BLOCK_SIZE;
+    SizeType rank = static_cast<SizeType>(ranks_[block]);
+    for (SizeType i = block * (BLOCK_SIZE / 64); i < index / 64; ++i) {
+      rank += __builtin_popcountll(bits_[i]);
+    }
+    if (index % 64 != 0) {
+      rank += __builtin_popcountll(
+          bits_[index / 64] & ((static_cast<uint64_t>(1) << (index % 64)) - 1));
+    }
+    return rank;
+  }
+
+  // Finds the position of the index-th one or zero, counted from 0. The
+  // one or zero must exist.
+  SizeType Select1(SizeType index) const {
+    SizeType block = static_cast<SizeType>(ones_[index / SAMPLE_INTERVAL]);
+    while (ranks_[block + 1] <= index) {
+      ++block;
+    }
+    index -= static_cast<SizeType>(ranks_[block]);
+    return SelectInBlock(block, index, 0);
+  }
+  SizeType Select0(SizeType index) const {
+    SizeType block = static_cast<SizeType>(zeros_[index / SAMPLE_INTERVAL]);
+    while (Rank0OfBlock(block + 1) <= index) {
+      ++block;
+    }
+    index -= Rank0OfBlock(block);
+    return SelectInBlock(block, index, ~static_cast<uint64_t>(0));
+  }
+
+  // Maps a bit vector at the start of given words, and returns the number
+  // of words it takes, or 0 if they do not hold a valid bit vector.
+  SizeType Map(const uint64_t *words, SizeType num_of_words) {
+    *this = BitVector();
+    if (num_of_words < 2 || words[1] > words[0]) {
+      return 0;
+    }
+    SizeType size = static_cast<SizeType>(words[0]);
+    SizeType num_of_ones = static_cast<SizeType>(words[1]);
+    if (NumOfWords(size, num_of_ones) > num_of_words) {
+      return 0;
+    }
+
+    size_ = size;
+    num_of_ones_ = num_of_ones;
+    bits_ = words + 2;
+    ranks_ = bits_ + NumOfBitWords(size);
+    ones_ = ranks_ + NumOfBlocks(size) + 1;
+    zeros_ = ones_ + NumOfSamples(num_of_ones) + 1;
+    if (ranks_[NumOfBlocks(size)] != num_of_ones) {
+      *this = BitVector();
+      return 0;
+    }
+    return NumOfWords(size, num_of_ones);
+  }
+
+  // Appends a bit vector of a given size, whose bits are given in words,
+  // to words.
+  static void Build(const std::vector<uint64_t> &bits, SizeType size,
+                    std::vector<uint64_t> *words) {
+    SizeType num_of_blocks = NumOfBlocks(size);
+    std::vector<uint64_t> ranks(num_of_blocks + 1, 0);
+    std::vector<uint64_t> ones, zeros;
+    SizeType num_of_ones = 0;
+    for (SizeType i = 0; i < size; ++i) {
+      if (i % BLOCK_SIZE == 0) {
+        ranks[i / BLOCK_SIZE] = num_of_ones;
+      }
+      if ((bits[i / 64] >> (i % 64)) & 1) {
+        if (num_of_ones % SAMPLE_INTERVAL == 0) {
+          ones.push_back(i / BLOCK_SIZE);
+        }
+        ++num_of_ones;
+      } else if ((i - num_of_ones) % SAMPLE_INTERVAL == 0) {
+        zeros.push_back(i / BLOCK_SIZE);
+      }
+    }
+    ranks[num_of_blocks] = num_of_ones;
+    ones.push_back(num_of_blocks);
+    zeros.push_back(num_of_blocks);
+
+    words->push_back(size);
+    words->push_back(num_of_ones);
+    for (SizeType i = 0; i < NumOfBitWords(size); ++i) {
+      words->push_back(i < bits.size() ? bits[i] : 0);
+    }
+    words->insert(words->end(), ranks.begin(), ranks.end());
+    words->insert(words->end(), ones.begin(), ones.end());
+    words->insert(words->end(), zeros.begin(), zeros.end());
+  }
+
+  // Number of words taken by a bit vector.
+  static SizeType NumOfWords(SizeType size, SizeType num_of_ones) {
+    return 2 + NumOfBitWords(size) + NumOfBlocks(size) + 1 +
+        NumOfSamples(num_of_ones) + 1 + NumOfSamples(size - num_of_ones) + 1;
+  }
+
+ private:
+  const uint64_t *bits_;
+  const uint64_t *ranks_;
+  const uint64_t *ones_;
+  const uint64_t *zeros_;
+  SizeType size_;
+  SizeType num_of_ones_;
+
+  // Copyable.
+
+  SizeType Rank0OfBlock(SizeType block) const {
+    return block * BLOCK_SIZE - static_cast<SizeType>(ranks_[block]);
+  }
+
+  // Finds the index-th one of a block, or the index-th zero if flip is all
+  // ones.
+  SizeType SelectInBlock(SizeType block, SizeType index, uint64_t flip) const {
+    SizeType i = block * (BLOCK_SIZE / 64);
+    for ( ; ; ++i) {
+      SizeType count = __builtin_popcountll(bits_[i] ^ flip);
+      if (index < count) {
+        break;
+      }
+      index -= count;
+    }
+    uint64_t word = bits_[i] ^ flip;
+    for ( ; index > 0; --index) {
+      word &= word - 1;
+    }
+    return i * 64 + __builtin_ctzll(word);
+  }
+
+  static SizeType NumOfBitWords(SizeType size) {
+    return size / 64 + 1;
+  }
+  static SizeType NumOfBlocks(SizeType size) {
+    return (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  }
+  static SizeType NumOfSamples(SizeType count) {
+    return (count + SAMPLE_INTERVAL - 1) / SAMPLE_INTERVAL;
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_BIT_VECTOR_H
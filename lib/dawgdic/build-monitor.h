@@ -0,0 +1,65 @@
+#ifndef DAWGDIC_BUILD_MONITOR_H
+#define DAWGDIC_BUILD_MONITOR_H
+
+#include <atomic>
+
+#include "base-types.h"
+
+namespace dawgdic {
+
+// Lets another thread follow a build and cancel it. Builders count what
+// they have done so far, and stop and return false once the build has been
+// cancelled. Counts are added in batches, so that builder threads do not
+// contend for them and they may lag behind a little.
+class BuildMonitor {
+ public:
+  enum {
+    // Number of keys between updates.
+    KEY_INTERVAL = 1 << 12
+  };
+
+  BuildMonitor() : num_of_keys_(0), num_of_units_(0), is_cancelled_(false) {}
+
+  // Number of keys inserted into a dawg.
+  SizeType num_of_keys() const {
+    return num_of_keys_.load(std::memory_order_relaxed);
+  }
+  // Number of units allocated for a dictionary.
+  SizeType num_of_units() const {
+    return num_of_units_.load(std::memory_order_relaxed);
+  }
+  bool is_cancelled() const {
+    return is_cancelled_.load(std::memory_order_relaxed);
+  }
+
+  void add_keys(SizeType num_of_keys) {
+    num_of_keys_.fetch_add(num_of_keys, std::memory_order_relaxed);
+  }
+  void add_units(SizeType num_of_units) {
+    num_of_units_.fetch_add(num_of_units, std::memory_order_relaxed);
+  }
+
+  // Makes builders stop as soon as they check.
+  void Cancel() {
+    is_cancelled_.store(true, std::memory_order_relaxed);
+  }
+
+  // Sets counts to 0 for the next phase of a build.
+  void Reset() {
+    num_of_keys_.store(0, std::memory_order_relaxed);
+    num_of_units_.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<SizeType> num_of_keys_;
+  std::atomic<SizeType> num_of_units_;
+  std::atomic<bool> is_cancelled_;
+
+  // Disallows copies.
+  BuildMonitor(const BuildMonitor &);
+  BuildMonitor &operator=(const BuildMonitor &);
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_BUILD_MONITOR_H
@@ -3,29 +3,37 @@
 
 #include "dictionary.h"
 #include "guide.h"
+#include "interleaved-dictionary.h"
+#include "louds.h"
 
 #include <vector>
 
 namespace dawgdic {
 
-class Completer {
+// Completes keys of a dictionary of type Dic with the help of a guide.
+template <typename Dic>
+class BasicCompleter {
  public:
-  Completer()
+  typedef typename Dic::IndexType IndexType;
+  typedef typename Dic::ValueType ValueType;
+  typedef typename Dic::GuideType GuideType;
+
+  BasicCompleter()
     : dic_(NULL), guide_(NULL), key_(), index_stack_(), last_index_(0) {}
-  Completer(const Dictionary &dic, const Guide &guide)
+  BasicCompleter(const Dic &dic, const GuideType &guide)
     : dic_(&dic), guide_(&guide), key_(), index_stack_(), last_index_(0) {}
 
-  void set_dic(const Dictionary &dic) {
+  void set_dic(const Dic &dic) {
     dic_ = &dic;
   }
-  void set_guide(const Guide &guide) {
+  void set_guide(const GuideType &guide) {
     guide_ = &guide;
   }
 
-  const Dictionary &dic() const {
+  const Dic &dic() const {
     return *dic_;
   }
-  const Guide &guide() const {
+  const GuideType &guide() const {
     return *guide_;
   }
 
@@ -41,14 +49,14 @@ class Completer {
   }
 
   // Starts completing keys from given index and prefix.
-  void Start(BaseType index, const char *prefix = "") {
+  void Start(IndexType index, const char *prefix = "") {
     SizeType length = 0;
     for (const char *p = prefix; *p != '\0'; ++p) {
       ++length;
     }
     Start(index, prefix, length);
   }
-  void Start(BaseType index, const char *prefix, SizeType length) {
+  void Start(IndexType index, const char *prefix, SizeType length) {
     key_.resize(length + 1);
     for (SizeType i = 0; i < length; ++i) {
       key_[i] = prefix[i];
@@ -67,7 +75,7 @@ class Completer {
     if (index_stack_.empty()) {
       return false;
     }
-    BaseType index = index_stack_.back();
+    IndexType index = index_stack_.back();
 
     if (last_index_ != dic_->root()) {
       UCharType child_label = guide_->child(index);
@@ -75,29 +83,8 @@ class Completer {
         // Follows a transition to the first child.
         if (!Follow(child_label, &index))
           return false;
-      } else {
-        for ( ; ; ) {
-          UCharType sibling_label = guide_->sibling(index);
-
-          // Moves to the previous node.
-          if (key_.size() > 1) {
-            key_.resize(key_.size() - 1);
-            key_.back() = '\0';
-          }
-          index_stack_.resize(index_stack_.size() - 1);
-          if (index_stack_.empty()) {
-            return false;
-          }
-
-          index = index_stack_.back();
-          if (sibling_label != '\0') {
-            // Follows a transition to the next sibling.
-            if (!Follow(sibling_label, &index)) {
-              return false;
-            }
-            break;
-          }
-        }
+      } else if (!Skip(&index)) {
+        return false;
       }
     }
 
@@ -105,19 +92,60 @@ class Completer {
     return FindTerminal(index);
   }
 
+  // Skips the keys that sort before the prefix given to Start() followed
+  // by a key, so that Next() gets the first key that does not. Bytes are
+  // compared as unsigned. This member function is available only right
+  // after Start().
+  void Seek(const char *key, SizeType length) {
+    if (index_stack_.empty()) {
+      return;
+    }
+    for (SizeType i = 0; i < length; ++i) {
+      UCharType label = static_cast<UCharType>(key[i]);
+      IndexType index = index_stack_.back();
+      IndexType child_index = index;
+      if (label != '\0' && dic_->Follow(label, &child_index)) {
+        key_.back() = label;
+        key_.push_back('\0');
+        index_stack_.push_back(child_index);
+        continue;
+      }
+
+      // Moves to the first child with a greater label or, if there is
+      // none, past the subtree.
+      UCharType child_label = guide_->child(index);
+      while (child_label != '\0' && child_label < label) {
+        child_index = index;
+        if (!dic_->Follow(child_label, &child_index)) {
+          index_stack_.clear();
+          return;
+        }
+        child_label = guide_->sibling(child_index);
+      }
+      if (child_label != '\0') {
+        if (!Follow(child_label, &index)) {
+          index_stack_.clear();
+        }
+      } else {
+        Skip(&index);
+      }
+      return;
+    }
+  }
+
  private:
-  const Dictionary *dic_;
-  const Guide *guide_;
+  const Dic *dic_;
+  const GuideType *guide_;
   std::vector<UCharType> key_;
-  std::vector<BaseType> index_stack_;
-  BaseType last_index_;
+  std::vector<IndexType> index_stack_;
+  IndexType last_index_;
 
   // Disallows copies.
-  Completer(const Completer &);
-  Completer &operator=(const Completer &);
+  BasicCompleter(const BasicCompleter &);
+  BasicCompleter &operator=(const BasicCompleter &);
 
   // Follows a transition.
-  bool Follow(UCharType label, BaseType *index) {
+  bool Follow(UCharType label, IndexType *index) {
     if (!dic_->Follow(label, index)) {
       return false;
     }
@@ -128,10 +156,39 @@ class Completer {
     return true;
   }
 
+  // Leaves the subtree of an index for that of the next sibling of the
+  // index or of its nearest ancestor that has one. Returns false if there
+  // is no such sibling below the index given to Start().
+  bool Skip(IndexType *index) {
+    for ( ; ; ) {
+      UCharType sibling_label = guide_->sibling(*index);
+
+      // Moves to the previous node.
+      if (key_.size() > 1) {
+        key_.resize(key_.size() - 1);
+        key_.back() = '\0';
+      }
+      index_stack_.resize(index_stack_.size() - 1);
+      if (index_stack_.empty()) {
+        return false;
+      }
+
+      *index = index_stack_.back();
+      if (sibling_label != '\0') {
+        // Follows a transition to the next sibling.
+        return Follow(sibling_label, index);
+      }
+    }
+  }
+
   // Finds a terminal.
-  bool FindTerminal(BaseType index) {
+  bool FindTerminal(IndexType index) {
     while (!dic_->has_value(index)) {
       UCharType label = guide_->child(index);
+      if (label == '\0') {
+        // Only the root of a dictionary without keys has neither.
+        return false;
+      }
       if (!dic_->Follow(label, &index)) {
         return false;
       }
@@ -146,6 +203,11 @@ class Completer {
   }
 };
 
+typedef BasicCompleter<Dictionary> Completer;
+typedef BasicCompleter<Dictionary64> Completer64;
+typedef BasicCompleter<Louds> LoudsCompleter;
+typedef BasicCompleter<InterleavedDictionary> InterleavedCompleter;
+
 }  // namespace dawgdic
 
 #endif  // DAWGDIC_COMPLETER_H
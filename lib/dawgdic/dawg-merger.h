@@ -0,0 +1,266 @@
+#ifndef DAWGDIC_DAWG_MERGER_H
+#define DAWGDIC_DAWG_MERGER_H
+
+#include <vector>
+
+#include "dawg.h"
+
+namespace dawgdic {
+
+// Assembles a dawg from states that are added bottom-up, i.e. children
+// before their parents. Equivalent states are registered only once, so
+// states from several dawgs can be merged into one minimal dawg.
+class DawgMerger {
+ public:
+  explicit DawgMerger(SizeType initial_hash_table_size =
+                      DEFAULT_INITIAL_HASH_TABLE_SIZE)
+    : base_pool_(), label_pool_(), flag_pool_(), reference_pool_(),
+      hash_table_(initial_hash_table_size, 0), states_(), bases_(),
+      num_of_merged_transitions_(0), num_of_merging_states_(0) {
+    AllocateTransition();
+  }
+
+  // Number of units.
+  SizeType size() const {
+    return base_pool_.size();
+  }
+  // Number of states, including the root transition.
+  SizeType num_of_states() const {
+    return states_.size() + 1;
+  }
+
+  // Adds a state with transitions sorted by label. For a leaf transition
+  // (label 0), the target is its value, otherwise the index of a state
+  // returned by an earlier call. Returns the index of the state.
+  BaseType AddState(const UCharType *labels, const BaseType *targets,
+                    SizeType num_of_transitions) {
+    bases_.resize(num_of_transitions);
+    for (SizeType i = 0; i < num_of_transitions; ++i) {
+      BaseType has_sibling = (i + 1 < num_of_transitions) ? 1 : 0;
+      if (labels[i] == '\0') {
+        bases_[i] = (targets[i] << 1) | has_sibling;
+      } else {
+        bases_[i] = (targets[i] << 2) | (i == 0 ? 2 : 0) | has_sibling;
+      }
+    }
+
+    BaseType hash_id;
+    BaseType index = FindState(labels, num_of_transitions, &hash_id);
+    if (index != 0) {
+      num_of_merged_transitions_ += num_of_transitions;
+      return index;
+    }
+
+    index = static_cast<BaseType>(base_pool_.size());
+    for (SizeType i = 0; i < num_of_transitions; ++i) {
+      AllocateTransition();
+      base_pool_[index + i].set_base(bases_[i]);
+      label_pool_[index + i] = labels[i];
+      if (labels[i] != '\0') {
+        AddReference(targets[i]);
+      }
+    }
+    hash_table_[hash_id] = index;
+    states_.push_back(index);
+
+    if (states_.size() >= hash_table_.size() - (hash_table_.size() >> 2)) {
+      ExpandHashTable();
+    }
+    return index;
+  }
+
+  // Adds all states of a dawg except its root, whose transitions are
+  // appended to labels and targets for building a new root.
+  bool AddDawg(const Dawg &dawg, std::vector<UCharType> *labels,
+               std::vector<BaseType> *targets) {
+    BaseType root_state = dawg.child(dawg.root());
+    if (dawg.size() <= 1 || root_state == 0) {
+      return true;
+    }
+
+    // Maps states of the given dawg to states of the merged dawg.
+    std::vector<BaseType> state_map(dawg.size(), 0);
+    std::vector<UCharType> state_labels;
+    std::vector<BaseType> state_targets;
+
+    // Visits states in post-order without recursion.
+    std::vector<BaseType> stack;
+    stack.push_back(root_state);
+    while (!stack.empty()) {
+      BaseType state = stack.back();
+      bool is_ready = true;
+      for (BaseType i = state; i != 0; i = dawg.sibling(i)) {
+        if (!dawg.is_leaf(i) && state_map[dawg.child(i)] == 0) {
+          stack.push_back(dawg.child(i));
+          is_ready = false;
+        }
+      }
+      if (!is_ready) {
+        continue;
+      }
+      stack.pop_back();
+      if (state_map[state] != 0) {
+        continue;
+      }
+
+      state_labels.clear();
+      state_targets.clear();
+      for (BaseType i = state; i != 0; i = dawg.sibling(i)) {
+        state_labels.push_back(dawg.label(i));
+        state_targets.push_back(dawg.is_leaf(i) ?
+            static_cast<BaseType>(dawg.value(i)) : state_map[dawg.child(i)]);
+      }
+
+      if (state == root_state) {
+        labels->insert(labels->end(),
+                       state_labels.begin(), state_labels.end());
+        targets->insert(targets->end(),
+                        state_targets.begin(), state_targets.end());
+        // The new root records its references when it is added.
+        state_map[state] = 1;
+      } else {
+        state_map[state] = AddState(&state_labels[0], &state_targets[0],
+                                    state_labels.size());
+      }
+    }
+    return true;
+  }
+
+  // Finishes building a dawg whose root is a given state.
+  bool Finish(BaseType root_state, Dawg *dawg) {
+    base_pool_[0].set_base(root_state << 2);
+    label_pool_[0] = 0xFF;
+
+    SizeType num_of_transitions = base_pool_.size() - 1;
+    dawg->set_num_of_states(num_of_states());
+    dawg->set_num_of_merged_transitions(num_of_merged_transitions_);
+    dawg->set_num_of_merged_states(num_of_transitions
+        + num_of_merged_transitions_ + 1 - num_of_states());
+    dawg->set_num_of_merging_states(num_of_merging_states_);
+
+    dawg->SwapBasePool(&base_pool_);
+    dawg->SwapLabelPool(&label_pool_);
+    dawg->SwapFlagPool(&flag_pool_);
+    return true;
+  }
+
+ private:
+  enum {
+    DEFAULT_INITIAL_HASH_TABLE_SIZE = 1 << 8
+  };
+
+  ObjectPool<BaseUnit> base_pool_;
+  ObjectPool<UCharType> label_pool_;
+  BitPool<> flag_pool_;
+  BitPool<> reference_pool_;
+  std::vector<BaseType> hash_table_;
+  std::vector<BaseType> states_;
+  std::vector<BaseType> bases_;
+  SizeType num_of_merged_transitions_;
+  SizeType num_of_merging_states_;
+
+  // Disallows copies.
+  DawgMerger(const DawgMerger &);
+  DawgMerger &operator=(const DawgMerger &);
+
+  // Records a transition into a state; states reached by more than one
+  // transition are flagged as merging.
+  void AddReference(BaseType index) {
+    if (!reference_pool_.get(index)) {
+      reference_pool_.set(index, true);
+    } else if (!flag_pool_.get(index)) {
+      flag_pool_.set(index, true);
+      ++num_of_merging_states_;
+    }
+  }
+
+  // Finds a state equal to the one in labels and bases_.
+  BaseType FindState(const UCharType *labels, SizeType num_of_transitions,
+                     BaseType *hash_id) const {
+    *hash_id = HashState(labels, num_of_transitions) % hash_table_.size();
+    for ( ; ; *hash_id = (*hash_id + 1) % hash_table_.size()) {
+      BaseType index = hash_table_[*hash_id];
+      if (index == 0) {
+        break;
+      }
+      if (AreEqual(labels, num_of_transitions, index)) {
+        return index;
+      }
+    }
+    return 0;
+  }
+
+  // Compares transitions with a registered state.
+  bool AreEqual(const UCharType *labels, SizeType num_of_transitions,
+                BaseType index) const {
+    for (SizeType i = 0; i < num_of_transitions; ++i, ++index) {
+      if (base_pool_[index].base() != bases_[i] ||
+          label_pool_[index] != labels[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Calculates a hash value from transitions, like DawgBuilder does.
+  BaseType HashState(const UCharType *labels,
+                     SizeType num_of_transitions) const {
+    BaseType hash_value = 0;
+    for (SizeType i = 0; i < num_of_transitions; ++i) {
+      hash_value ^= Hash((labels[i] << 24) ^ bases_[i]);
+    }
+    return hash_value;
+  }
+
+  // Calculates a hash value from a registered state.
+  BaseType HashRegisteredState(BaseType index) const {
+    BaseType hash_value = 0;
+    for ( ; ; ++index) {
+      hash_value ^= Hash((label_pool_[index] << 24) ^
+                         base_pool_[index].base());
+      if (!base_pool_[index].has_sibling()) {
+        break;
+      }
+    }
+    return hash_value;
+  }
+
+  // Expands a hash table.
+  void ExpandHashTable() {
+    SizeType hash_table_size = hash_table_.size() << 1;
+    std::vector<BaseType>(0).swap(hash_table_);
+    hash_table_.resize(hash_table_size, 0);
+
+    for (SizeType i = 0; i < states_.size(); ++i) {
+      BaseType hash_id = HashRegisteredState(states_[i]) % hash_table_size;
+      while (hash_table_[hash_id] != 0) {
+        hash_id = (hash_id + 1) % hash_table_size;
+      }
+      hash_table_[hash_id] = states_[i];
+    }
+  }
+
+  // 32-bit mix function.
+  // http://www.concentric.net/~Ttwang/tech/inthash.htm
+  static BaseType Hash(BaseType key) {
+    key = ~key + (key << 15);  // key = (key << 15) - key - 1;
+    key = key ^ (key >> 12);
+    key = key + (key << 2);
+    key = key ^ (key >> 4);
+    key = key * 2057;  // key = (key + (key << 3)) + (key << 11);
+    key = key ^ (key >> 16);
+    return key;
+  }
+
+  // Gets a transition from object pools.
+  BaseType AllocateTransition() {
+    flag_pool_.Allocate();
+    reference_pool_.Allocate();
+    base_pool_.Allocate();
+    return static_cast<BaseType>(label_pool_.Allocate());
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_DAWG_MERGER_H
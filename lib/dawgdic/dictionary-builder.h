@@ -1,17 +1,28 @@
 #ifndef DAWGDIC_DICTIONARY_BUILDER_H
 #define DAWGDIC_DICTIONARY_BUILDER_H
 
+#include <stdint.h>
+
+#include <algorithm>
 #include <vector>
 
+#include "build-monitor.h"
 #include "dawg.h"
 #include "dictionary.h"
-#include "dictionary-extra-unit.h"
+#include "guide.h"
 #include "link-table.h"
 
 namespace dawgdic {
 
-class DictionaryBuilder {
+template <typename Unit>
+class BasicParallelDictionaryBuilder;
+
+// Builds a dictionary of units of type Unit from a dawg.
+template <typename Unit>
+class BasicDictionaryBuilder {
  public:
+  typedef typename Unit::IndexType IndexType;
+
   enum {
     // Number of units in a block.
     BLOCK_SIZE = 256,
@@ -21,13 +32,29 @@ class DictionaryBuilder {
     UNFIXED_SIZE = BLOCK_SIZE * NUM_OF_UNFIXED_BLOCKS
   };
 
-  // Builds a dictionary from a list-form dawg.
-  static bool Build(const Dawg &dawg, Dictionary *dic,
-                    BaseType *num_of_unused_units = NULL) {
-    DictionaryBuilder builder(dawg, dic);
+  // Builds a dictionary from a list-form dawg. If guide is given, a guide
+  // for completing keys is built along with the dictionary, which takes
+  // one walk over the dawg instead of two. Units are counted in monitor,
+  // through which the build can be cancelled. If hot_size is not 0, units
+  // are laid out for searches that walk the trie: its top is placed in
+  // breadth-first order until it takes hot_size units, and the children
+  // of each node below are placed together.
+  static bool Build(const Dawg &dawg, BasicDictionary<Unit> *dic,
+                    IndexType *num_of_unused_units = NULL,
+                    Guide *guide = NULL, BuildMonitor *monitor = NULL,
+                    SizeType hot_size = 0) {
+    BasicDictionaryBuilder builder(dawg);
+    builder.has_guide_ = guide != NULL;
+    builder.monitor_ = monitor;
+    builder.hot_size_ = hot_size;
+    builder.groups_children_ = hot_size != 0;
     if (!builder.BuildDictionary()) {
       return false;
     }
+    dic->SwapUnitsBuf(&builder.units_);
+    if (guide != NULL && dawg.size() > 1) {
+      guide->SwapUnitsBuf(&builder.guide_units_);
+    }
     if (num_of_unused_units != NULL) {
       *num_of_unused_units = builder.num_of_unused_units_;
     }
@@ -35,54 +62,111 @@ class DictionaryBuilder {
   }
 
  private:
+  // Flags of units in unfixed blocks are kept in bitmaps, whose words are
+  // reused in a ring as blocks are fixed and added.
+  typedef uint64_t WordType;
+
+  enum {
+    NUM_OF_BITS_PER_WORD = 64,
+    NUM_OF_WORDS_PER_BLOCK = BLOCK_SIZE / NUM_OF_BITS_PER_WORD,
+    NUM_OF_UNFIXED_WORDS = UNFIXED_SIZE / NUM_OF_BITS_PER_WORD,
+    // Number of labels from which units are checked a word at a time.
+    MIN_NUM_OF_BITMAP_LABELS = 4
+  };
+
+  // A node whose descendants are placed by another builder, with the
+  // offset of its children there.
+  struct Cut {
+    BaseType dawg_index;
+    IndexType dic_index;
+    IndexType offset;
+    bool has_leaf;
+  };
+
+  // A node whose children have units, with the next child to build.
+  struct Node {
+    BaseType dawg_child_index;
+    IndexType offset;
+  };
+
   const Dawg &dawg_;
-  Dictionary *dic_;
 
-  std::vector<DictionaryUnit> units_;
-  std::vector<DictionaryExtraUnit *> extras_;
+  std::vector<Unit> units_;
+  WordType fixed_bits_[NUM_OF_UNFIXED_WORDS];
+  WordType used_bits_[NUM_OF_UNFIXED_WORDS];
+  // Bit i is set if word i of fixed_bits_ has an unfixed unit.
+  WordType unfixed_words_;
   std::vector<UCharType> labels_;
-  LinkTable link_table_;
-  BaseType unfixed_index_;
-  BaseType num_of_unused_units_;
+  std::vector<Node> nodes_;
+  BasicLinkTable<IndexType> link_table_;
+  IndexType num_of_unused_units_;
+  // Guide units, which are kept for all units if has_guide_ is set.
+  bool has_guide_;
+  std::vector<GuideUnit> guide_units_;
+  BuildMonitor *monitor_;
+  // Number of units at the top of the trie that are placed breadth first.
+  SizeType hot_size_;
+  // Set if the children of a node are arranged together, which places the
+  // units of their children close to them instead of after the subtrees
+  // of their elder siblings.
+  bool groups_children_;
+  // Nodes whose descendants are left to other builders, and the units
+  // that such nodes were given.
+  const std::vector<bool> *cut_nodes_;
+  std::vector<Cut> cuts_;
+
+  friend class BasicParallelDictionaryBuilder<Unit>;
 
   // Masks for offsets.
-  static const BaseType UPPER_MASK = ~(DictionaryUnit::OFFSET_MAX - 1);
-  static const BaseType LOWER_MASK = 0xFF;
+  static const IndexType UPPER_MASK = ~(Unit::OFFSET_MAX - 1);
+  static const IndexType LOWER_MASK = 0xFF;
 
   // Disallows copies.
-  DictionaryBuilder(const DictionaryBuilder &);
-  DictionaryBuilder &operator=(const DictionaryBuilder &);
+  BasicDictionaryBuilder(const BasicDictionaryBuilder &);
+  BasicDictionaryBuilder &operator=(const BasicDictionaryBuilder &);
 
-  DictionaryBuilder(const Dawg &dawg, Dictionary *dic)
-    : dawg_(dawg), dic_(dic), units_(), extras_(), labels_(),
-      link_table_(), unfixed_index_(), num_of_unused_units_(0) {}
-  ~DictionaryBuilder() {
-    for (SizeType i = 0; i < extras_.size(); ++i) {
-      delete [] extras_[i];
-    }
-  }
+  explicit BasicDictionaryBuilder(const Dawg &dawg)
+    : dawg_(dawg), units_(), fixed_bits_(), used_bits_(),
+      unfixed_words_(~static_cast<WordType>(0)), labels_(), nodes_(),
+      link_table_(), num_of_unused_units_(0), has_guide_(false),
+      guide_units_(), monitor_(NULL), hot_size_(0), groups_children_(false),
+      cut_nodes_(NULL), cuts_() {}
 
   // Accesses units.
-  DictionaryUnit &units(BaseType index) {
+  Unit &units(IndexType index) {
     return units_[index];
   }
-  const DictionaryUnit &units(BaseType index) const {
+  const Unit &units(IndexType index) const {
     return units_[index];
   }
-  DictionaryExtraUnit &extras(BaseType index) {
-    return extras_[index / BLOCK_SIZE][index % BLOCK_SIZE];
+
+  // Accesses flags of units in unfixed blocks.
+  bool is_fixed(IndexType index) const {
+    return (fixed_bits_[WordId(index)] >> (index % NUM_OF_BITS_PER_WORD)) & 1;
+  }
+  void set_is_fixed(IndexType index) {
+    WordType &word = fixed_bits_[WordId(index)];
+    word |= static_cast<WordType>(1) << (index % NUM_OF_BITS_PER_WORD);
+    if (word == ~static_cast<WordType>(0)) {
+      unfixed_words_ &= ~(static_cast<WordType>(1) << WordId(index));
+    }
+  }
+  // Checks if an index is used as an offset or not.
+  bool is_used(IndexType index) const {
+    return (used_bits_[WordId(index)] >> (index % NUM_OF_BITS_PER_WORD)) & 1;
   }
-  const DictionaryExtraUnit &extras(BaseType index) const {
-    return extras_[index / BLOCK_SIZE][index % BLOCK_SIZE];
+  void set_is_used(IndexType index) {
+    used_bits_[WordId(index)] |=
+        static_cast<WordType>(1) << (index % NUM_OF_BITS_PER_WORD);
   }
 
   // Number of units.
-  BaseType num_of_units() const {
-    return static_cast<BaseType>(units_.size());
+  IndexType num_of_units() const {
+    return static_cast<IndexType>(units_.size());
   }
   // Number of blocks.
-  BaseType num_of_blocks() const {
-    return static_cast<BaseType>(extras_.size());
+  IndexType num_of_blocks() const {
+    return num_of_units() / BLOCK_SIZE;
   }
 
   // Builds a dictionary from a list-form dawg.
@@ -91,7 +175,7 @@ class DictionaryBuilder {
         (dawg_.num_of_merging_states() >> 1));
 
     ReserveUnit(0);
-    extras(0).set_is_used();
+    set_is_used(0);
     units(0).set_offset(1);
     units(0).set_label('\0');
 
@@ -102,35 +186,160 @@ class DictionaryBuilder {
     }
 
     FixAllBlocks();
+    return true;
+  }
+
+  // Builds the descendants of nodes into units of their own, for nodes
+  // whose units are in another dictionary. The offsets of their children
+  // are returned instead of being set, and have the same lower 8 bits as
+  // the units of the nodes, so that they stay valid when the units built
+  // here are moved by a multiple of 256.
+  bool BuildSubtrees(Cut *cuts, SizeType num_of_cuts,
+                     SizeType link_table_size) {
+    link_table_.Init(link_table_size);
+
+    // Offset 0 is kept unused, as 0 means no offset.
+    ExpandDictionary();
+    set_is_used(0);
+
+    for (SizeType i = 0; i < num_of_cuts; ++i) {
+      Cut &cut = cuts[i];
+      cut.has_leaf = false;
+      cut.offset = PlaceChildNodes(cut.dawg_index,
+                                   (cut.dic_index & LOWER_MASK) | UPPER_MASK,
+                                   &cut.has_leaf);
+      if (cut.offset == 0) {
+        return false;
+      }
 
-    dic_->SwapUnitsBuf(&units_);
+      BaseType dawg_child_index = dawg_.child(cut.dawg_index);
+      if (dawg_.is_merging(dawg_child_index)) {
+        link_table_.Insert(dawg_child_index, cut.offset);
+      }
+      Node node = { dawg_child_index, cut.offset };
+      nodes_.push_back(node);
+      if (!BuildChildNodes()) {
+        return false;
+      }
+    }
+
+    FixAllBlocks();
     return true;
   }
 
   // Builds a dictionary from a dawg.
-  bool BuildDictionary(BaseType dawg_index, BaseType dic_index) {
+  bool BuildDictionary(BaseType dawg_index, IndexType dic_index) {
+    return ArrangeNode(dawg_index, dic_index) && BuildHotNodes() &&
+        BuildChildNodes();
+  }
+
+  // Builds the top of a double-array in breadth-first order until it takes
+  // hot_size_ units. Any search goes through the top levels, which are
+  // otherwise spread over the array by the subtrees built between them,
+  // and now share cache lines and pages. The nodes left in nodes_ are
+  // reordered so that their subtrees are then built one after another.
+  bool BuildHotNodes() {
+    SizeType num_of_hot_nodes = 0;
+    while (num_of_hot_nodes < nodes_.size() &&
+           num_of_units() < hot_size_) {
+      Node node = nodes_[num_of_hot_nodes++];
+      if (!ArrangeChildren(node)) {
+        return false;
+      }
+    }
+    nodes_.erase(nodes_.begin(), nodes_.begin() + num_of_hot_nodes);
+    std::reverse(nodes_.begin(), nodes_.end());
+    return true;
+  }
+
+  // Gives the children of a node their units, one after another.
+  bool ArrangeChildren(Node node) {
+    for (BaseType dawg_child_index = node.dawg_child_index;
+         dawg_child_index != 0;
+         dawg_child_index = dawg_.sibling(dawg_child_index)) {
+      if (monitor_ != NULL && monitor_->is_cancelled()) {
+        return false;
+      }
+      IndexType dic_child_index = node.offset ^ dawg_.label(dawg_child_index);
+      if (!ArrangeNode(dawg_child_index, dic_child_index)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Builds a double-array in depth-first order. Instead of recursing once
+  // per character of a key, nodes whose children have been arranged wait
+  // in nodes_ with the next child to build.
+  bool BuildChildNodes() {
+    while (!nodes_.empty()) {
+      Node &node = nodes_.back();
+      BaseType dawg_child_index = node.dawg_child_index;
+      if (dawg_child_index == 0) {
+        nodes_.pop_back();
+        continue;
+      }
+      if (groups_children_) {
+        // Arranges all the children, whose subtrees are then built from
+        // the first one.
+        Node parent = node;
+        nodes_.pop_back();
+        SizeType begin = nodes_.size();
+        if (!ArrangeChildren(parent)) {
+          return false;
+        }
+        std::reverse(nodes_.begin() + begin, nodes_.end());
+        continue;
+      }
+      node.dawg_child_index = dawg_.sibling(dawg_child_index);
+      if (monitor_ != NULL && monitor_->is_cancelled()) {
+        return false;
+      }
+
+      // Descends into the child, which invalidates node.
+      IndexType dic_child_index = node.offset ^ dawg_.label(dawg_child_index);
+      if (!ArrangeNode(dawg_child_index, dic_child_index)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Gives the children of a node their units, and pushes the node if its
+  // children are to be built.
+  bool ArrangeNode(BaseType dawg_index, IndexType dic_index) {
     if (dawg_.is_leaf(dawg_index)) {
       return true;
     }
 
+    if (has_guide_) {
+      SetGuideChild(dawg_index, dic_index);
+    }
+
+    if (cut_nodes_ != NULL && (*cut_nodes_)[dawg_index]) {
+      Cut cut = { dawg_index, dic_index, 0, false };
+      cuts_.push_back(cut);
+      return true;
+    }
+
     // Uses an existing offset if available.
     BaseType dawg_child_index = dawg_.child(dawg_index);
     if (dawg_.is_merging(dawg_child_index)) {
-      BaseType offset = link_table_.Find(dawg_child_index);
+      IndexType offset = link_table_.Find(dawg_child_index);
       if (offset != 0) {
         offset ^= dic_index;
-        if (!(offset & UPPER_MASK) || !(offset & LOWER_MASK)) {
+        if ((!(offset & UPPER_MASK) || !(offset & LOWER_MASK)) &&
+            units(dic_index).set_offset(offset)) {
           if (dawg_.is_leaf(dawg_child_index)) {
             units(dic_index).set_has_leaf();
           }
-          units(dic_index).set_offset(offset);
           return true;
         }
       }
     }
 
     // Finds a good offset and arranges child nodes.
-    BaseType offset = ArrangeChildNodes(dawg_index, dic_index);
+    IndexType offset = ArrangeChildNodes(dawg_index, dic_index);
     if (offset == 0) {
       return false;
     }
@@ -139,20 +348,28 @@ class DictionaryBuilder {
       link_table_.Insert(dawg_child_index, offset);
     }
 
-    // Builds a double-array in depth-first order.
-    do {
-      BaseType dic_child_index = offset ^ dawg_.label(dawg_child_index);
-      if (!BuildDictionary(dawg_child_index, dic_child_index)) {
-        return false;
-      }
-      dawg_child_index = dawg_.sibling(dawg_child_index);
-    } while (dawg_child_index != 0);
-
+    Node node = { dawg_child_index, offset };
+    nodes_.push_back(node);
     return true;
   }
 
   // Arranges child nodes.
-  BaseType ArrangeChildNodes(BaseType dawg_index, BaseType dic_index) {
+  IndexType ArrangeChildNodes(BaseType dawg_index, IndexType dic_index) {
+    bool has_leaf = false;
+    IndexType offset = PlaceChildNodes(dawg_index, dic_index, &has_leaf);
+    if (offset == 0 || !units(dic_index).set_offset(dic_index ^ offset)) {
+      return 0;
+    }
+    if (has_leaf) {
+      units(dic_index).set_has_leaf();
+    }
+    return offset;
+  }
+
+  // Finds a good offset for the children of a node and reserves their
+  // units.
+  IndexType PlaceChildNodes(BaseType dawg_index, IndexType dic_index,
+                           bool *has_leaf) {
     labels_.clear();
 
     BaseType dawg_child_index = dawg_.child(dawg_index);
@@ -162,63 +379,127 @@ class DictionaryBuilder {
     }
 
     // Finds a good offset.
-    BaseType offset = FindGoodOffset(dic_index);
-    if (!units(dic_index).set_offset(dic_index ^ offset)) {
-      return 0;
-    }
+    IndexType offset = FindGoodOffset(dic_index);
 
     dawg_child_index = dawg_.child(dawg_index);
     for (SizeType i = 0; i < labels_.size(); ++i) {
-      BaseType dic_child_index = offset ^ labels_[i];
+      IndexType dic_child_index = offset ^ labels_[i];
       ReserveUnit(dic_child_index);
 
       if (dawg_.is_leaf(dawg_child_index)) {
-        units(dic_index).set_has_leaf();
+        *has_leaf = true;
         units(dic_child_index).set_value(dawg_.value(dawg_child_index));
       } else {
         units(dic_child_index).set_label(labels_[i]);
+        if (has_guide_ && i + 1 < labels_.size()) {
+          guide_units_[dic_child_index].set_sibling(labels_[i + 1]);
+        }
       }
 
       dawg_child_index = dawg_.sibling(dawg_child_index);
     }
-    extras(offset).set_is_used();
+    set_is_used(offset);
 
     return offset;
   }
 
-  // Finds a good offset.
-  BaseType FindGoodOffset(BaseType index) const {
-    if (unfixed_index_ >= num_of_units()) {
-      return num_of_units() | (index & 0xFF);
+  // Sets the label of the first non-terminal child of a node as its guide.
+  void SetGuideChild(BaseType dawg_index, IndexType dic_index) {
+    BaseType dawg_child_index = dawg_.child(dawg_index);
+    if (dawg_.label(dawg_child_index) == '\0') {
+      dawg_child_index = dawg_.sibling(dawg_child_index);
+      if (dawg_child_index == 0) {
+        return;
+      }
+    }
+    guide_units_[dic_index].set_child(dawg_.label(dawg_child_index));
+  }
+
+  // Finds a good offset. Unfixed units are tried in order as the unit of
+  // the first label, so that the result only depends on the dawg.
+  IndexType FindGoodOffset(IndexType index) const {
+    IndexType begin = 0;
+    if (num_of_blocks() > NUM_OF_UNFIXED_BLOCKS) {
+      begin = num_of_units() - UNFIXED_SIZE;
     }
 
-    // Scans unused units to find a good offset.
-    BaseType unfixed_index = unfixed_index_;
-    do {
-      BaseType offset = unfixed_index ^ labels_[0];
-      if (IsGoodOffset(index, offset)) {
+    // Rotates the ring of words so that bit 0 is the word of begin.
+    WordType words = unfixed_words_;
+    BaseType shift = WordId(begin);
+    if (shift != 0) {
+      words = (words >> shift) | (words << (NUM_OF_UNFIXED_WORDS - shift));
+    }
+    if (num_of_blocks() < NUM_OF_UNFIXED_BLOCKS) {
+      words &= (static_cast<WordType>(1) <<
+          (num_of_blocks() * NUM_OF_WORDS_PER_BLOCK)) - 1;
+    }
+
+    IndexType offset;
+    for ( ; words != 0; words &= words - 1) {
+      IndexType word_begin = begin + FindLowestBit(words) * NUM_OF_BITS_PER_WORD;
+      if (FindGoodOffset(index, word_begin, &offset)) {
         return offset;
       }
-      unfixed_index = extras(unfixed_index).next();
-    } while (unfixed_index != unfixed_index_);
-
+    }
     return num_of_units() | (index & 0xFF);
   }
 
+  // Finds a good offset for the first label among 64 units. For a few
+  // labels, the unfixed units are checked one by one. Otherwise, the flags
+  // of units that other labels would take are moved onto the units of the
+  // first label and cleared from candidates, 64 units at a time.
+  bool FindGoodOffset(IndexType index, IndexType begin,
+                      IndexType *offset) const {
+    BaseType first_label = labels_[0];
+    WordType candidates = ~fixed_bits_[WordId(begin)];
+
+    if (labels_.size() < MIN_NUM_OF_BITMAP_LABELS) {
+      for ( ; candidates != 0; candidates &= candidates - 1) {
+        *offset = (begin + FindLowestBit(candidates)) ^ first_label;
+        if (IsGoodOffset(index, *offset)) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // An offset far from index must have the same lower bits.
+    if ((index ^ begin) & UPPER_MASK) {
+      IndexType unit = (index ^ first_label) & LOWER_MASK;
+      if ((begin & LOWER_MASK) != (unit & ~(NUM_OF_BITS_PER_WORD - 1))) {
+        return false;
+      }
+      candidates &= static_cast<WordType>(1) << (unit % NUM_OF_BITS_PER_WORD);
+    }
+
+    // Finds offsets in use and collisions.
+    candidates &= ~Permute(used_bits_[WordId(begin ^ first_label)],
+                           first_label);
+    for (SizeType i = 1; candidates != 0 && i < labels_.size(); ++i) {
+      BaseType distance = first_label ^ labels_[i];
+      candidates &= ~Permute(fixed_bits_[WordId(begin ^ distance)], distance);
+    }
+    if (candidates == 0) {
+      return false;
+    }
+    *offset = (begin + FindLowestBit(candidates)) ^ first_label;
+    return true;
+  }
+
   // Checks if a given offset is valid or not.
-  bool IsGoodOffset(BaseType index, BaseType offset) const {
-    if (extras(offset).is_used()) {
+  bool IsGoodOffset(IndexType index, IndexType offset) const {
+    if (is_used(offset)) {
       return false;
     }
 
-    BaseType relative_offset = index ^ offset;
+    IndexType relative_offset = index ^ offset;
     if ((relative_offset & LOWER_MASK) && (relative_offset & UPPER_MASK)) {
       return false;
     }
 
     // Finds a collision.
     for (SizeType i = 1; i < labels_.size(); ++i) {
-      if (extras(offset ^ labels_[i]).is_fixed()) {
+      if (is_fixed(offset ^ labels_[i])) {
         return false;
       }
     }
@@ -227,97 +508,66 @@ class DictionaryBuilder {
   }
 
   // Reserves an unused unit.
-  void ReserveUnit(BaseType index) {
+  void ReserveUnit(IndexType index) {
     if (index >= num_of_units()) {
       ExpandDictionary();
     }
-
-    // Removes an unused unit from a circular linked list.
-    if (index == unfixed_index_) {
-      unfixed_index_ = extras(index).next();
-      if (unfixed_index_ == index) {
-        unfixed_index_ = num_of_units();
-      }
-    }
-    extras(extras(index).prev()).set_next(extras(index).next());
-    extras(extras(index).next()).set_prev(extras(index).prev());
-    extras(index).set_is_fixed();
+    set_is_fixed(index);
   }
 
   // Expands a dictionary.
   void ExpandDictionary() {
-    BaseType src_num_of_units = num_of_units();
-    BaseType src_num_of_blocks = num_of_blocks();
-
-    BaseType dest_num_of_units = src_num_of_units + BLOCK_SIZE;
-    BaseType dest_num_of_blocks = src_num_of_blocks + 1;
-
-    // Fixes an old block.
-    if (dest_num_of_blocks > NUM_OF_UNFIXED_BLOCKS) {
-      FixBlock(src_num_of_blocks - NUM_OF_UNFIXED_BLOCKS);
-    }
-
-    units_.resize(dest_num_of_units);
-    extras_.resize(dest_num_of_blocks, 0);
-
-    // Allocates memory to a new block.
-    if (dest_num_of_blocks > NUM_OF_UNFIXED_BLOCKS) {
-      BaseType block_id = src_num_of_blocks - NUM_OF_UNFIXED_BLOCKS;
-      std::swap(extras_[block_id], extras_.back());
-      for (BaseType i = src_num_of_units; i < dest_num_of_units; ++i) {
-        extras(i).clear();
+    // Fixes an old block and reuses its words for a new block.
+    if (num_of_blocks() >= NUM_OF_UNFIXED_BLOCKS) {
+      FixBlock(num_of_blocks() - NUM_OF_UNFIXED_BLOCKS);
+
+      BaseType word_id = WordId(num_of_units());
+      for (BaseType i = word_id; i < word_id + NUM_OF_WORDS_PER_BLOCK; ++i) {
+        fixed_bits_[i] = 0;
+        used_bits_[i] = 0;
+        unfixed_words_ |= static_cast<WordType>(1) << i;
       }
-    } else {
-      extras_.back() = new DictionaryExtraUnit[BLOCK_SIZE];
     }
 
-    // Creates a circular linked list for a new block.
-    for (BaseType i = src_num_of_units + 1; i < dest_num_of_units; ++i) {
-      extras(i - 1).set_next(i);
-      extras(i).set_prev(i - 1);
+    units_.resize(units_.size() + BLOCK_SIZE);
+    if (has_guide_) {
+      guide_units_.resize(units_.size());
+    }
+    if (monitor_ != NULL) {
+      monitor_->add_units(BLOCK_SIZE);
     }
-
-    extras(src_num_of_units).set_prev(dest_num_of_units - 1);
-    extras(dest_num_of_units - 1).set_next(src_num_of_units);
-
-    // Merges 2 circular linked lists.
-    extras(src_num_of_units).set_prev(extras(unfixed_index_).prev());
-    extras(dest_num_of_units - 1).set_next(unfixed_index_);
-
-    extras(extras(unfixed_index_).prev()).set_next(src_num_of_units);
-    extras(unfixed_index_).set_prev(dest_num_of_units - 1);
   }
 
   // Fixes all blocks to avoid invalid transitions.
   void FixAllBlocks() {
-    BaseType begin = 0;
+    IndexType begin = 0;
     if (num_of_blocks() > NUM_OF_UNFIXED_BLOCKS) {
       begin = num_of_blocks() - NUM_OF_UNFIXED_BLOCKS;
     }
-    BaseType end = num_of_blocks();
+    IndexType end = num_of_blocks();
 
-    for (BaseType block_id = begin; block_id != end; ++block_id) {
+    for (IndexType block_id = begin; block_id != end; ++block_id) {
       FixBlock(block_id);
     }
   }
 
   // Adjusts labels of unused units in a given block.
-  void FixBlock(BaseType block_id) {
-    BaseType begin = block_id * BLOCK_SIZE;
-    BaseType end = begin + BLOCK_SIZE;
+  void FixBlock(IndexType block_id) {
+    IndexType begin = block_id * BLOCK_SIZE;
+    IndexType end = begin + BLOCK_SIZE;
 
     // Finds an unused offset.
-    BaseType unused_offset_for_label = 0;
-    for (BaseType offset = begin; offset != end; ++offset) {
-      if (!extras(offset).is_used()) {
+    IndexType unused_offset_for_label = 0;
+    for (IndexType offset = begin; offset != end; ++offset) {
+      if (!is_used(offset)) {
         unused_offset_for_label = offset;
         break;
       }
     }
 
     // Labels of unused units are modified.
-    for (BaseType index = begin; index != end; ++index) {
-      if (!extras(index).is_fixed()) {
+    for (IndexType index = begin; index != end; ++index) {
+      if (!is_fixed(index)) {
         ReserveUnit(index);
         units(index).set_label(
             static_cast<UCharType>(index ^ unused_offset_for_label));
@@ -325,8 +575,44 @@ class DictionaryBuilder {
       }
     }
   }
+
+  // Gets the word of a unit in the bitmaps.
+  static BaseType WordId(IndexType index) {
+    return (index % UNFIXED_SIZE) / NUM_OF_BITS_PER_WORD;
+  }
+
+  // Moves bit i of a word to bit i ^ (distance % 64) by swapping bits,
+  // pairs, nibbles, etc. of the word, without branching on distance.
+  static WordType Permute(WordType word, BaseType distance) {
+    static const WordType MASKS[] = {
+      0x5555555555555555ULL, 0x3333333333333333ULL, 0x0F0F0F0F0F0F0F0FULL,
+      0x00FF00FF00FF00FFULL, 0x0000FFFF0000FFFFULL, 0x00000000FFFFFFFFULL
+    };
+    for (BaseType i = 0; i < 6; ++i) {
+      WordType mask =
+          MASKS[i] & (0 - static_cast<WordType>((distance >> i) & 1));
+      WordType delta = ((word >> (1U << i)) ^ word) & mask;
+      word ^= delta ^ (delta << (1U << i));
+    }
+    return word;
+  }
+
+  static BaseType FindLowestBit(WordType word) {
+#ifdef __GNUC__
+    return static_cast<BaseType>(__builtin_ctzll(word));
+#else  // __GNUC__
+    BaseType bit = 0;
+    while (!((word >> bit) & 1)) {
+      ++bit;
+    }
+    return bit;
+#endif  // __GNUC__
+  }
 };
 
+typedef BasicDictionaryBuilder<DictionaryUnit> DictionaryBuilder;
+typedef BasicDictionaryBuilder<DictionaryUnit64> DictionaryBuilder64;
+
 }  // namespace dawgdic
 
 #endif  // DAWGDIC_DICTIONARY_BUILDER_H
@@ -1,20 +1,31 @@
 #ifndef DAWGDIC_DICTIONARY_UNIT_H
 #define DAWGDIC_DICTIONARY_UNIT_H
 
+#include <stdint.h>
+
+#include <type_traits>
+
 #include "base-types.h"
 
 namespace dawgdic {
 
-// Unit of a dictionary.
-class DictionaryUnit
+// Unit of a dictionary, stored in an unsigned integer of type T. 32-bit
+// units limit a dictionary to 2^29 units and values to 31 bits. 64-bit
+// units take twice the memory, but have no practical limit.
+template <typename T>
+class BasicDictionaryUnit
 {
  public:
-  static const BaseType OFFSET_MAX = static_cast<BaseType>(1) << 21;
-  static const BaseType IS_LEAF_BIT = static_cast<BaseType>(1) << 31;
-  static const BaseType HAS_LEAF_BIT = static_cast<BaseType>(1) << 8;
-  static const BaseType EXTENSION_BIT = static_cast<BaseType>(1) << 9;
+  // Types of indices and values of a dictionary of these units.
+  typedef T IndexType;
+  typedef typename std::make_signed<T>::type ValueType;
 
-  DictionaryUnit() : base_(0) {}
+  static const T OFFSET_MAX = static_cast<T>(1) << (sizeof(T) * 8 - 11);
+  static const T IS_LEAF_BIT = static_cast<T>(1) << (sizeof(T) * 8 - 1);
+  static const T HAS_LEAF_BIT = static_cast<T>(1) << 8;
+  static const T EXTENSION_BIT = static_cast<T>(1) << 9;
+
+  BasicDictionaryUnit() : base_(0) {}
 
   // Sets a flag to show that a unit has a leaf as a child.
   void set_has_leaf() {
@@ -22,14 +33,14 @@ class DictionaryUnit
   }
   // Sets a value to a leaf unit.
   void set_value(ValueType value) {
-    base_ = static_cast<BaseType>(value) | IS_LEAF_BIT;
+    base_ = static_cast<T>(value) | IS_LEAF_BIT;
   }
   // Sets a label to a non-leaf unit.
   void set_label(UCharType label) {
-    base_ = (base_ & ~static_cast<BaseType>(0xFF)) | label;
+    base_ = (base_ & ~static_cast<T>(0xFF)) | label;
   }
   // Sets an offset to a non-leaf unit.
-  bool set_offset(BaseType offset) {
+  bool set_offset(T offset) {
     if (offset >= (OFFSET_MAX << 8)) {
       return false;
     }
@@ -52,20 +63,41 @@ class DictionaryUnit
     return static_cast<ValueType>(base_ & ~IS_LEAF_BIT);
   }
   // Reads a label with a leaf flag from a non-leaf unit.
-  BaseType label() const {
+  T label() const {
     return base_ & (IS_LEAF_BIT | 0xFF);
   }
   // Reads an offset to child units from a non-leaf unit.
-  BaseType offset() const {
+  T offset() const {
     return (base_ >> 10) << ((base_ & EXTENSION_BIT) >> 6);
   }
 
+  // Converts a unit that was written on a machine with another byte order.
+  void SwapByteOrder() {
+    T base = 0;
+    for (SizeType i = 0; i < sizeof(T); ++i) {
+      base = (base << 8) | ((base_ >> (i * 8)) & 0xFF);
+    }
+    base_ = base;
+  }
+
  private:
-  BaseType base_;
+  T base_;
 
   // Copyable.
 };
 
+template <typename T>
+const T BasicDictionaryUnit<T>::OFFSET_MAX;
+template <typename T>
+const T BasicDictionaryUnit<T>::IS_LEAF_BIT;
+template <typename T>
+const T BasicDictionaryUnit<T>::HAS_LEAF_BIT;
+template <typename T>
+const T BasicDictionaryUnit<T>::EXTENSION_BIT;
+
+typedef BasicDictionaryUnit<BaseType> DictionaryUnit;
+typedef BasicDictionaryUnit<uint64_t> DictionaryUnit64;
+
 }  // namespace dawgdic
 
 #endif  // DAWGDIC_DICTIONARY_UNIT_H
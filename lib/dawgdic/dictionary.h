@@ -9,35 +9,44 @@
 
 namespace dawgdic {
 
-// Dictionary class for retrieval and binary I/O.
-class Dictionary {
+class Guide;
+
+// Dictionary class for retrieval and binary I/O, with units of type Unit.
+template <typename Unit>
+class BasicDictionary {
  public:
-  Dictionary() : units_(NULL), size_(0), units_buf_() {}
+  typedef Unit UnitType;
+  typedef typename Unit::IndexType IndexType;
+  typedef typename Unit::ValueType ValueType;
+  // Type of guides for completing keys.
+  typedef Guide GuideType;
+
+  BasicDictionary() : units_(NULL), size_(0), units_buf_() {}
 
-  const DictionaryUnit *units() const {
+  const Unit *units() const {
     return units_;
   }
   SizeType size() const {
     return size_;
   }
   SizeType total_size() const {
-    return sizeof(DictionaryUnit) * size_;
+    return sizeof(Unit) * size_;
   }
   SizeType file_size() const {
     return sizeof(BaseType) + total_size();
   }
 
   // Root index.
-  BaseType root() const {
+  IndexType root() const {
     return 0;
   }
 
   // Checks if a given index is related to the end of a key.
-  inline bool has_value(BaseType index) const {
+  inline bool has_value(IndexType index) const {
     return units_[index].has_leaf();
   }
   // Gets a value from a given index.
-  inline ValueType value(BaseType index) const {
+  inline ValueType value(IndexType index) const {
     return units_[index ^ units_[index].offset()].value();
   }
 
@@ -48,9 +57,9 @@ class Dictionary {
     }
 
     SizeType size = static_cast<SizeType>(base_size);
-    std::vector<DictionaryUnit> units_buf(size);
+    std::vector<Unit> units_buf(size);
     if (!read(stream, reinterpret_cast<char *>(&units_buf[0]),
-                     sizeof(DictionaryUnit) * size)) {
+                     sizeof(Unit) * size)) {
       return false;
     }
 
@@ -64,7 +73,7 @@ class Dictionary {
       return false;
     }
 
-    if (!write(stream, const_cast<DictionaryUnit*>(units_), sizeof(DictionaryUnit) * size_)) {
+    if (!write(stream, const_cast<Unit *>(units_), sizeof(Unit) * size_)) {
       return false;
     }
 
@@ -72,16 +81,44 @@ class Dictionary {
 
   }
 
+  // Reads a given number of units without a size prefix.
+  bool ReadUnits(IOFunction read, void *stream, SizeType size,
+                 bool swap_byte_order = false) {
+    std::vector<Unit> units_buf(size);
+    if (size != 0 && !read(stream, reinterpret_cast<char *>(&units_buf[0]),
+                           sizeof(Unit) * size)) {
+      return false;
+    }
+
+    if (swap_byte_order) {
+      for (SizeType i = 0; i < size; ++i) {
+        units_buf[i].SwapByteOrder();
+      }
+    }
+
+    SwapUnitsBuf(&units_buf);
+    return true;
+  }
+
+  // Writes units without a size prefix.
+  bool WriteUnits(IOFunction write, void *stream) const {
+    if (size_ == 0) {
+      return true;
+    }
+    return write(stream, const_cast<Unit *>(units_),
+                 sizeof(Unit) * size_) != 0;
+  }
+
   // Exact matching.
   bool Contains(const CharType *key) const {
-    BaseType index = root();
+    IndexType index = root();
     if (!Follow(key, &index)) {
       return false;
     }
     return has_value(index);
   }
   bool Contains(const CharType *key, SizeType length) const {
-    BaseType index = root();
+    IndexType index = root();
     if (!Follow(key, length, &index)) {
       return false;
     }
@@ -90,21 +127,21 @@ class Dictionary {
 
   // Exact matching.
   ValueType Find(const CharType *key) const {
-    BaseType index = root();
+    IndexType index = root();
     if (!Follow(key, &index)) {
       return -1;
     }
     return has_value(index) ? value(index) : -1;
   }
   ValueType Find(const CharType *key, SizeType length) const {
-    BaseType index = root();
+    IndexType index = root();
     if (!Follow(key, length, &index)) {
       return -1;
     }
     return has_value(index) ? value(index) : -1;
   }
   bool Find(const CharType *key, ValueType *value) const {
-    BaseType index = root();
+    IndexType index = root();
     if (!Follow(key, &index) || !has_value(index)) {
       return false;
     }
@@ -112,7 +149,7 @@ class Dictionary {
     return true;
   }
   bool Find(const CharType *key, SizeType length, ValueType *value) const {
-    BaseType index = root();
+    IndexType index = root();
     if (!Follow(key, length, &index) || !has_value(index)) {
       return false;
     }
@@ -121,8 +158,8 @@ class Dictionary {
   }
 
   // Follows a transition.
-  inline bool Follow(CharType label, BaseType *index) const {
-    BaseType next_index =
+  inline bool Follow(CharType label, IndexType *index) const {
+    IndexType next_index =
         *index ^ units_[*index].offset() ^ static_cast<UCharType>(label);
     if (units_[next_index].label() != static_cast<UCharType>(label)) {
       return false;
@@ -132,13 +169,13 @@ class Dictionary {
   }
 
   // Follows transitions.
-  bool Follow(const CharType *s, BaseType *index) const {
+  bool Follow(const CharType *s, IndexType *index) const {
     while (*s != '\0' && Follow(*s, index)) {
       ++s;
     }
     return *s == '\0';
   }
-  bool Follow(const CharType *s, BaseType *index, SizeType *count) const {
+  bool Follow(const CharType *s, IndexType *index, SizeType *count) const {
     while (*s != '\0' && Follow(*s, index)) {
       ++s, ++*count;
     }
@@ -146,7 +183,7 @@ class Dictionary {
   }
 
   // Follows transitions.
-  bool Follow(const CharType *s, SizeType length, BaseType *index) const {
+  bool Follow(const CharType *s, SizeType length, IndexType *index) const {
     for (SizeType i = 0; i < length; ++i) {
       if (!Follow(s[i], index)) {
         return false;
@@ -154,7 +191,7 @@ class Dictionary {
     }
     return true;
   }
-  bool Follow(const CharType *s, SizeType length, BaseType *index,
+  bool Follow(const CharType *s, SizeType length, IndexType *index,
               SizeType *count) const {
     for (SizeType i = 0; i < length; ++i, ++*count) {
       if (!Follow(s[i], index)) {
@@ -167,26 +204,26 @@ class Dictionary {
   // Maps memory with its size.
   const void *Map(const void *address) {
     Clear();
-    units_ = reinterpret_cast<const DictionaryUnit *>(
+    units_ = reinterpret_cast<const Unit *>(
         static_cast<const BaseType *>(address) + 1);
     size_ = *static_cast<const BaseType *>(address);
-    return reinterpret_cast<const uint8_t*>(address) + size_ * sizeof(DictionaryUnit) + sizeof(BaseType);
+    return reinterpret_cast<const uint8_t*>(address) + size_ * sizeof(Unit) + sizeof(BaseType);
   }
-  /*void Map(const void *address, SizeType size) {
+  void Map(const void *address, SizeType size) {
     Clear();
-    units_ = static_cast<const DictionaryUnit *>(address);
+    units_ = static_cast<const Unit *>(address);
     size_ = size;
-  }*/
+  }
 
   // Initializes a dictionary.
   void Clear() {
     units_ = NULL;
     size_ = 0;
-    std::vector<DictionaryUnit>(0).swap(units_buf_);
+    std::vector<Unit>(0).swap(units_buf_);
   }
 
   // Swaps dictionaries.
-  void Swap(Dictionary *dic) {
+  void Swap(BasicDictionary *dic) {
     std::swap(units_, dic->units_);
     std::swap(size_, dic->size_);
     units_buf_.swap(dic->units_buf_);
@@ -198,7 +235,7 @@ class Dictionary {
       return;
     }
 
-    std::vector<DictionaryUnit> units_buf(units_buf_);
+    std::vector<Unit> units_buf(units_buf_);
     SwapUnitsBuf(&units_buf);
   }
 
@@ -206,22 +243,25 @@ public:
   // Following member function is called from DawgBuilder.
 
   // Swaps buffers for units.
-  void SwapUnitsBuf(std::vector<DictionaryUnit> *units_buf) {
+  void SwapUnitsBuf(std::vector<Unit> *units_buf) {
     units_ = &(*units_buf)[0];
-    size_ = static_cast<BaseType>(units_buf->size());
+    size_ = units_buf->size();
     units_buf_.swap(*units_buf);
   }
 
  private:
-  const DictionaryUnit *units_;
+  const Unit *units_;
   SizeType size_;
-  std::vector<DictionaryUnit> units_buf_;
+  std::vector<Unit> units_buf_;
 
   // Disallows copies.
-  Dictionary(const Dictionary &);
-  Dictionary &operator=(const Dictionary &);
+  BasicDictionary(const BasicDictionary &);
+  BasicDictionary &operator=(const BasicDictionary &);
 };
 
+typedef BasicDictionary<DictionaryUnit> Dictionary;
+typedef BasicDictionary<DictionaryUnit64> Dictionary64;
+
 }  // namespace dawgdic
 
 #endif  // DAWGDIC_DICTIONARY_H
@@ -0,0 +1,381 @@
+#ifndef DAWGDIC_EXTERNAL_SORTER_H
+#define DAWGDIC_EXTERNAL_SORTER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "base-types.h"
+
+namespace dawgdic {
+
+// Sorts keys that do not fit into memory. Keys are collected in a buffer of
+// bounded size, which is sorted and written to a temporary file (a run)
+// whenever it is full. Finish() merges the runs, and Next() then returns
+// the keys in byte order without duplicates.
+class ExternalSorter {
+ public:
+  enum {
+    // Default size of the key buffer in bytes.
+    DEFAULT_MEMORY_LIMIT = 1 << 28,
+    // Maximum number of runs that are merged at once. Larger numbers of
+    // runs are merged in several passes.
+    MAX_NUM_OF_RUNS_PER_MERGE = 128,
+    // Size of the stdio buffer of a run.
+    RUN_BUFFER_SIZE = 1 << 16
+  };
+
+  explicit ExternalSorter(SizeType memory_limit = DEFAULT_MEMORY_LIMIT,
+                          const char *tmp_dir = NULL)
+    : memory_limit_(memory_limit), tmp_dir_(tmp_dir != NULL ? tmp_dir : ""),
+      arena_(), refs_(), runs_(), readers_(), heap_(RunGreater(&readers_)),
+      cursor_(0), key_(), has_key_(false), is_finished_(false),
+      failed_(false), num_of_keys_(0), num_of_merged_runs_(0) {}
+  ~ExternalSorter() {
+    Clear();
+  }
+
+  // Number of inserted keys, including duplicates.
+  SizeType num_of_keys() const {
+    return num_of_keys_;
+  }
+  // Number of runs written to temporary files.
+  SizeType num_of_runs() const {
+    return runs_.size() + num_of_merged_runs_;
+  }
+  // Checks if writing or reading a temporary file has failed.
+  bool failed() const {
+    return failed_;
+  }
+
+  // These member functions are available only when Next() returns true.
+  const CharType *key() const {
+    return key_.empty() ? "" : &key_[0];
+  }
+  SizeType length() const {
+    return key_.size();
+  }
+
+  // Adds a key. Returns false if a run could not be written.
+  bool Insert(const CharType *key, SizeType length) {
+    if (is_finished_ || failed_) {
+      return false;
+    }
+    if (!refs_.empty() && arena_.size() + length +
+        (refs_.size() + 1) * sizeof(KeyRef) > memory_limit_) {
+      if (!WriteRun()) {
+        return false;
+      }
+    }
+    KeyRef ref = { arena_.size(), static_cast<uint32_t>(length) };
+    arena_.insert(arena_.end(), key, key + length);
+    refs_.push_back(ref);
+    ++num_of_keys_;
+    return true;
+  }
+
+  // Finishes inserting keys and starts merging runs.
+  bool Finish() {
+    if (is_finished_ || failed_) {
+      return false;
+    }
+    is_finished_ = true;
+
+    if (runs_.empty()) {
+      // All keys fit into memory.
+      SortRefs();
+      cursor_ = 0;
+      return true;
+    }
+
+    if (!refs_.empty() && !WriteRun()) {
+      return false;
+    }
+    std::vector<CharType>().swap(arena_);
+    std::vector<KeyRef>().swap(refs_);
+
+    while (runs_.size() > MAX_NUM_OF_RUNS_PER_MERGE) {
+      std::vector<std::FILE *> group(runs_.begin(),
+          runs_.begin() + MAX_NUM_OF_RUNS_PER_MERGE);
+      runs_.erase(runs_.begin(), runs_.begin() + MAX_NUM_OF_RUNS_PER_MERGE);
+
+      std::FILE *run = CreateRun();
+      bool ok = run != NULL && StartMerge(group);
+      while (ok && Next()) {
+        ok = WriteKey(run, key(), length());
+      }
+      ok = ok && !failed_ && std::fflush(run) == 0;
+      CloseRuns(&group);
+      if (run != NULL) {
+        if (ok) {
+          std::rewind(run);
+          runs_.push_back(run);
+          ++num_of_merged_runs_;
+        } else {
+          std::fclose(run);
+        }
+      }
+      if (!ok) {
+        failed_ = true;
+        return false;
+      }
+    }
+    return StartMerge(runs_);
+  }
+
+  // Gets the next key in byte order, skipping duplicates.
+  bool Next() {
+    if (!is_finished_ || failed_) {
+      return false;
+    }
+    if (readers_.empty()) {
+      while (cursor_ < refs_.size()) {
+        const KeyRef &ref = refs_[cursor_++];
+        const CharType *key = arena_.data() + ref.offset;
+        if (!has_key_ || !Equals(key, ref.length)) {
+          key_.assign(key, key + ref.length);
+          has_key_ = true;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    while (!heap_.empty()) {
+      SizeType id = heap_.top();
+      heap_.pop();
+      RunReader &reader = readers_[id];
+      bool is_new = !has_key_ || !Equals(
+          reader.key.empty() ? "" : &reader.key[0], reader.key.size());
+      if (is_new) {
+        key_.swap(reader.key);
+        has_key_ = true;
+      }
+      if (reader.Read()) {
+        heap_.push(id);
+      } else if (std::ferror(reader.file)) {
+        failed_ = true;
+        return false;
+      }
+      if (is_new) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Removes keys and temporary files.
+  void Clear() {
+    CloseRuns(&runs_);
+    std::vector<CharType>().swap(arena_);
+    std::vector<KeyRef>().swap(refs_);
+    readers_.clear();
+    heap_ = std::priority_queue<SizeType, std::vector<SizeType>,
+                                RunGreater>(RunGreater(&readers_));
+    cursor_ = 0;
+    key_.clear();
+    has_key_ = false;
+    is_finished_ = false;
+    failed_ = false;
+    num_of_keys_ = 0;
+    num_of_merged_runs_ = 0;
+  }
+
+ private:
+  struct KeyRef {
+    uint64_t offset;
+    uint32_t length;
+  };
+
+  // Reads length-prefixed keys from a run.
+  struct RunReader {
+    std::FILE *file;
+    std::vector<CharType> key;
+
+    bool Read() {
+      uint32_t length;
+      if (std::fread(&length, sizeof(length), 1, file) != 1) {
+        return false;
+      }
+      key.resize(length);
+      return length == 0 ||
+          std::fread(&key[0], 1, length, file) == length;
+    }
+  };
+
+  // Orders runs by their current keys for a min-heap.
+  class RunGreater {
+   public:
+    explicit RunGreater(const std::vector<RunReader> *readers)
+      : readers_(readers) {}
+
+    bool operator()(SizeType lhs, SizeType rhs) const {
+      const std::vector<CharType> &a = (*readers_)[lhs].key;
+      const std::vector<CharType> &b = (*readers_)[rhs].key;
+      int result = Compare(a.empty() ? "" : &a[0], a.size(),
+                           b.empty() ? "" : &b[0], b.size());
+      return result > 0 || (result == 0 && lhs > rhs);
+    }
+
+   private:
+    const std::vector<RunReader> *readers_;
+  };
+
+  // Orders keys in the buffer.
+  class RefLess {
+   public:
+    explicit RefLess(const std::vector<CharType> *arena) : arena_(arena) {}
+
+    bool operator()(const KeyRef &lhs, const KeyRef &rhs) const {
+      return Compare(arena_->data() + lhs.offset, lhs.length,
+                     arena_->data() + rhs.offset, rhs.length) < 0;
+    }
+
+   private:
+    const std::vector<CharType> *arena_;
+  };
+
+  SizeType memory_limit_;
+  std::string tmp_dir_;
+  std::vector<CharType> arena_;
+  std::vector<KeyRef> refs_;
+  std::vector<std::FILE *> runs_;
+  std::vector<RunReader> readers_;
+  std::priority_queue<SizeType, std::vector<SizeType>, RunGreater> heap_;
+  SizeType cursor_;
+  std::vector<CharType> key_;
+  bool has_key_;
+  bool is_finished_;
+  bool failed_;
+  SizeType num_of_keys_;
+  SizeType num_of_merged_runs_;
+
+  // Disallows copies.
+  ExternalSorter(const ExternalSorter &);
+  ExternalSorter &operator=(const ExternalSorter &);
+
+  // Compares keys as unsigned bytes, like DawgBuilder does.
+  static int Compare(const CharType *a, SizeType a_length,
+                     const CharType *b, SizeType b_length) {
+    int result = std::memcmp(a, b, std::min(a_length, b_length));
+    if (result != 0) {
+      return result;
+    }
+    return (a_length < b_length) ? -1 : (a_length > b_length) ? 1 : 0;
+  }
+
+  bool Equals(const CharType *key, SizeType length) const {
+    return length == key_.size() &&
+        (length == 0 || std::memcmp(key, &key_[0], length) == 0);
+  }
+
+  void SortRefs() {
+    if (!refs_.empty()) {
+      std::sort(refs_.begin(), refs_.end(), RefLess(&arena_));
+    }
+  }
+
+  // Sorts the buffer and writes its unique keys to a new run.
+  bool WriteRun() {
+    SortRefs();
+    std::FILE *run = CreateRun();
+    if (run == NULL) {
+      failed_ = true;
+      return false;
+    }
+    const KeyRef *last = NULL;
+    for (SizeType i = 0; i < refs_.size(); ++i) {
+      const KeyRef &ref = refs_[i];
+      if (last != NULL && Compare(arena_.data() + last->offset, last->length,
+          arena_.data() + ref.offset, ref.length) == 0) {
+        continue;
+      }
+      if (!WriteKey(run, arena_.data() + ref.offset, ref.length)) {
+        std::fclose(run);
+        failed_ = true;
+        return false;
+      }
+      last = &ref;
+    }
+    if (std::fflush(run) != 0) {
+      std::fclose(run);
+      failed_ = true;
+      return false;
+    }
+    std::rewind(run);
+    runs_.push_back(run);
+
+    arena_.clear();
+    refs_.clear();
+    return true;
+  }
+
+  static bool WriteKey(std::FILE *run, const CharType *key,
+                       SizeType length) {
+    uint32_t length32 = static_cast<uint32_t>(length);
+    return std::fwrite(&length32, sizeof(length32), 1, run) == 1 &&
+        (length == 0 || std::fwrite(key, 1, length, run) == length);
+  }
+
+  // Creates a temporary file that is removed when it is closed.
+  std::FILE *CreateRun() const {
+    std::FILE *run = NULL;
+    if (tmp_dir_.empty()) {
+      run = std::tmpfile();
+    } else {
+      std::string path = tmp_dir_ + "/simtrie-run-XXXXXX";
+      std::vector<char> buf(path.begin(), path.end());
+      buf.push_back('\0');
+      int fd = ::mkstemp(&buf[0]);
+      if (fd < 0) {
+        return NULL;
+      }
+      ::unlink(&buf[0]);
+      run = ::fdopen(fd, "w+b");
+      if (run == NULL) {
+        ::close(fd);
+      }
+    }
+    if (run != NULL) {
+      std::setvbuf(run, NULL, _IOFBF, RUN_BUFFER_SIZE);
+    }
+    return run;
+  }
+
+  // Starts merging runs, which must not be closed before merging is done.
+  bool StartMerge(const std::vector<std::FILE *> &runs) {
+    readers_.clear();
+    heap_ = std::priority_queue<SizeType, std::vector<SizeType>,
+                                RunGreater>(RunGreater(&readers_));
+    has_key_ = false;
+
+    readers_.resize(runs.size());
+    for (SizeType i = 0; i < runs.size(); ++i) {
+      readers_[i].file = runs[i];
+      if (readers_[i].Read()) {
+        heap_.push(i);
+      } else if (std::ferror(runs[i])) {
+        failed_ = true;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static void CloseRuns(std::vector<std::FILE *> *runs) {
+    for (SizeType i = 0; i < runs->size(); ++i) {
+      std::fclose((*runs)[i]);
+    }
+    runs->clear();
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_EXTERNAL_SORTER_H
@@ -0,0 +1,172 @@
+#ifndef DAWGDIC_FILE_FORMAT_H
+#define DAWGDIC_FILE_FORMAT_H
+
+#include <stdint.h>
+#include <cstring>
+
+#include "base-types.h"
+
+namespace dawgdic {
+
+// Entry of the section table. A section is a block of data that starts at
+// an aligned offset of the file.
+struct FileSection {
+  uint32_t type;
+  uint32_t flags;
+  // Offset from the start of the file in bytes.
+  uint64_t offset;
+  // Size of the section in bytes, without padding.
+  uint64_t size;
+  // Number of units stored in the section.
+  uint64_t count;
+};
+
+// Header at the start of a file. It is followed by the section table.
+// All integers are stored in the byte order of the machine that wrote the
+// file, which is recorded in byte_order.
+struct FileHeader {
+  char magic[8];
+  uint32_t byte_order;
+  uint16_t major_version;
+  uint16_t minor_version;
+  uint32_t flags;
+  uint32_t alignment;
+  uint32_t num_of_sections;
+  uint32_t section_table_offset;
+  uint64_t num_of_keys;
+  uint8_t reserved[24];
+};
+
+static_assert(sizeof(FileSection) == 32, "unexpected size of FileSection");
+static_assert(sizeof(FileHeader) == 64, "unexpected size of FileHeader");
+
+class FileFormat {
+ public:
+  enum {
+    // Readers reject files with a newer major version. Minor versions only
+    // add sections that older readers skip.
+    MAJOR_VERSION = 2,
+    MINOR_VERSION = 1,
+    // Files are written with the oldest major version that supports their
+    // flags, so that files without new features stay readable for older
+    // readers.
+    MIN_MAJOR_VERSION = 1,
+    // Default alignment of sections (a cache line).
+    DEFAULT_ALIGNMENT = 64,
+    // Alignment of sections suitable for page-wise mapping.
+    PAGE_ALIGNMENT = 4096
+  };
+
+  enum SectionType {
+    DICTIONARY_SECTION = 1,
+    GUIDE_SECTION = 2,
+    METADATA_SECTION = 3,
+    VALUES_SECTION = 4,
+    // A LOUDS trie, which replaces the dictionary and the guide.
+    LOUDS_SECTION = 5,
+    // Dictionary units with their guide labels, which replace the
+    // dictionary and the guide.
+    INTERLEAVED_SECTION = 6,
+    // Counts of keys for ranks, with 64-bit units in files with wide
+    // units and 32-bit units otherwise. Added in version 2.1.
+    RANKS_SECTION = 7
+  };
+
+  enum HeaderFlag {
+    // Dictionary units are 64-bit. Needs version 2.
+    WIDE_UNITS_FLAG = 1 << 0,
+    // Keys are stored in a LOUDS trie instead of a dictionary. Needs
+    // version 2.
+    SUCCINCT_FLAG = 1 << 1,
+    // Dictionary units carry their guide labels. Needs version 2.
+    INTERLEAVED_FLAG = 1 << 2,
+    // Flags known to this implementation.
+    KNOWN_FLAGS = WIDE_UNITS_FLAG | SUCCINCT_FLAG | INTERLEAVED_FLAG
+  };
+
+  static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  // Initializes a header for a file written on this machine.
+  static void InitHeader(FileHeader *header) {
+    std::memset(header, 0, sizeof(FileHeader));
+    std::memcpy(header->magic, Magic(), sizeof(header->magic));
+    header->byte_order = BYTE_ORDER_MARK;
+    header->major_version = MIN_MAJOR_VERSION;
+    header->minor_version = MINOR_VERSION;
+    header->alignment = DEFAULT_ALIGNMENT;
+    header->section_table_offset = sizeof(FileHeader);
+  }
+
+  // Sets a header flag and the major version that it needs.
+  static void SetFlag(FileHeader *header, HeaderFlag flag) {
+    header->flags |= flag;
+    if (flag == WIDE_UNITS_FLAG || flag == SUCCINCT_FLAG ||
+        flag == INTERLEAVED_FLAG) {
+      header->major_version = 2;
+    }
+  }
+
+  // Checks the magic number.
+  static bool HasMagic(const FileHeader &header) {
+    return std::memcmp(header.magic, Magic(), sizeof(header.magic)) == 0;
+  }
+  // Checks if a file was written on a machine with a different byte order.
+  static bool IsSwapped(const FileHeader &header) {
+    return header.byte_order == SwapBytes(BYTE_ORDER_MARK);
+  }
+  // Checks if a header can be read by this implementation. Headers of
+  // swapped files must be converted with SwapHeader() first.
+  static bool IsSupported(const FileHeader &header) {
+    return HasMagic(header) && header.byte_order == BYTE_ORDER_MARK &&
+        header.major_version >= MIN_MAJOR_VERSION &&
+        header.major_version <= MAJOR_VERSION &&
+        (header.flags & ~static_cast<uint32_t>(KNOWN_FLAGS)) == 0 &&
+        header.section_table_offset >= sizeof(FileHeader) &&
+        header.alignment != 0;
+  }
+
+  // Converts a header or a section from the other byte order.
+  static void SwapHeader(FileHeader *header) {
+    header->byte_order = SwapBytes(header->byte_order);
+    header->major_version = SwapBytes(header->major_version);
+    header->minor_version = SwapBytes(header->minor_version);
+    header->flags = SwapBytes(header->flags);
+    header->alignment = SwapBytes(header->alignment);
+    header->num_of_sections = SwapBytes(header->num_of_sections);
+    header->section_table_offset = SwapBytes(header->section_table_offset);
+    header->num_of_keys = SwapBytes(header->num_of_keys);
+  }
+  static void SwapSection(FileSection *section) {
+    section->type = SwapBytes(section->type);
+    section->flags = SwapBytes(section->flags);
+    section->offset = SwapBytes(section->offset);
+    section->size = SwapBytes(section->size);
+    section->count = SwapBytes(section->count);
+  }
+
+  // Rounds up an offset to a multiple of a given alignment.
+  static uint64_t Align(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+
+  static uint16_t SwapBytes(uint16_t x) {
+    return static_cast<uint16_t>((x >> 8) | (x << 8));
+  }
+  static uint32_t SwapBytes(uint32_t x) {
+    return (x >> 24) | ((x >> 8) & 0xFF00) |
+        ((x << 8) & 0xFF0000) | (x << 24);
+  }
+  static uint64_t SwapBytes(uint64_t x) {
+    return (static_cast<uint64_t>(SwapBytes(static_cast<uint32_t>(x))) << 32)
+        | SwapBytes(static_cast<uint32_t>(x >> 32));
+  }
+
+ private:
+  static const char *Magic() {
+    return "SIMTRIE";
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_FILE_FORMAT_H
@@ -22,6 +22,12 @@ class GuideBuilder {
   const Dictionary &dic_;
   Guide *guide_;
 
+  // A node whose children are being visited.
+  struct Node {
+    BaseType dawg_child_index;
+    BaseType dic_index;
+  };
+
   std::vector<GuideUnit> units_;
   std::vector<UCharType> is_fixed_table_;
 
@@ -35,7 +41,7 @@ class GuideBuilder {
   bool BuildGuide() {
     // Initializes units and flags.
     units_.resize(dic_.size());
-    is_fixed_table_.resize(dic_.size() / 8, '\0');
+    is_fixed_table_.resize((dic_.size() + 7) / 8, '\0');
 
     if (dawg_.size() <= 1) {
       return true;
@@ -49,46 +55,60 @@ class GuideBuilder {
     return true;
   }
 
-  // Builds a guide recursively.
+  // Builds a guide in depth-first order, which is the order in which the
+  // dictionary builder has placed units. Instead of recursing once per
+  // character of a key, nodes wait on a stack with the next child to visit.
   bool BuildGuide(BaseType dawg_index, BaseType dic_index) {
-    if (is_fixed(dic_index)) {
-      return true;
-    }
-    set_is_fixed(dic_index);
+    std::vector<Node> stack;
+    Enter(dawg_index, dic_index, &stack);
 
-    // Finds the first non-terminal child.
-    BaseType dawg_child_index = dawg_.child(dawg_index);
-    if (dawg_.label(dawg_child_index) == '\0') {
-      dawg_child_index = dawg_.sibling(dawg_child_index);
+    while (!stack.empty()) {
+      Node &node = stack.back();
+      BaseType dawg_child_index = node.dawg_child_index;
       if (dawg_child_index == 0) {
-        return true;
+        stack.pop_back();
+        continue;
       }
-    }
-    units_[dic_index].set_child(dawg_.label(dawg_child_index));
 
-    do {
-      UCharType child_label = dawg_.label(dawg_child_index);
-      BaseType dic_child_index = dic_index;
-      if (!dic_.Follow(child_label, &dic_child_index)) {
-        return false;
-      }
-
-      if (!BuildGuide(dawg_child_index, dic_child_index)) {
+      BaseType dic_child_index = node.dic_index;
+      if (!dic_.Follow(dawg_.label(dawg_child_index), &dic_child_index)) {
         return false;
       }
 
       BaseType dawg_sibling_index = dawg_.sibling(dawg_child_index);
-      UCharType sibling_label = dawg_.label(dawg_sibling_index);
       if (dawg_sibling_index != 0) {
-        units_[dic_child_index].set_sibling(sibling_label);
+        units_[dic_child_index].set_sibling(dawg_.label(dawg_sibling_index));
       }
+      node.dawg_child_index = dawg_sibling_index;
 
-      dawg_child_index = dawg_sibling_index;
-    } while (dawg_child_index != 0);
-
+      // Descends into the child, which invalidates node.
+      Enter(dawg_child_index, dic_child_index, &stack);
+    }
     return true;
   }
 
+  // Sets the first non-terminal child of a node and pushes the node, unless
+  // it has been visited or has no such child.
+  void Enter(BaseType dawg_index, BaseType dic_index,
+             std::vector<Node> *stack) {
+    if (is_fixed(dic_index)) {
+      return;
+    }
+    set_is_fixed(dic_index);
+
+    BaseType dawg_child_index = dawg_.child(dawg_index);
+    if (dawg_.label(dawg_child_index) == '\0') {
+      dawg_child_index = dawg_.sibling(dawg_child_index);
+      if (dawg_child_index == 0) {
+        return;
+      }
+    }
+    units_[dic_index].set_child(dawg_.label(dawg_child_index));
+
+    Node node = { dawg_child_index, dic_index };
+    stack->push_back(node);
+  }
+
   void set_is_fixed(BaseType index) {
     is_fixed_table_[index / 8] |= 1 << (index % 8);
   }
@@ -31,10 +31,10 @@ class Guide {
     return 0;
   }
 
-  UCharType child(BaseType index) const {
+  UCharType child(SizeType index) const {
     return units_[index].child();
   }
-  UCharType sibling(BaseType index) const {
+  UCharType sibling(SizeType index) const {
     return units_[index].sibling();
   }
 
@@ -103,6 +103,28 @@ class Guide {
 
   }
 
+  // Reads a given number of units without a size prefix. Guide units
+  // consist of single bytes and do not depend on the byte order.
+  bool ReadUnits(IOFunction read, void *stream, SizeType size) {
+    std::vector<GuideUnit> units_buf(size);
+    if (size != 0 && !read(stream, reinterpret_cast<char *>(&units_buf[0]),
+                           sizeof(GuideUnit) * size)) {
+      return false;
+    }
+
+    SwapUnitsBuf(&units_buf);
+    return true;
+  }
+
+  // Writes units without a size prefix.
+  bool WriteUnits(IOFunction write, void *stream) const {
+    if (size_ == 0) {
+      return true;
+    }
+    return write(stream, const_cast<GuideUnit*>(units_),
+                 sizeof(GuideUnit) * size_) != 0;
+  }
+
   // Maps memory with its size.
   const void *Map(const void *address) {
     Clear();
@@ -111,11 +133,11 @@ class Guide {
     size_ = *static_cast<const BaseType *>(address);
     return reinterpret_cast<const uint8_t*>(address) + size_ * sizeof(GuideUnit) + sizeof(BaseType);
   }
-  /*void Map(const void *address, SizeType size) {
+  void Map(const void *address, SizeType size) {
     Clear();
     units_ = static_cast<const GuideUnit *>(address);
     size_ = size;
-  }*/
+  }
 
   // Swaps Guides.
   void Swap(Guide *guide) {
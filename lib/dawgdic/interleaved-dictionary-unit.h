@@ -0,0 +1,63 @@
+#ifndef DAWGDIC_INTERLEAVED_DICTIONARY_UNIT_H
+#define DAWGDIC_INTERLEAVED_DICTIONARY_UNIT_H
+
+#include <stdint.h>
+
+#include "dictionary-unit.h"
+#include "guide-unit.h"
+
+namespace dawgdic {
+
+// Unit of a dictionary with the labels of its guide unit, so that a walk
+// that completes keys reads one unit per node instead of a unit and a
+// guide unit from two arrays. It takes 8 bytes, 2 more than the two.
+class InterleavedDictionaryUnit {
+ public:
+  typedef DictionaryUnit::IndexType IndexType;
+  typedef DictionaryUnit::ValueType ValueType;
+
+  InterleavedDictionaryUnit() : unit_(), guide_unit_(), padding_(0) {}
+  InterleavedDictionaryUnit(const DictionaryUnit &unit,
+                            const GuideUnit &guide_unit)
+    : unit_(unit), guide_unit_(guide_unit), padding_(0) {}
+
+  // Accesses the dictionary unit.
+  bool has_leaf() const {
+    return unit_.has_leaf();
+  }
+  ValueType value() const {
+    return unit_.value();
+  }
+  IndexType label() const {
+    return unit_.label();
+  }
+  IndexType offset() const {
+    return unit_.offset();
+  }
+
+  // Accesses the guide unit.
+  UCharType child() const {
+    return guide_unit_.child();
+  }
+  UCharType sibling() const {
+    return guide_unit_.sibling();
+  }
+
+  // Converts a unit that was written on a machine with another byte order.
+  // Guide labels are single bytes.
+  void SwapByteOrder() {
+    unit_.SwapByteOrder();
+  }
+
+ private:
+  DictionaryUnit unit_;
+  GuideUnit guide_unit_;
+  // Pads units to 8 bytes, which are all written to files.
+  uint16_t padding_;
+
+  // Copyable.
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_INTERLEAVED_DICTIONARY_UNIT_H
@@ -0,0 +1,118 @@
+#ifndef DAWGDIC_KEY_ARENA_H
+#define DAWGDIC_KEY_ARENA_H
+
+#include <cstring>
+#include <vector>
+
+#include "key-sorter.h"
+
+namespace dawgdic {
+
+// Collects copies of keys in one contiguous block of memory, so that keys
+// can be sorted and passed to a builder without keeping the objects they
+// came from. Each key gets its insertion index as value.
+class KeyArena {
+ public:
+  KeyArena() : arena_(), offsets_(), keys_(), lengths_(), values_() {}
+
+  // These member functions are available after Finish().
+  const CharType * const *keys() const {
+    return keys_.empty() ? NULL : &keys_[0];
+  }
+  const SizeType *lengths() const {
+    return lengths_.empty() ? NULL : &lengths_[0];
+  }
+  const ValueType *values() const {
+    return values_.empty() ? NULL : &values_[0];
+  }
+
+  SizeType num_of_keys() const {
+    return lengths_.size();
+  }
+  // Number of bytes used by keys.
+  SizeType size() const {
+    return arena_.size();
+  }
+
+  // Adds a copy of a key. Returns false if a key is empty or contains '\0'.
+  bool Insert(const CharType *key, SizeType length) {
+    if (length == 0 || std::memchr(key, '\0', length) != NULL) {
+      return false;
+    }
+    Append(key, length);
+    return true;
+  }
+
+  // Adds a copy of any key, for keys that are only sorted and never go
+  // into a dictionary.
+  void Append(const CharType *key, SizeType length) {
+    offsets_.push_back(arena_.size());
+    lengths_.push_back(length);
+    values_.push_back(static_cast<ValueType>(values_.size()));
+    arena_.insert(arena_.end(), key, key + length);
+  }
+
+  // Finishes inserting keys and resolves them to pointers.
+  void Finish() {
+    // Keys of an empty arena are all empty and point to an empty string.
+    const CharType *base = arena_.empty() ? "" : &arena_[0];
+    keys_.resize(offsets_.size());
+    for (SizeType i = 0; i < offsets_.size(); ++i) {
+      keys_[i] = base + offsets_[i];
+    }
+    std::vector<SizeType>(0).swap(offsets_);
+  }
+
+  // Sorts keys in byte order, along with their values.
+  void Sort(SizeType num_of_threads) {
+    KeySorter::Sort(keys_.empty() ? NULL : &keys_[0],
+                    lengths_.empty() ? NULL : &lengths_[0],
+                    values_.empty() ? NULL : &values_[0],
+                    keys_.size(), num_of_threads);
+  }
+
+  // Removes duplicates from sorted keys. Returns false if a key is smaller
+  // than its predecessor and sets index to it.
+  bool Unique(SizeType *index) {
+    SizeType num_of_keys = keys_.size();
+    bool result = KeySorter::Unique(keys_.empty() ? NULL : &keys_[0],
+                                    lengths_.empty() ? NULL : &lengths_[0],
+                                    values_.empty() ? NULL : &values_[0],
+                                    &num_of_keys, index);
+    keys_.resize(num_of_keys);
+    lengths_.resize(num_of_keys);
+    values_.resize(num_of_keys);
+    return result;
+  }
+
+  // Checks if sorted keys have no duplicates. If not, index is set to the
+  // first key that is not greater than its predecessor.
+  bool IsStrictlySorted(SizeType *index) const {
+    return KeySorter::IsStrictlySorted(keys(), lengths(), keys_.size(),
+                                       index);
+  }
+
+  // Removes all keys.
+  void Clear() {
+    std::vector<CharType>(0).swap(arena_);
+    std::vector<SizeType>(0).swap(offsets_);
+    std::vector<const CharType *>(0).swap(keys_);
+    std::vector<SizeType>(0).swap(lengths_);
+    std::vector<ValueType>(0).swap(values_);
+  }
+
+ private:
+  std::vector<CharType> arena_;
+  std::vector<SizeType> offsets_;
+  std::vector<const CharType *> keys_;
+  std::vector<SizeType> lengths_;
+  std::vector<ValueType> values_;
+
+  // Disallows copies.
+  KeyArena(const KeyArena &);
+  KeyArena &operator=(const KeyArena &);
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_KEY_ARENA_H
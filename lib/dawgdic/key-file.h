@@ -0,0 +1,144 @@
+#ifndef DAWGDIC_KEY_FILE_H
+#define DAWGDIC_KEY_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <vector>
+
+#include "key-sorter.h"
+
+namespace dawgdic {
+
+// Reads keys from a text file with one key per line, or per any other
+// delimiter. The file is mapped into memory and keys point into the
+// mapping, so no key is copied.
+class KeyFile {
+ public:
+  KeyFile() : address_(NULL), size_(0), keys_(), lengths_() {}
+  ~KeyFile() {
+    Clear();
+  }
+
+  const CharType * const *keys() const {
+    return keys_.empty() ? NULL : &keys_[0];
+  }
+  const SizeType *lengths() const {
+    return lengths_.empty() ? NULL : &lengths_[0];
+  }
+  SizeType num_of_keys() const {
+    return keys_.size();
+  }
+
+  // Maps a file and splits it into keys. Empty keys are skipped. If the
+  // delimiter is '\n', a trailing '\r' is removed from each key.
+  bool Open(const char *path, CharType delimiter) {
+    Clear();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      return false;
+    }
+    size_ = static_cast<SizeType>(st.st_size);
+    if (size_ > 0) {
+      void *address = ::mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (address == MAP_FAILED) {
+        ::close(fd);
+        size_ = 0;
+        return false;
+      }
+      address_ = static_cast<const CharType *>(address);
+      ::posix_madvise(address, size_, POSIX_MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+
+    Split(delimiter);
+    return true;
+  }
+
+  // Checks that no key contains '\0'. If one does, its index is returned
+  // through index.
+  bool Validate(SizeType *index) const {
+    for (SizeType i = 0; i < keys_.size(); ++i) {
+      if (std::memchr(keys_[i], '\0', lengths_[i]) != NULL) {
+        *index = i;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Sorts keys in byte order and removes duplicates.
+  void Sort(SizeType num_of_threads) {
+    KeySorter::Sort(keys_.empty() ? NULL : &keys_[0],
+                    lengths_.empty() ? NULL : &lengths_[0], NULL,
+                    keys_.size(), num_of_threads);
+    SizeType index;
+    Unique(&index);
+  }
+
+  // Removes duplicates from keys that are already sorted. Returns false if
+  // a key is smaller than its predecessor and sets index to that key.
+  bool Unique(SizeType *index) {
+    SizeType num_of_keys = keys_.size();
+    bool result = KeySorter::Unique(keys_.empty() ? NULL : &keys_[0],
+                                    lengths_.empty() ? NULL : &lengths_[0],
+                                    NULL, &num_of_keys, index);
+    keys_.resize(num_of_keys);
+    lengths_.resize(num_of_keys);
+    return result;
+  }
+
+  // Unmaps the file.
+  void Clear() {
+    if (address_ != NULL) {
+      ::munmap(const_cast<CharType *>(address_), size_);
+    }
+    address_ = NULL;
+    size_ = 0;
+    std::vector<const CharType *>(0).swap(keys_);
+    std::vector<SizeType>(0).swap(lengths_);
+  }
+
+ private:
+  const CharType *address_;
+  SizeType size_;
+  std::vector<const CharType *> keys_;
+  std::vector<SizeType> lengths_;
+
+  // Disallows copies.
+  KeyFile(const KeyFile &);
+  KeyFile &operator=(const KeyFile &);
+
+  void Split(CharType delimiter) {
+    const CharType *p = address_;
+    const CharType *end = address_ + size_;
+    while (p < end) {
+      const CharType *q = static_cast<const CharType *>(
+          std::memchr(p, delimiter, end - p));
+      if (q == NULL) {
+        q = end;
+      }
+      SizeType length = q - p;
+      if (delimiter == '\n' && length > 0 && p[length - 1] == '\r') {
+        --length;
+      }
+      if (length > 0) {
+        keys_.push_back(p);
+        lengths_.push_back(length);
+      }
+      p = q + 1;
+    }
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_KEY_FILE_H
@@ -0,0 +1,241 @@
+#ifndef DAWGDIC_KEY_SORTER_H
+#define DAWGDIC_KEY_SORTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "base-types.h"
+
+namespace dawgdic {
+
+// Sorts keys in byte order with an in-place MSD radix sort. The top levels
+// of the sort split keys into buckets sequentially; the buckets are then
+// sorted on several threads.
+class KeySorter {
+ public:
+  enum {
+    // Ranges of fewer keys are sorted by comparison.
+    MIN_NUM_OF_RADIX_KEYS = 64,
+    // Number of tasks per thread, to balance uneven buckets.
+    NUM_OF_TASKS_PER_THREAD = 8
+  };
+
+  // Sorts keys together with their values. values may be NULL. The order
+  // of equal keys is unspecified.
+  static void Sort(const CharType **keys, SizeType *lengths,
+                   ValueType *values, SizeType num_of_keys,
+                   SizeType num_of_threads) {
+    std::vector<Entry> entries(num_of_keys);
+    for (SizeType i = 0; i < num_of_keys; ++i) {
+      entries[i].key = reinterpret_cast<const UCharType *>(keys[i]);
+      entries[i].length = lengths[i];
+      entries[i].value = values != NULL ? values[i] : 0;
+    }
+
+    SortEntries(entries.empty() ? NULL : &entries[0], num_of_keys,
+                num_of_threads);
+
+    for (SizeType i = 0; i < num_of_keys; ++i) {
+      keys[i] = reinterpret_cast<const CharType *>(entries[i].key);
+      lengths[i] = entries[i].length;
+      if (values != NULL) {
+        values[i] = entries[i].value;
+      }
+    }
+  }
+
+  // Removes duplicates from sorted keys and updates num_of_keys. Returns
+  // false if a key is smaller than its predecessor and sets index to it.
+  static bool Unique(const CharType **keys, SizeType *lengths,
+                     ValueType *values, SizeType *num_of_keys,
+                     SizeType *index) {
+    SizeType count = 0;
+    for (SizeType i = 0; i < *num_of_keys; ++i) {
+      if (count > 0) {
+        int result = Compare(keys[count - 1], lengths[count - 1],
+                             keys[i], lengths[i]);
+        if (result > 0) {
+          *index = i;
+          return false;
+        } else if (result == 0) {
+          continue;
+        }
+      }
+      keys[count] = keys[i];
+      lengths[count] = lengths[i];
+      if (values != NULL) {
+        values[count] = values[i];
+      }
+      ++count;
+    }
+    *num_of_keys = count;
+    return true;
+  }
+
+  // Checks if keys are sorted without duplicates. If not, index is set to
+  // the first key that is not greater than its predecessor.
+  static bool IsStrictlySorted(const CharType * const *keys,
+                               const SizeType *lengths, SizeType num_of_keys,
+                               SizeType *index) {
+    for (SizeType i = 1; i < num_of_keys; ++i) {
+      if (Compare(keys[i - 1], lengths[i - 1], keys[i], lengths[i]) >= 0) {
+        *index = i;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Compares keys as unsigned bytes, like DawgBuilder does.
+  static int Compare(const CharType *a, SizeType a_length,
+                     const CharType *b, SizeType b_length) {
+    int result = std::memcmp(a, b, std::min(a_length, b_length));
+    if (result != 0) {
+      return result;
+    }
+    return (a_length < b_length) ? -1 : (a_length > b_length) ? 1 : 0;
+  }
+
+ private:
+  struct Entry {
+    const UCharType *key;
+    SizeType length;
+    ValueType value;
+  };
+
+  // A range of entries whose first depth bytes are equal.
+  struct Task {
+    Entry *begin;
+    SizeType size;
+    SizeType depth;
+
+    bool operator<(const Task &task) const {
+      return size > task.size;
+    }
+  };
+
+  // Orders entries whose first depth bytes are equal.
+  class EntryLess {
+   public:
+    explicit EntryLess(SizeType depth) : depth_(depth) {}
+
+    bool operator()(const Entry &lhs, const Entry &rhs) const {
+      return Compare(reinterpret_cast<const CharType *>(lhs.key) + depth_,
+                     lhs.length - depth_,
+                     reinterpret_cast<const CharType *>(rhs.key) + depth_,
+                     rhs.length - depth_) < 0;
+    }
+
+   private:
+    SizeType depth_;
+  };
+
+  // Disallows instantiation.
+  KeySorter();
+
+  static void SortEntries(Entry *entries, SizeType num_of_entries,
+                          SizeType num_of_threads) {
+    if (num_of_threads <= 1 || num_of_entries < MIN_NUM_OF_RADIX_KEYS) {
+      SortRange(entries, num_of_entries, 0);
+      return;
+    }
+
+    // Splits large ranges until there are enough tasks for all threads.
+    SizeType max_task_size = num_of_entries /
+        (num_of_threads * NUM_OF_TASKS_PER_THREAD) + 1;
+    std::vector<Task> tasks;
+    std::vector<Task> pending;
+    Task task = { entries, num_of_entries, 0 };
+    pending.push_back(task);
+    while (!pending.empty()) {
+      task = pending.back();
+      pending.pop_back();
+      if (task.size <= max_task_size || task.size < MIN_NUM_OF_RADIX_KEYS) {
+        tasks.push_back(task);
+        continue;
+      }
+      SizeType bounds[258];
+      Partition(task.begin, task.size, task.depth, bounds);
+      for (SizeType i = 1; i <= 256; ++i) {
+        if (bounds[i + 1] - bounds[i] > 1) {
+          Task bucket = { task.begin + bounds[i], bounds[i + 1] - bounds[i],
+                          task.depth + 1 };
+          pending.push_back(bucket);
+        }
+      }
+    }
+    std::sort(tasks.begin(), tasks.end());
+
+    std::atomic<SizeType> next_task(0);
+    std::vector<std::thread> threads;
+    for (SizeType i = 0; i < num_of_threads && i < tasks.size(); ++i) {
+      threads.push_back(std::thread([&]() {
+        for (SizeType id = next_task++; id < tasks.size(); id = next_task++) {
+          SortRange(tasks[id].begin, tasks[id].size, tasks[id].depth);
+        }
+      }));
+    }
+    for (SizeType i = 0; i < threads.size(); ++i) {
+      threads[i].join();
+    }
+  }
+
+  // Sorts a range of entries whose first depth bytes are equal.
+  static void SortRange(Entry *entries, SizeType num_of_entries,
+                        SizeType depth) {
+    if (num_of_entries < MIN_NUM_OF_RADIX_KEYS) {
+      std::sort(entries, entries + num_of_entries, EntryLess(depth));
+      return;
+    }
+    SizeType bounds[258];
+    Partition(entries, num_of_entries, depth, bounds);
+    // Bucket 0 holds keys that end at depth, which are all equal.
+    for (SizeType i = 1; i <= 256; ++i) {
+      if (bounds[i + 1] - bounds[i] > 1) {
+        SortRange(entries + bounds[i], bounds[i + 1] - bounds[i], depth + 1);
+      }
+    }
+  }
+
+  // Rearranges entries by their bytes at depth (American flag sort). The
+  // entries of bucket i (0 to 256) are in [bounds[i], bounds[i + 1]).
+  static void Partition(Entry *entries, SizeType num_of_entries,
+                        SizeType depth, SizeType *bounds) {
+    SizeType counts[257] = { 0 };
+    for (SizeType i = 0; i < num_of_entries; ++i) {
+      ++counts[Byte(entries[i], depth)];
+    }
+
+    SizeType heads[257];
+    bounds[0] = 0;
+    for (SizeType i = 0; i < 257; ++i) {
+      heads[i] = bounds[i];
+      bounds[i + 1] = bounds[i] + counts[i];
+    }
+
+    for (SizeType i = 0; i < 257; ++i) {
+      SizeType end = bounds[i + 1];
+      while (heads[i] < end) {
+        Entry entry = entries[heads[i]];
+        SizeType byte = Byte(entry, depth);
+        while (byte != i) {
+          std::swap(entry, entries[heads[byte]++]);
+          byte = Byte(entry, depth);
+        }
+        entries[heads[i]++] = entry;
+      }
+    }
+  }
+
+  // Gets the byte at depth plus 1, or 0 if a key ends before depth.
+  static SizeType Byte(const Entry &entry, SizeType depth) {
+    return (depth < entry.length) ? entry.key[depth] + 1 : 0;
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_KEY_SORTER_H
@@ -8,9 +8,11 @@
 
 namespace dawgdic {
 
-class LinkTable {
+// Maps indices of dawg units to offsets of type T in a dictionary.
+template <typename T>
+class BasicLinkTable {
  public:
-  explicit LinkTable() : hash_table_() {}
+  explicit BasicLinkTable() : hash_table_() {}
 
   // Initializes a hash table.
   void Init(SizeType table_size) {
@@ -20,26 +22,26 @@ class LinkTable {
   }
 
   // Finds an offset that corresponds to a given index.
-  BaseType Find(BaseType index) const {
+  T Find(BaseType index) const {
     BaseType hash_id = FindId(index);
     return hash_table_[hash_id].second;
   }
 
   // Inserts an index with its offset.
-  void Insert(BaseType index, BaseType offset) {
+  void Insert(BaseType index, T offset) {
     BaseType hash_id = FindId(index);
     hash_table_[hash_id].first = index;
     hash_table_[hash_id].second = offset;
   }
 
  private:
-  typedef std::pair<BaseType, BaseType> PairType;
+  typedef std::pair<BaseType, T> PairType;
 
   std::vector<PairType> hash_table_;
 
   // Disallows copies.
-  LinkTable(const LinkTable &);
-  LinkTable &operator=(const LinkTable &);
+  BasicLinkTable(const BasicLinkTable &);
+  BasicLinkTable &operator=(const BasicLinkTable &);
 
   // Finds an Id from an upper table.
   BaseType FindId(BaseType index) const {
@@ -66,6 +68,8 @@ class LinkTable {
   }
 };
 
+typedef BasicLinkTable<BaseType> LinkTable;
+
 }  // namespace dawgdic
 
 #endif  // DAWGDIC_LINK_TABLE_H
@@ -0,0 +1,150 @@
+#ifndef DAWGDIC_LOUDS_BUILDER_H
+#define DAWGDIC_LOUDS_BUILDER_H
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "build-monitor.h"
+#include "dawg.h"
+#include "louds.h"
+
+namespace dawgdic {
+
+// Builds a LOUDS trie from a dawg.
+class LoudsBuilder {
+ public:
+  enum {
+    // Number of nodes between checks of the monitor.
+    MONITOR_INTERVAL = 1 << 12
+  };
+
+  // Builds a trie from a dawg, expanding states that are shared. Nodes are
+  // counted in monitor as units, through which the build can be cancelled.
+  static bool Build(const Dawg &dawg, Louds *louds,
+                    BuildMonitor *monitor = NULL) {
+    LoudsBuilder builder(dawg, monitor);
+    std::vector<Louds::UnitType> units;
+    if (!builder.BuildTrie(&units)) {
+      return false;
+    }
+    return louds->SwapUnitsBuf(&units);
+  }
+
+ private:
+  const Dawg &dawg_;
+  BuildMonitor *monitor_;
+  std::vector<uint64_t> tree_;
+  SizeType tree_size_;
+  std::vector<uint64_t> ends_;
+  std::vector<uint64_t> labels_;
+  std::vector<ValueType> values_;
+
+  LoudsBuilder(const Dawg &dawg, BuildMonitor *monitor)
+    : dawg_(dawg), monitor_(monitor), tree_(), tree_size_(0), ends_(),
+      labels_(), values_() {}
+
+  // Disallows copies.
+  LoudsBuilder(const LoudsBuilder &);
+  LoudsBuilder &operator=(const LoudsBuilder &);
+
+  // Walks the dawg in breadth-first order. Nodes are queued as the dawg
+  // index of the transition to them.
+  bool BuildTrie(std::vector<Louds::UnitType> *units) {
+    std::deque<BaseType> queue(1, dawg_.root());
+    std::vector<std::pair<UCharType, BaseType> > children;
+    SizeType num_of_nodes = 0;
+
+    AppendBit(&tree_, tree_size_++, true);
+    AppendBit(&tree_, tree_size_++, false);
+    AppendLabel(0, '\0');
+    while (!queue.empty()) {
+      BaseType dawg_index = queue.front();
+      queue.pop_front();
+      if (monitor_ != NULL && num_of_nodes % MONITOR_INTERVAL == 0) {
+        if (monitor_->is_cancelled()) {
+          return false;
+        }
+        monitor_->add_units(MONITOR_INTERVAL);
+      }
+
+      bool is_end = false;
+      children.clear();
+      for (BaseType dawg_child_index = dawg_.child(dawg_index);
+           dawg_child_index != 0;
+           dawg_child_index = dawg_.sibling(dawg_child_index)) {
+        if (dawg_.is_leaf(dawg_child_index)) {
+          is_end = true;
+          values_.push_back(dawg_.value(dawg_child_index));
+        } else {
+          children.push_back(std::make_pair(dawg_.label(dawg_child_index),
+                                            dawg_child_index));
+        }
+      }
+      std::sort(children.begin(), children.end());
+
+      AppendBit(&ends_, num_of_nodes++, is_end);
+      for (SizeType i = 0; i < children.size(); ++i) {
+        AppendBit(&tree_, tree_size_++, true);
+        AppendLabel(num_of_nodes + queue.size(), children[i].first);
+        queue.push_back(children[i].second);
+      }
+      AppendBit(&tree_, tree_size_++, false);
+    }
+
+    ValueType max_value = 0;
+    for (SizeType i = 0; i < values_.size(); ++i) {
+      max_value = std::max(max_value, values_[i]);
+    }
+    SizeType value_bits = 0;
+    while (value_bits < 32 &&
+           (static_cast<uint64_t>(max_value) >> value_bits) != 0) {
+      ++value_bits;
+    }
+
+    units->clear();
+    units->push_back(num_of_nodes);
+    units->push_back(value_bits);
+    BitVector::Build(tree_, tree_size_, units);
+    std::vector<uint64_t>().swap(tree_);
+    BitVector::Build(ends_, num_of_nodes, units);
+    units->insert(units->end(), labels_.begin(), labels_.end());
+    units->resize(units->size() + Louds::NumOfLabelUnits(num_of_nodes) -
+                  labels_.size(), 0);
+
+    SizeType values_offset = units->size();
+    units->resize(values_offset +
+                  Louds::NumOfValueUnits(values_.size(), value_bits), 0);
+    for (SizeType i = 0; i < values_.size() && value_bits != 0; ++i) {
+      SizeType pos = i * value_bits;
+      uint64_t value = static_cast<uint64_t>(values_[i]);
+      (*units)[values_offset + pos / 64] |= value << (pos % 64);
+      if (pos % 64 + value_bits > 64) {
+        (*units)[values_offset + pos / 64 + 1] |= value >> (64 - pos % 64);
+      }
+    }
+    return true;
+  }
+
+  void AppendLabel(SizeType index, UCharType label) {
+    if (index % 8 == 0) {
+      labels_.push_back(0);
+    }
+    labels_.back() |= static_cast<uint64_t>(label) << (index % 8 * 8);
+  }
+
+  static void AppendBit(std::vector<uint64_t> *bits, SizeType index,
+                        bool bit) {
+    if (index % 64 == 0) {
+      bits->push_back(0);
+    }
+    if (bit) {
+      bits->back() |= static_cast<uint64_t>(1) << (index % 64);
+    }
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_LOUDS_BUILDER_H
@@ -0,0 +1,271 @@
+#ifndef DAWGDIC_LOUDS_H
+#define DAWGDIC_LOUDS_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "base-types.h"
+#include "bit-vector.h"
+#include "file-format.h"
+
+namespace dawgdic {
+
+// Succinct trie in level-order unary degree sequence (LOUDS) form, an
+// alternative to a dictionary and its guide that takes about 1.5 bytes
+// per trie node instead of 6 bytes per unit, at the cost of slower
+// transitions. States shared in a dawg are expanded into a tree.
+//
+// Nodes are numbered in breadth-first order, with the root at 0. The tree
+// is a bit vector, in which a node with n children is written as n ones
+// and a zero, after a one and a zero for the root. The label of the
+// transition to a node, a bit for nodes at the end of a key and, for
+// those, a value of value_bits bits are kept in arrays. All of it is
+// stored in 64-bit words, so that it can be mapped from a file:
+//
+//   number of nodes, value_bits,
+//   tree, end-of-key bits (both as in BitVector),
+//   labels (8 per word), values.
+//
+// A Louds is its own guide: child() and sibling() give labels as those of
+// Guide do, so that it works with BasicCompleter and Similar.
+class Louds {
+ public:
+  typedef uint64_t UnitType;
+  typedef uint64_t IndexType;
+  typedef dawgdic::ValueType ValueType;
+  typedef Louds GuideType;
+
+  Louds()
+    : units_(NULL), size_(0), units_buf_(), tree_(), ends_(), labels_(NULL),
+      values_(NULL), value_bits_(0) {}
+
+  const UnitType *units() const {
+    return units_;
+  }
+  // Number of 64-bit words.
+  SizeType size() const {
+    return size_;
+  }
+  SizeType total_size() const {
+    return sizeof(UnitType) * size_;
+  }
+  // Number of nodes.
+  SizeType num_of_nodes() const {
+    return ends_.size();
+  }
+
+  // Root index.
+  IndexType root() const {
+    return 0;
+  }
+
+  // Checks if a given index is related to the end of a key.
+  inline bool has_value(IndexType index) const {
+    return ends_[index];
+  }
+  // Gets a value from a given index.
+  inline ValueType value(IndexType index) const {
+    if (value_bits_ == 0) {
+      return 0;
+    }
+    SizeType pos = ends_.Rank1(index) * value_bits_;
+    uint64_t value = values_[pos / 64] >> (pos % 64);
+    if (pos % 64 + value_bits_ > 64) {
+      value |= values_[pos / 64 + 1] << (64 - pos % 64);
+    }
+    return static_cast<ValueType>(
+        value & ((static_cast<uint64_t>(1) << value_bits_) - 1));
+  }
+
+  // Label of the first child of a node, or '\0'.
+  inline UCharType child(IndexType index) const {
+    SizeType pos = tree_.Select0(index) + 1;
+    return tree_[pos] ? label(pos - index - 1) : '\0';
+  }
+  // Label of the next sibling of a node, or '\0'.
+  inline UCharType sibling(IndexType index) const {
+    if (index == root() || !tree_[tree_.Select1(index) + 1]) {
+      return '\0';
+    }
+    return label(index + 1);
+  }
+
+  // Exact matching.
+  bool Contains(const CharType *key, SizeType length) const {
+    IndexType index = root();
+    if (!Follow(key, length, &index)) {
+      return false;
+    }
+    return has_value(index);
+  }
+  ValueType Find(const CharType *key, SizeType length) const {
+    IndexType index = root();
+    if (!Follow(key, length, &index)) {
+      return -1;
+    }
+    return has_value(index) ? value(index) : -1;
+  }
+
+  // Follows a transition. Children are sorted by label.
+  inline bool Follow(CharType label, IndexType *index) const {
+    UCharType uc_label = static_cast<UCharType>(label);
+    SizeType pos = tree_.Select0(*index) + 1;
+    for (IndexType child_index = pos - *index - 1; tree_[pos];
+         ++pos, ++child_index) {
+      UCharType child_label = this->label(child_index);
+      if (child_label >= uc_label) {
+        if (child_label != uc_label) {
+          return false;
+        }
+        *index = child_index;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Follows transitions.
+  bool Follow(const CharType *s, SizeType length, IndexType *index) const {
+    for (SizeType i = 0; i < length; ++i) {
+      if (!Follow(s[i], index)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Reads a given number of units.
+  bool ReadUnits(IOFunction read, void *stream, SizeType size,
+                 bool swap_byte_order = false) {
+    std::vector<UnitType> units_buf(size);
+    if (size != 0 && !read(stream, reinterpret_cast<char *>(&units_buf[0]),
+                           sizeof(UnitType) * size)) {
+      return false;
+    }
+
+    if (swap_byte_order) {
+      for (SizeType i = 0; i < size; ++i) {
+        units_buf[i] = FileFormat::SwapBytes(units_buf[i]);
+      }
+    }
+
+    return SwapUnitsBuf(&units_buf);
+  }
+
+  // Writes units.
+  bool WriteUnits(IOFunction write, void *stream) const {
+    if (size_ == 0) {
+      return true;
+    }
+    return write(stream, const_cast<UnitType *>(units_),
+                 sizeof(UnitType) * size_) != 0;
+  }
+
+  // Maps units, and returns false if they do not hold a trie.
+  bool Map(const void *address, SizeType size) {
+    Clear();
+    const UnitType *units = static_cast<const UnitType *>(address);
+    if (size < 2 || units[1] > 32) {
+      return false;
+    }
+    SizeType num_of_nodes = static_cast<SizeType>(units[0]);
+    SizeType value_bits = static_cast<SizeType>(units[1]);
+
+    SizeType pos = 2;
+    SizeType tree_size = tree_.Map(units + pos, size - pos);
+    if (tree_size == 0 || tree_.size() != num_of_nodes * 2 + 1) {
+      Clear();
+      return false;
+    }
+    pos += tree_size;
+    SizeType ends_size = ends_.Map(units + pos, size - pos);
+    if (ends_size == 0 || ends_.size() != num_of_nodes) {
+      Clear();
+      return false;
+    }
+    pos += ends_size;
+    if (pos + NumOfLabelUnits(num_of_nodes) +
+        NumOfValueUnits(ends_.num_of_ones(), value_bits) > size) {
+      Clear();
+      return false;
+    }
+
+    units_ = units;
+    size_ = size;
+    labels_ = units + pos;
+    values_ = labels_ + NumOfLabelUnits(num_of_nodes);
+    value_bits_ = value_bits;
+    return true;
+  }
+
+  // Initializes a trie.
+  void Clear() {
+    units_ = NULL;
+    size_ = 0;
+    std::vector<UnitType>(0).swap(units_buf_);
+    tree_ = BitVector();
+    ends_ = BitVector();
+    labels_ = NULL;
+    values_ = NULL;
+    value_bits_ = 0;
+  }
+
+  // Swaps tries.
+  void Swap(Louds *louds) {
+    std::swap(units_, louds->units_);
+    std::swap(size_, louds->size_);
+    units_buf_.swap(louds->units_buf_);
+    std::swap(tree_, louds->tree_);
+    std::swap(ends_, louds->ends_);
+    std::swap(labels_, louds->labels_);
+    std::swap(values_, louds->values_);
+    std::swap(value_bits_, louds->value_bits_);
+  }
+
+ public:
+  // Following member functions are called from LoudsBuilder.
+
+  // Swaps buffers for units, and returns false if they do not hold a trie.
+  bool SwapUnitsBuf(std::vector<UnitType> *units_buf) {
+    std::vector<UnitType> buf;
+    buf.swap(*units_buf);
+    if (!Map(buf.empty() ? NULL : &buf[0], buf.size())) {
+      return false;
+    }
+    units_buf_.swap(buf);
+    return true;
+  }
+
+  static SizeType NumOfLabelUnits(SizeType num_of_nodes) {
+    return (num_of_nodes + 7) / 8;
+  }
+  // Values are followed by a unit, so that reading one takes at most two
+  // loads without a bounds check.
+  static SizeType NumOfValueUnits(SizeType num_of_values,
+                                  SizeType value_bits) {
+    return (num_of_values * value_bits + 63) / 64 + 1;
+  }
+
+ private:
+  const UnitType *units_;
+  SizeType size_;
+  std::vector<UnitType> units_buf_;
+  BitVector tree_;
+  BitVector ends_;
+  const UnitType *labels_;
+  const UnitType *values_;
+  SizeType value_bits_;
+
+  // Disallows copies.
+  Louds(const Louds &);
+  Louds &operator=(const Louds &);
+
+  inline UCharType label(IndexType index) const {
+    return static_cast<UCharType>(labels_[index / 8] >> (index % 8 * 8));
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_LOUDS_H
@@ -0,0 +1,151 @@
+#ifndef DAWGDIC_PARALLEL_DAWG_BUILDER_H
+#define DAWGDIC_PARALLEL_DAWG_BUILDER_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "build-monitor.h"
+#include "dawg-builder.h"
+#include "dawg-merger.h"
+
+namespace dawgdic {
+
+// Builds a dawg from sorted keys on several threads. Keys are split into
+// shards of contiguous first-byte ranges, each shard is built into a
+// minimal dawg of its own and the shards are then merged into one minimal
+// dawg.
+class ParallelDawgBuilder {
+ public:
+  enum {
+    // Number of shards per thread, to balance uneven shards.
+    NUM_OF_SHARDS_PER_THREAD = 4,
+    // Inputs with fewer keys per thread are built sequentially.
+    MIN_NUM_OF_KEYS_PER_THREAD = 1 << 14
+  };
+
+  // Builds a dawg from keys sorted in byte order. If values is NULL, all
+  // values are 0. Returns false if a key is invalid or out of order, or if
+  // the build is cancelled through monitor.
+  static bool Build(const CharType * const *keys, const SizeType *lengths,
+                    const ValueType *values, SizeType num_of_keys,
+                    SizeType num_of_threads, Dawg *dawg,
+                    BuildMonitor *monitor = NULL) {
+    if (num_of_threads <= 1 ||
+        num_of_keys < num_of_threads * MIN_NUM_OF_KEYS_PER_THREAD) {
+      return BuildShard(keys, lengths, values, 0, num_of_keys, monitor, dawg);
+    }
+
+    std::vector<SizeType> bounds;
+    Partition(keys, lengths, num_of_keys,
+              num_of_threads * NUM_OF_SHARDS_PER_THREAD, &bounds);
+    SizeType num_of_shards = bounds.size() - 1;
+
+    std::vector<Dawg> shards(num_of_shards);
+    std::atomic<SizeType> next_shard(0);
+    std::atomic<bool> failed(false);
+
+    std::vector<std::thread> threads;
+    for (SizeType i = 0; i < num_of_threads && i < num_of_shards; ++i) {
+      threads.push_back(std::thread([&]() {
+        for (SizeType shard = next_shard++; shard < num_of_shards;
+             shard = next_shard++) {
+          if (failed) {
+            break;
+          }
+          if (!BuildShard(keys, lengths, values, bounds[shard],
+                          bounds[shard + 1], monitor, &shards[shard])) {
+            failed = true;
+          }
+        }
+      }));
+    }
+    for (SizeType i = 0; i < threads.size(); ++i) {
+      threads[i].join();
+    }
+    if (failed || (monitor != NULL && monitor->is_cancelled())) {
+      return false;
+    }
+
+    // Shards cover disjoint first bytes in ascending order, so the root
+    // of the merged dawg is the concatenation of the roots of all shards.
+    DawgMerger merger;
+    std::vector<UCharType> root_labels;
+    std::vector<BaseType> root_targets;
+    for (SizeType i = 0; i < num_of_shards; ++i) {
+      if (!merger.AddDawg(shards[i], &root_labels, &root_targets)) {
+        return false;
+      }
+      shards[i].Clear();
+    }
+
+    for (SizeType i = 1; i < root_labels.size(); ++i) {
+      if (root_labels[i - 1] >= root_labels[i]) {
+        return false;
+      }
+    }
+
+    BaseType root_state = 0;
+    if (!root_labels.empty()) {
+      root_state = merger.AddState(&root_labels[0], &root_targets[0],
+                                   root_labels.size());
+    }
+    return merger.Finish(root_state, dawg);
+  }
+
+ private:
+  // Disallows instantiation.
+  ParallelDawgBuilder();
+
+  // Builds a dawg from keys in [begin, end).
+  static bool BuildShard(const CharType * const *keys,
+                         const SizeType *lengths, const ValueType *values,
+                         SizeType begin, SizeType end, BuildMonitor *monitor,
+                         Dawg *dawg) {
+    DawgBuilder builder;
+    const SizeType interval = BuildMonitor::KEY_INTERVAL;
+    for (SizeType i = begin; i < end; ++i) {
+      if (!builder.Insert(keys[i], lengths[i],
+                          values != NULL ? values[i] : 0)) {
+        return false;
+      }
+      if (monitor != NULL && (i - begin + 1) % interval == 0) {
+        monitor->add_keys(interval);
+        if (monitor->is_cancelled()) {
+          return false;
+        }
+      }
+    }
+    if (monitor != NULL) {
+      monitor->add_keys((end - begin) % interval);
+    }
+    return builder.Finish(dawg);
+  }
+
+  // Splits keys into ranges of roughly equal size that never split a
+  // group of keys with the same first byte.
+  static void Partition(const CharType * const *keys,
+                        const SizeType *lengths, SizeType num_of_keys,
+                        SizeType num_of_shards,
+                        std::vector<SizeType> *bounds) {
+    SizeType shard_size = (num_of_keys + num_of_shards - 1) / num_of_shards;
+    bounds->push_back(0);
+    for (SizeType i = shard_size; i < num_of_keys; ) {
+      // Moves the bound to the start of the next first-byte group.
+      while (i < num_of_keys && lengths[i] > 0 && lengths[i - 1] > 0 &&
+             keys[i][0] == keys[i - 1][0]) {
+        ++i;
+      }
+      if (i >= num_of_keys) {
+        break;
+      }
+      bounds->push_back(i);
+      i += shard_size;
+    }
+    bounds->push_back(num_of_keys);
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_PARALLEL_DAWG_BUILDER_H
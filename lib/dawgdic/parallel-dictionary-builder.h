@@ -0,0 +1,327 @@
+#ifndef DAWGDIC_PARALLEL_DICTIONARY_BUILDER_H
+#define DAWGDIC_PARALLEL_DICTIONARY_BUILDER_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "dictionary-builder.h"
+
+namespace dawgdic {
+
+// Builds a dictionary from a dawg on several threads. Subtrees that share
+// no state with the rest of the dawg are left out while the other nodes are
+// placed. Then groups of such subtrees are placed into units of their own
+// concurrently and appended to the dictionary, where the parents of the
+// subtrees are given offsets to them. Dawgs whose keys share suffixes with
+// the same values (e.g. all keys of a set) have few such subtrees, and
+// are mostly built on one thread.
+template <typename Unit>
+class BasicParallelDictionaryBuilder {
+ public:
+  typedef typename Unit::IndexType IndexType;
+
+  enum {
+    // Number of groups of subtrees that a dawg is split into. It does not
+    // depend on the number of threads, so that the result does not either.
+    NUM_OF_GROUPS = 256,
+    // Groups are made at least this heavy, as the last block of each group
+    // is rarely full.
+    MIN_GROUP_WEIGHT = 1 << 14,
+    // Nodes are split only if they are heavier than this many groups, so
+    // that subtrees are large compared to the units that link them.
+    SPLIT_RATIO = 2,
+    // Dawgs with fewer units are built sequentially.
+    MIN_NUM_OF_UNITS = 1 << 16
+  };
+
+  // Builds a dictionary from a list-form dawg, and a guide if given. Units
+  // are counted in monitor, through which the build can be cancelled. Units
+  // are laid out for searches if hot_size is not 0, as in
+  // BasicDictionaryBuilder::Build().
+  static bool Build(const Dawg &dawg, SizeType num_of_threads,
+                    BasicDictionary<Unit> *dic,
+                    IndexType *num_of_unused_units = NULL,
+                    Guide *guide = NULL, BuildMonitor *monitor = NULL,
+                    SizeType hot_size = 0) {
+    if (num_of_threads <= 1 || dawg.size() < MIN_NUM_OF_UNITS) {
+      return Builder::Build(dawg, dic, num_of_unused_units, guide, monitor,
+                            hot_size);
+    }
+
+    std::vector<SizeType> weights(dawg.size(), 0);
+    std::vector<bool> is_shared(dawg.size(), false);
+    std::vector<bool> cut_nodes(dawg.size(), false);
+    SizeType max_weight = std::max(
+        Weight(dawg, &weights, &is_shared) / NUM_OF_GROUPS,
+        static_cast<SizeType>(MIN_GROUP_WEIGHT));
+    Cut(dawg, weights, is_shared, max_weight, &cut_nodes);
+    std::vector<bool>(0).swap(is_shared);
+
+    // Places all nodes but those of the subtrees.
+    Builder builder(dawg);
+    builder.has_guide_ = guide != NULL;
+    builder.monitor_ = monitor;
+    builder.hot_size_ = hot_size;
+    builder.groups_children_ = hot_size != 0;
+    builder.cut_nodes_ = &cut_nodes;
+    if (!builder.BuildDictionary()) {
+      return false;
+    }
+    std::vector<typename Builder::Cut> &cuts = builder.cuts_;
+    if (cuts.empty()) {
+      Finish(&builder.units_, &builder.guide_units_,
+             builder.num_of_unused_units_, dic, num_of_unused_units, guide);
+      return true;
+    }
+
+    // Splits subtrees into groups of about the same weight.
+    std::vector<SizeType> bounds(1, 0);
+    std::vector<SizeType> group_weights;
+    SizeType group_weight = 0;
+    for (SizeType i = 0; i < cuts.size(); ++i) {
+      group_weight += weights[dawg.child(cuts[i].dawg_index)];
+      if (group_weight >= max_weight || i + 1 == cuts.size()) {
+        bounds.push_back(i + 1);
+        group_weights.push_back(group_weight);
+        group_weight = 0;
+      }
+    }
+    SizeType num_of_groups = group_weights.size();
+
+    // Places groups of subtrees.
+    std::vector<Group> groups(num_of_groups);
+    std::atomic<SizeType> next_group(0);
+    std::atomic<bool> failed(false);
+
+    std::vector<std::thread> threads;
+    for (SizeType i = 0; i < num_of_threads && i < num_of_groups; ++i) {
+      threads.push_back(std::thread([&]() {
+        for (SizeType id = next_group++; id < num_of_groups;
+             id = next_group++) {
+          if (failed) {
+            break;
+          }
+          SizeType link_table_size = std::min(group_weights[id],
+              static_cast<SizeType>(dawg.num_of_merging_states()));
+          Builder group_builder(dawg);
+          group_builder.has_guide_ = guide != NULL;
+          group_builder.monitor_ = monitor;
+          group_builder.groups_children_ = hot_size != 0;
+          if (!group_builder.BuildSubtrees(
+              &cuts[bounds[id]], bounds[id + 1] - bounds[id],
+              link_table_size + (link_table_size >> 1) + 1)) {
+            failed = true;
+          }
+          groups[id].units.swap(group_builder.units_);
+          groups[id].guide_units.swap(group_builder.guide_units_);
+          groups[id].num_of_unused_units = group_builder.num_of_unused_units_;
+        }
+      }));
+    }
+    for (SizeType i = 0; i < threads.size(); ++i) {
+      threads[i].join();
+    }
+    if (failed) {
+      return false;
+    }
+
+    // Appends groups and links subtrees to their parents.
+    std::vector<Unit> &units = builder.units_;
+    std::vector<GuideUnit> &guide_units = builder.guide_units_;
+    IndexType unused_units = builder.num_of_unused_units_;
+    for (SizeType i = 0; i < num_of_groups; ++i) {
+      std::vector<Unit> &group_units = groups[i].units;
+      SizeType begin = Locate(units.size(), group_units.size());
+      if (begin + group_units.size() > (Unit::OFFSET_MAX << 8)) {
+        return false;
+      }
+      unused_units += static_cast<IndexType>(begin - units.size());
+      while (units.size() < begin) {
+        // Offsets in padding are unused, so that an unused unit may have
+        // the label to reach it from the start of its block.
+        units.push_back(Unit());
+        units.back().set_label(static_cast<UCharType>(units.size() - 1));
+      }
+      if (!Relocate(static_cast<IndexType>(begin), &group_units)) {
+        return false;
+      }
+      units.insert(units.end(), group_units.begin(), group_units.end());
+      std::vector<Unit>(0).swap(group_units);
+      if (guide != NULL) {
+        guide_units.resize(begin);
+        guide_units.insert(guide_units.end(), groups[i].guide_units.begin(),
+                           groups[i].guide_units.end());
+        std::vector<GuideUnit>(0).swap(groups[i].guide_units);
+      }
+      unused_units += groups[i].num_of_unused_units;
+
+      for (SizeType j = bounds[i]; j < bounds[i + 1]; ++j) {
+        IndexType parent_index = cuts[j].dic_index;
+        IndexType offset = static_cast<IndexType>(begin) + cuts[j].offset;
+        if (!units[parent_index].set_offset(parent_index ^ offset)) {
+          return false;
+        }
+        if (cuts[j].has_leaf) {
+          units[parent_index].set_has_leaf();
+        }
+      }
+    }
+
+    Finish(&units, &guide_units, unused_units, dic, num_of_unused_units,
+           guide);
+    return true;
+  }
+
+ private:
+  typedef BasicDictionaryBuilder<Unit> Builder;
+
+  // A chain of children being weighed, with the next child to weigh.
+  struct WeightedChain {
+    BaseType dawg_first_index;
+    BaseType dawg_child_index;
+    SizeType weight;
+    bool is_shared;
+  };
+
+  struct Group {
+    std::vector<Unit> units;
+    std::vector<GuideUnit> guide_units;
+    IndexType num_of_unused_units;
+  };
+
+  // Disallows instantiation.
+  BasicParallelDictionaryBuilder();
+
+  static void Finish(std::vector<Unit> *units,
+                     std::vector<GuideUnit> *guide_units,
+                     IndexType unused_units, BasicDictionary<Unit> *dic,
+                     IndexType *num_of_unused_units, Guide *guide) {
+    dic->SwapUnitsBuf(units);
+    if (guide != NULL) {
+      guide->SwapUnitsBuf(guide_units);
+    }
+    if (num_of_unused_units != NULL) {
+      *num_of_unused_units = unused_units;
+    }
+  }
+
+  // Gets the number of units that the descendants of each node would
+  // take without merging, which is the cost of placing them, and finds out
+  // if any of them is reached from another node as well. Both are kept per
+  // first child, which all transitions into a state share. Chains of
+  // children wait on a stack, so long keys do not take deep recursion.
+  static SizeType Weight(const Dawg &dawg, std::vector<SizeType> *weights,
+                         std::vector<bool> *is_shared) {
+    BaseType dawg_root_child_index = dawg.child(dawg.root());
+    WeightedChain root = { dawg_root_child_index, dawg_root_child_index,
+                           0, false };
+    std::vector<WeightedChain> stack(1, root);
+
+    while (!stack.empty()) {
+      WeightedChain &chain = stack.back();
+      BaseType dawg_child_index = chain.dawg_child_index;
+      if (dawg_child_index == 0) {
+        // Weights saturate for dawgs that merge a huge number of paths.
+        (*weights)[chain.dawg_first_index] = std::min(chain.weight,
+                                                      MaxWeight());
+        (*is_shared)[chain.dawg_first_index] =
+            chain.is_shared || dawg.is_merging(chain.dawg_first_index);
+        stack.pop_back();
+        continue;
+      }
+
+      if (!dawg.is_leaf(dawg_child_index)) {
+        BaseType dawg_grandchild_index = dawg.child(dawg_child_index);
+        if ((*weights)[dawg_grandchild_index] == 0) {
+          // Weighs the children of the child first, which invalidates
+          // chain.
+          WeightedChain child = { dawg_grandchild_index,
+                                  dawg_grandchild_index, 0, false };
+          stack.push_back(child);
+          continue;
+        }
+        chain.weight += (*weights)[dawg_grandchild_index];
+        chain.is_shared = chain.is_shared ||
+            (*is_shared)[dawg_grandchild_index];
+      }
+      ++chain.weight;
+      chain.dawg_child_index = dawg.sibling(dawg_child_index);
+    }
+    return (*weights)[dawg_root_child_index];
+  }
+
+  static SizeType MaxWeight() {
+    return static_cast<SizeType>(-1) >> 10;
+  }
+
+  // Marks nodes whose descendants are placed as separate subtrees. Nodes
+  // that are too heavy are split further, and nodes with shared
+  // descendants are left to be placed along with the root.
+  static void Cut(const Dawg &dawg, const std::vector<SizeType> &weights,
+                  const std::vector<bool> &is_shared, SizeType max_weight,
+                  std::vector<bool> *cut_nodes) {
+    std::vector<bool> is_expanded(dawg.size(), false);
+    std::vector<BaseType> stack(1, dawg.root());
+
+    while (!stack.empty()) {
+      BaseType dawg_child_index = dawg.child(stack.back());
+      stack.pop_back();
+      if (is_expanded[dawg_child_index]) {
+        continue;
+      }
+      is_expanded[dawg_child_index] = true;
+
+      for ( ; dawg_child_index != 0;
+           dawg_child_index = dawg.sibling(dawg_child_index)) {
+        if (dawg.is_leaf(dawg_child_index)) {
+          continue;
+        }
+        BaseType dawg_grandchild_index = dawg.child(dawg_child_index);
+        if (weights[dawg_grandchild_index] > max_weight * SPLIT_RATIO) {
+          stack.push_back(dawg_child_index);
+        } else if (!is_shared[dawg_grandchild_index]) {
+          (*cut_nodes)[dawg_child_index] = true;
+        }
+      }
+    }
+  }
+
+  // Finds where to append a group of a given size. Offsets inside the
+  // group can be encoded again after moving it as long as it does not
+  // cross a multiple of OFFSET_MAX, unless it starts at one.
+  static SizeType Locate(SizeType begin, SizeType size) {
+    const SizeType window = Unit::OFFSET_MAX;
+    if (size > window || begin / window != (begin + size - 1) / window) {
+      begin = (begin + window - 1) / window * window;
+    }
+    return begin;
+  }
+
+  // Moves units by a multiple of 256. Offsets are relative to the index
+  // of their unit, so they change even though the children of each unit
+  // keep their position relative to each other.
+  static bool Relocate(IndexType begin, std::vector<Unit> *units) {
+    for (IndexType index = 0; index < units->size(); ++index) {
+      Unit &unit = (*units)[index];
+      if (unit.label() & Unit::IS_LEAF_BIT) {
+        continue;
+      }
+      IndexType offset = index ^ unit.offset();
+      if (!unit.set_offset((begin + index) ^ (begin + offset))) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+typedef BasicParallelDictionaryBuilder<DictionaryUnit>
+    ParallelDictionaryBuilder;
+typedef BasicParallelDictionaryBuilder<DictionaryUnit64>
+    ParallelDictionaryBuilder64;
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_PARALLEL_DICTIONARY_BUILDER_H
@@ -0,0 +1,111 @@
+#ifndef DAWGDIC_RANK_INDEX_BUILDER_H
+#define DAWGDIC_RANK_INDEX_BUILDER_H
+
+#include <limits>
+#include <vector>
+
+#include "dictionary.h"
+#include "louds.h"
+#include "rank-index.h"
+
+namespace dawgdic {
+
+// Builds a rank index from a dictionary and its guide.
+class RankIndexBuilder {
+ public:
+  // Counts the keys below each index in depth-first order. Returns false
+  // if a count does not fit into a unit.
+  template <typename Dic, typename T>
+  static bool Build(const Dic &dic, const typename Dic::GuideType &guide,
+                    BasicRankIndex<T> *rank_index) {
+    typedef typename Dic::IndexType IndexType;
+
+    // The guide of a dictionary without keys is empty, and so is the
+    // index.
+    std::vector<T> units;
+    if (guide.size() == 0) {
+      rank_index->SwapUnitsBuf(&units);
+      return true;
+    }
+    units.resize(NumOfIndices(dic), 0);
+
+    // Number of keys below each index that has been visited.
+    std::vector<uint64_t> counts(units.size(), 0);
+    std::vector<bool> is_counted(units.size(), false);
+    std::vector<Node<IndexType> > stack;
+    Enter(dic, guide, dic.root(), &stack);
+
+    while (!stack.empty()) {
+      Node<IndexType> &node = stack.back();
+      if (node.label == '\0') {
+        IndexType index = node.index;
+        uint64_t count = node.count;
+        counts[index] = count;
+        is_counted[index] = true;
+        stack.pop_back();
+        if (!stack.empty()) {
+          stack.back().count += count;
+          stack.back().label = guide.sibling(index);
+        }
+        continue;
+      }
+
+      IndexType child_index = node.index;
+      if (!dic.Follow(static_cast<CharType>(node.label), &child_index)) {
+        return false;
+      }
+      if (node.count > std::numeric_limits<T>::max()) {
+        return false;
+      }
+      units[child_index] = static_cast<T>(node.count);
+
+      if (is_counted[child_index]) {
+        node.count += counts[child_index];
+        node.label = guide.sibling(child_index);
+      } else {
+        // Descends into the child, which invalidates node.
+        Enter(dic, guide, child_index, &stack);
+      }
+    }
+
+    rank_index->SwapUnitsBuf(&units);
+    return true;
+  }
+
+ private:
+  // A node whose children are being counted.
+  template <typename IndexType>
+  struct Node {
+    IndexType index;
+    // Label of the next child to visit, or '\0'.
+    UCharType label;
+    // Keys before that child.
+    uint64_t count;
+  };
+
+  // Disallows copies.
+  RankIndexBuilder(const RankIndexBuilder &);
+  RankIndexBuilder &operator=(const RankIndexBuilder &);
+
+  template <typename Dic>
+  static void Enter(const Dic &dic, const typename Dic::GuideType &guide,
+                    typename Dic::IndexType index,
+                    std::vector<Node<typename Dic::IndexType> > *stack) {
+    Node<typename Dic::IndexType> node = {
+      index, guide.child(index), dic.has_value(index) ? 1U : 0U
+    };
+    stack->push_back(node);
+  }
+
+  template <typename Unit>
+  static SizeType NumOfIndices(const BasicDictionary<Unit> &dic) {
+    return dic.size();
+  }
+  static SizeType NumOfIndices(const Louds &louds) {
+    return louds.num_of_nodes();
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_RANK_INDEX_BUILDER_H
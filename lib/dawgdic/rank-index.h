@@ -0,0 +1,214 @@
+#ifndef DAWGDIC_RANK_INDEX_H
+#define DAWGDIC_RANK_INDEX_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "base-types.h"
+#include "file-format.h"
+
+namespace dawgdic {
+
+// Maps the keys of a dictionary to their positions in sorted order (their
+// ranks) and back. For each index of the dictionary, it keeps the number
+// of keys that sort before those of its subtree among the keys of its
+// parent's subtree: the key that ends at the parent, if any, and the
+// keys below its siblings with smaller labels. The rank of a key is the
+// sum of these numbers along its path.
+//
+// Units of type T are indexed like the dictionary (for a LOUDS trie, by
+// node), so states that a dawg shares keep sharing their units.
+template <typename T>
+class BasicRankIndex {
+ public:
+  typedef T UnitType;
+
+  BasicRankIndex() : units_(NULL), size_(0), units_buf_() {}
+
+  const UnitType *units() const {
+    return units_;
+  }
+  SizeType size() const {
+    return size_;
+  }
+  SizeType total_size() const {
+    return sizeof(UnitType) * size_;
+  }
+
+  // Number of keys before the subtree of an index within its parent's.
+  UnitType before(SizeType index) const {
+    return units_[index];
+  }
+
+  // Finds the rank of a key, and returns false if dic does not contain it.
+  template <typename Dic>
+  bool Rank(const Dic &dic, const CharType *key, SizeType length,
+            SizeType *rank) const {
+    if (size_ == 0) {
+      return false;
+    }
+    typename Dic::IndexType index = dic.root();
+    SizeType sum = 0;
+    for (SizeType i = 0; i < length; ++i) {
+      if (!dic.Follow(key[i], &index)) {
+        return false;
+      }
+      sum += units_[index];
+    }
+    if (!dic.has_value(index)) {
+      return false;
+    }
+    *rank = sum;
+    return true;
+  }
+
+  // Finds the ranks of the keys that start with a prefix, from *begin up
+  // to *end, and returns false if there are none. The keys below a child
+  // end where those of its next sibling begin or, for the last child,
+  // where those of its parent end.
+  template <typename Dic, typename Guide>
+  bool Range(const Dic &dic, const Guide &guide, SizeType num_of_keys,
+             const CharType *prefix, SizeType length, SizeType *begin,
+             SizeType *end) const {
+    if (size_ == 0) {
+      return false;
+    }
+    typename Dic::IndexType index = dic.root();
+    SizeType first = 0;
+    SizeType last = num_of_keys;
+    for (SizeType i = 0; i < length; ++i) {
+      typename Dic::IndexType parent_index = index;
+      if (!dic.Follow(prefix[i], &index)) {
+        return false;
+      }
+      UCharType sibling_label = guide.sibling(index);
+      if (sibling_label != '\0') {
+        typename Dic::IndexType sibling_index = parent_index;
+        if (!dic.Follow(static_cast<CharType>(sibling_label),
+                        &sibling_index)) {
+          return false;
+        }
+        last = first + units_[sibling_index];
+      }
+      first += units_[index];
+    }
+    *begin = first;
+    *end = last;
+    return first < last;
+  }
+
+  // Finds the key of a rank, and returns false if the rank is not less
+  // than the number of keys. Walks down from the root and goes, at each
+  // node, to the last child whose keys do not start after the rank.
+  template <typename Dic, typename Guide>
+  bool Select(const Dic &dic, const Guide &guide, SizeType rank,
+              std::vector<CharType> *key) const {
+    key->clear();
+    if (size_ == 0) {
+      return false;
+    }
+    typename Dic::IndexType index = dic.root();
+    for ( ; ; ) {
+      if (rank == 0 && dic.has_value(index)) {
+        return true;
+      }
+
+      UCharType label = guide.child(index);
+      UCharType next_label = '\0';
+      typename Dic::IndexType next_index = index;
+      while (label != '\0') {
+        typename Dic::IndexType child_index = index;
+        if (!dic.Follow(static_cast<CharType>(label), &child_index) ||
+            units_[child_index] > rank) {
+          break;
+        }
+        next_label = label;
+        next_index = child_index;
+        label = guide.sibling(child_index);
+      }
+      if (next_label == '\0') {
+        return false;
+      }
+
+      rank -= units_[next_index];
+      key->push_back(static_cast<CharType>(next_label));
+      index = next_index;
+    }
+  }
+
+  // Reads a given number of units.
+  bool ReadUnits(IOFunction read, void *stream, SizeType size,
+                 bool swap_byte_order = false) {
+    std::vector<UnitType> units_buf(size);
+    if (size != 0 && !read(stream, reinterpret_cast<char *>(&units_buf[0]),
+                           sizeof(UnitType) * size)) {
+      return false;
+    }
+
+    if (swap_byte_order) {
+      for (SizeType i = 0; i < size; ++i) {
+        units_buf[i] = FileFormat::SwapBytes(units_buf[i]);
+      }
+    }
+
+    SwapUnitsBuf(&units_buf);
+    return true;
+  }
+
+  // Writes units.
+  bool WriteUnits(IOFunction write, void *stream) const {
+    if (size_ == 0) {
+      return true;
+    }
+    return write(stream, const_cast<UnitType *>(units_),
+                 sizeof(UnitType) * size_) != 0;
+  }
+
+  // Maps memory with its size.
+  void Map(const void *address, SizeType size) {
+    Clear();
+    units_ = static_cast<const UnitType *>(address);
+    size_ = size;
+  }
+
+  // Initializes an index.
+  void Clear() {
+    units_ = NULL;
+    size_ = 0;
+    std::vector<UnitType>(0).swap(units_buf_);
+  }
+
+  // Swaps indices.
+  void Swap(BasicRankIndex *index) {
+    std::swap(units_, index->units_);
+    std::swap(size_, index->size_);
+    units_buf_.swap(index->units_buf_);
+  }
+
+ public:
+  // Following member function is called from RankIndexBuilder.
+
+  // Swaps buffers for units.
+  void SwapUnitsBuf(std::vector<UnitType> *units_buf) {
+    units_ = units_buf->empty() ? NULL : &(*units_buf)[0];
+    size_ = units_buf->size();
+    units_buf_.swap(*units_buf);
+  }
+
+ private:
+  const UnitType *units_;
+  SizeType size_;
+  std::vector<UnitType> units_buf_;
+
+  // Disallows copies.
+  BasicRankIndex(const BasicRankIndex &);
+  BasicRankIndex &operator=(const BasicRankIndex &);
+};
+
+typedef BasicRankIndex<uint32_t> RankIndex;
+typedef BasicRankIndex<uint64_t> RankIndex64;
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_RANK_INDEX_H
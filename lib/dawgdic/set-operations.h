@@ -0,0 +1,207 @@
+#ifndef DAWGDIC_SET_OPERATIONS_H
+#define DAWGDIC_SET_OPERATIONS_H
+
+#include <vector>
+
+#include "dawg-builder.h"
+#include "dictionary.h"
+#include "guide.h"
+
+namespace dawgdic {
+
+// Combines the keys of two dictionaries. Both are walked in lockstep, so
+// keys come out sorted and go straight into a DawgBuilder, and subtrees
+// that cannot contribute to the result (e.g. those of only one side in an
+// intersection) are skipped without being visited. Keys of the result are
+// still inserted one by one, so a union takes time in the number of keys
+// of both sides, even where their subtrees are equal.
+class SetOperations {
+ public:
+  enum Operation {
+    UNION,
+    INTERSECTION,
+    DIFFERENCE,
+    SYMMETRIC_DIFFERENCE
+  };
+
+  // Builds a dawg from the keys of lhs and rhs selected by an operation.
+  // Guides are optional, but without a guide, children are found by
+  // trying all labels. If lhs_values and rhs_values are given, the values
+  // in the dawg number the keys in order and the values of each key in
+  // lhs and rhs (or -1) are appended to them. Otherwise a key keeps its
+  // value from lhs, or from rhs if lhs does not contain it. Dictionaries
+  // may have units of different types, but their values must fit into
+  // ValueType, as those of any dictionary built from a dawg do.
+  template <typename LhsDictionary, typename RhsDictionary>
+  static bool Apply(Operation operation, const LhsDictionary &lhs_dic,
+                    const typename LhsDictionary::GuideType *lhs_guide,
+                    const RhsDictionary &rhs_dic,
+                    const typename RhsDictionary::GuideType *rhs_guide,
+                    Dawg *dawg, SizeType *num_of_keys,
+                    std::vector<ValueType> *lhs_values = NULL,
+                    std::vector<ValueType> *rhs_values = NULL) {
+    typedef Frame<LhsDictionary, RhsDictionary> FrameType;
+
+    Side<LhsDictionary> lhs = { &lhs_dic,
+                                IsEmpty(lhs_guide) ? NULL : lhs_guide };
+    Side<RhsDictionary> rhs = { &rhs_dic,
+                                IsEmpty(rhs_guide) ? NULL : rhs_guide };
+
+    DawgBuilder builder;
+    std::vector<CharType> key;
+    std::vector<FrameType> stack;
+    SizeType count = 0;
+
+    FrameType root = { lhs_dic.root(), rhs_dic.root(),
+                       lhs_dic.size() != 0, rhs_dic.size() != 0, 0, 0 };
+    Enter(lhs, rhs, &root);
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+      FrameType &frame = stack.back();
+      if (frame.lhs_label == '\0' && frame.rhs_label == '\0') {
+        stack.pop_back();
+        if (!key.empty()) {
+          key.pop_back();
+        }
+        continue;
+      }
+
+      UCharType label = frame.lhs_label;
+      if (label == '\0' ||
+          (frame.rhs_label != '\0' && frame.rhs_label < label)) {
+        label = frame.rhs_label;
+      }
+
+      FrameType child = { frame.lhs, frame.rhs, false, false, 0, 0 };
+      if (frame.lhs_label == label) {
+        child.has_lhs = lhs.dic->Follow(label, &child.lhs);
+        frame.lhs_label = NextLabel(lhs, frame.lhs, label, child.lhs);
+      }
+      if (frame.rhs_label == label) {
+        child.has_rhs = rhs.dic->Follow(label, &child.rhs);
+        frame.rhs_label = NextLabel(rhs, frame.rhs, label, child.rhs);
+      }
+      if (!Accepts(operation, child.has_lhs, child.has_rhs, true)) {
+        continue;
+      }
+
+      key.push_back(static_cast<CharType>(label));
+      bool lhs_has_value = child.has_lhs && lhs.dic->has_value(child.lhs);
+      bool rhs_has_value = child.has_rhs && rhs.dic->has_value(child.rhs);
+      if (Accepts(operation, lhs_has_value, rhs_has_value, false)) {
+        ValueType value;
+        if (lhs_values != NULL) {
+          lhs_values->push_back(lhs_has_value ?
+              static_cast<ValueType>(lhs.dic->value(child.lhs)) : -1);
+          rhs_values->push_back(rhs_has_value ?
+              static_cast<ValueType>(rhs.dic->value(child.rhs)) : -1);
+          value = static_cast<ValueType>(count);
+        } else {
+          value = lhs_has_value ?
+              static_cast<ValueType>(lhs.dic->value(child.lhs)) :
+              static_cast<ValueType>(rhs.dic->value(child.rhs));
+        }
+        if (!builder.Insert(&key[0], key.size(), value)) {
+          return false;
+        }
+        ++count;
+      }
+
+      // Descends into the child, which invalidates frame.
+      Enter(lhs, rhs, &child);
+      stack.push_back(child);
+    }
+
+    *num_of_keys = count;
+    return builder.Finish(dawg);
+  }
+
+ private:
+  template <typename Dic>
+  struct Side {
+    const Dic *dic;
+    const typename Dic::GuideType *guide;
+  };
+
+  // A node of lhs and one of rhs that are reached by the same prefix,
+  // with the next labels to visit (or '\0').
+  template <typename LhsDictionary, typename RhsDictionary>
+  struct Frame {
+    typename LhsDictionary::IndexType lhs;
+    typename RhsDictionary::IndexType rhs;
+    bool has_lhs;
+    bool has_rhs;
+    UCharType lhs_label;
+    UCharType rhs_label;
+  };
+
+  // Disallows instantiation.
+  SetOperations();
+
+  template <typename GuideType>
+  static bool IsEmpty(const GuideType *guide) {
+    return guide == NULL || guide->size() == 0;
+  }
+
+  // Checks if a key (or, for subtrees, any key below a node) that is in
+  // lhs and/or rhs can be part of the result.
+  static bool Accepts(Operation operation, bool in_lhs, bool in_rhs,
+                      bool is_subtree) {
+    switch (operation) {
+      case UNION:
+        return in_lhs || in_rhs;
+      case INTERSECTION:
+        return in_lhs && in_rhs;
+      case DIFFERENCE:
+        return in_lhs && (is_subtree || !in_rhs);
+      case SYMMETRIC_DIFFERENCE:
+        return is_subtree ? (in_lhs || in_rhs) : (in_lhs != in_rhs);
+    }
+    return false;
+  }
+
+  template <typename LhsDictionary, typename RhsDictionary>
+  static void Enter(const Side<LhsDictionary> &lhs,
+                    const Side<RhsDictionary> &rhs,
+                    Frame<LhsDictionary, RhsDictionary> *frame) {
+    frame->lhs_label = frame->has_lhs ? FirstLabel(lhs, frame->lhs) : 0;
+    frame->rhs_label = frame->has_rhs ? FirstLabel(rhs, frame->rhs) : 0;
+  }
+
+  template <typename Dic>
+  static UCharType FirstLabel(const Side<Dic> &side,
+                              typename Dic::IndexType index) {
+    if (side.guide != NULL) {
+      return side.guide->child(index);
+    }
+    return ScanLabels(side, index, 1);
+  }
+
+  template <typename Dic>
+  static UCharType NextLabel(const Side<Dic> &side,
+                             typename Dic::IndexType index, UCharType label,
+                             typename Dic::IndexType child_index) {
+    if (side.guide != NULL) {
+      return side.guide->sibling(child_index);
+    }
+    return (label == 0xFF) ? 0 : ScanLabels(side, index, label + 1);
+  }
+
+  // Finds the first label from a given one that has a transition.
+  template <typename Dic>
+  static UCharType ScanLabels(const Side<Dic> &side,
+                              typename Dic::IndexType index, BaseType label) {
+    for ( ; label <= 0xFF; ++label) {
+      typename Dic::IndexType child_index = index;
+      if (side.dic->Follow(static_cast<UCharType>(label), &child_index)) {
+        return static_cast<UCharType>(label);
+      }
+    }
+    return 0;
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_SET_OPERATIONS_H
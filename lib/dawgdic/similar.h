@@ -184,14 +184,16 @@ public:
 	}
 };
 
-template<typename Delegate>
+template<typename Delegate, typename Dic>
 class DFS {
+	typedef typename Dic::IndexType IndexType;
+
 	Delegate &delegate;
 
-	const Dictionary *dic_;
-	const Guide *guide_;
+	const Dic *dic_;
+	const typename Dic::GuideType *guide_;
 
-	std::stack<BaseType> stack_;
+	std::stack<IndexType> stack_;
 	std::vector<UCharType> key_;
 
 	enum {
@@ -207,7 +209,7 @@ class DFS {
 	}
 
 	inline bool follow(UCharType label) {
-		BaseType index = stack_.top();
+		IndexType index = stack_.top();
 
 		if (!dic_->Follow(label, &index)) {
 			return false;
@@ -222,17 +224,17 @@ public:
 	inline DFS(Delegate *delegate) : delegate(*delegate) {
 	}
 
-	void set_dic(const Dictionary &dic) {
+	void set_dic(const Dic &dic) {
 		dic_ = &dic;
 	}
-	void set_guide(const Guide &guide) {
+	void set_guide(const typename Dic::GuideType &guide) {
 		guide_ = &guide;
 	}
 
 	inline const std::vector<UCharType> &key() const {
 		return key_;
 	}
-	inline ValueType value() const {
+	inline typename Dic::ValueType value() const {
 		return dic_->value(stack_.top());
 	}
 
@@ -241,7 +243,7 @@ public:
 		assert(guide_);
 
 		state_ = NEXT_CHILD;
-		std::stack<BaseType>().swap(stack_);
+		std::stack<IndexType>().swap(stack_);
 		stack_.push(dic_->root());
 
 		key_.clear();
@@ -330,17 +332,18 @@ public:
 	}
 };
 
-class LCS {
+template<typename Dic = Dictionary>
+class BasicLCS {
 	typedef int16_t IndexType;
 
-	DFS<LCS> dfs_;
+	DFS<BasicLCS, Dic> dfs_;
 	std::vector<UCharType> word_;
 	Matrix<IndexType> C_;
 	IndexType min_length_;
 	std::vector<UCharType> result_;
 
 protected:
-	friend class DFS<LCS>;
+	friend class DFS<BasicLCS, Dic>;
 
 	void backtrack(const UCharType * const a, const UCharType * const b, SizeType i, SizeType j) {
 		result_.clear();
@@ -400,14 +403,14 @@ protected:
 	}
 
 public:
-	LCS() : dfs_(this) {
+	BasicLCS() : dfs_(this) {
 	}
 
-	void set_dic(const Dictionary &dic) {
+	void set_dic(const Dic &dic) {
 		dfs_.set_dic(dic);
 	}
 
-	void set_guide(const Guide &guide) {
+	void set_guide(const typename Dic::GuideType &guide) {
 		dfs_.set_guide(guide);
 	}
 
@@ -438,7 +441,7 @@ public:
 	inline SizeType key_length() const {
 		return dfs_.key().size();
 	}
-	inline ValueType value() const {
+	inline typename Dic::ValueType value() const {
 		return dfs_.value();
 	}
 	inline const char *lcs() const {
@@ -449,9 +452,14 @@ public:
 	}
 };
 
-template<typename CostType>
+typedef BasicLCS<Dictionary> LCS;
+typedef BasicLCS<Dictionary64> LCS64;
+typedef BasicLCS<Louds> LoudsLCS;
+typedef BasicLCS<InterleavedDictionary> InterleavedLCS;
+
+template<typename CostType, typename Dic = Dictionary>
 class Similar {
-	DFS<Similar> dfs_;
+	DFS<Similar, Dic> dfs_;
 
 	const Costs<CostType> *costs_;
 	std::vector<CostType> cached_insert_cost_;
@@ -587,7 +595,7 @@ class Similar {
 	}
 
 protected:
-	friend class DFS<Similar>;
+	friend class DFS<Similar, Dic>;
 
 	inline std::tuple<bool, bool> on_step() {
 		 if (allow_.split || allow_.merge) {
@@ -621,11 +629,11 @@ public:
 		allow_.merge = 0;
 	}
 
-	void set_dic(const Dictionary &dic) {
+	void set_dic(const Dic &dic) {
 		dfs_.set_dic(dic);
 	}
 
-	void set_guide(const Guide &guide) {
+	void set_guide(const typename Dic::GuideType &guide) {
 		dfs_.set_guide(guide);
 	}
 
@@ -640,7 +648,7 @@ public:
 	inline SizeType key_length() const {
 		return dfs_.key().size();
 	}
-	inline ValueType value() const {
+	inline typename Dic::ValueType value() const {
 		return dfs_.value();
 	}
 	inline CostType cost() const {
@@ -704,4 +712,13 @@ public:
 	}
 };
 
+template<typename CostType>
+using Similar64 = Similar<CostType, Dictionary64>;
+
+template<typename CostType>
+using LoudsSimilar = Similar<CostType, Louds>;
+
+template<typename CostType>
+using InterleavedSimilar = Similar<CostType, InterleavedDictionary>;
+
 }
@@ -0,0 +1,395 @@
+#ifndef DAWGDIC_UNSORTED_DAWG_BUILDER_H
+#define DAWGDIC_UNSORTED_DAWG_BUILDER_H
+
+#include <algorithm>
+#include <vector>
+
+#include "dawg-merger.h"
+
+namespace dawgdic {
+
+// Builds a dawg from keys in any order. The automaton is kept minimal
+// after each key: states on the path of a new key are removed from the
+// register (or cloned if other keys share them), and are then registered
+// again bottom-up, replacing equivalent states (Daciuk et al., 2000).
+class UnsortedDawgBuilder {
+ public:
+  explicit UnsortedDawgBuilder(SizeType initial_hash_table_size =
+                               DEFAULT_INITIAL_HASH_TABLE_SIZE)
+    : initial_hash_table_size_(initial_hash_table_size), states_(),
+      unused_states_(), hash_table_(), path_(), num_of_keys_(0),
+      num_of_registered_states_(0) {}
+
+  // Number of distinct keys.
+  SizeType num_of_keys() const {
+    return num_of_keys_;
+  }
+  // Number of states, including the root.
+  SizeType num_of_states() const {
+    return states_.size() - unused_states_.size();
+  }
+
+  // Initializes a builder.
+  void Clear() {
+    std::vector<State>(0).swap(states_);
+    std::vector<BaseType>(0).swap(unused_states_);
+    std::vector<BaseType>(0).swap(hash_table_);
+    std::vector<BaseType>(0).swap(path_);
+    num_of_keys_ = 0;
+    num_of_registered_states_ = 0;
+  }
+
+  // Inserts a key. The value of a key that was inserted before is
+  // replaced.
+  bool Insert(const CharType *key, SizeType length, ValueType value) {
+    if (key == NULL || length <= 0 || value < 0) {
+      return false;
+    }
+    for (SizeType i = 0; i < length; ++i) {
+      if (key[i] == '\0') {
+        return false;
+      }
+    }
+    return InsertKey(reinterpret_cast<const UCharType *>(key),
+                     length, value);
+  }
+
+  // Finishes building a dawg.
+  bool Finish(Dawg *dawg) {
+    if (states_.empty()) {
+      Init();
+    }
+
+    DawgMerger merger;
+    std::vector<BaseType> state_map(states_.size(), 0);
+    std::vector<UCharType> labels;
+    std::vector<BaseType> targets;
+    BaseType root_state = 0;
+
+    // Adds states in post-order without recursion.
+    std::vector<BaseType> stack;
+    stack.push_back(0);
+    while (!stack.empty()) {
+      BaseType id = stack.back();
+      const State &state = states_[id];
+      bool is_ready = true;
+      for (SizeType i = 0; i < state.transitions.size(); ++i) {
+        if (state_map[state.transitions[i].target] == 0) {
+          stack.push_back(state.transitions[i].target);
+          is_ready = false;
+        }
+      }
+      if (!is_ready) {
+        continue;
+      }
+      stack.pop_back();
+      if (state_map[id] != 0) {
+        continue;
+      }
+
+      labels.clear();
+      targets.clear();
+      if (state.is_final) {
+        labels.push_back('\0');
+        targets.push_back(static_cast<BaseType>(state.value));
+      }
+      for (SizeType i = 0; i < state.transitions.size(); ++i) {
+        labels.push_back(state.transitions[i].label);
+        targets.push_back(state_map[state.transitions[i].target]);
+      }
+
+      if (labels.empty()) {
+        // Only the root of an empty dawg has no transitions.
+        state_map[id] = 1;
+      } else {
+        state_map[id] = merger.AddState(&labels[0], &targets[0],
+                                        labels.size());
+      }
+      if (id == 0) {
+        root_state = labels.empty() ? 0 : state_map[id];
+      }
+    }
+
+    Clear();
+    return merger.Finish(root_state, dawg);
+  }
+
+ private:
+  enum {
+    DEFAULT_INITIAL_HASH_TABLE_SIZE = 1 << 8
+  };
+
+  struct Transition {
+    UCharType label;
+    BaseType target;
+  };
+
+  struct State {
+    std::vector<Transition> transitions;
+    BaseType num_of_references;
+    ValueType value;
+    bool is_final;
+    bool is_registered;
+  };
+
+  const SizeType initial_hash_table_size_;
+  std::vector<State> states_;
+  std::vector<BaseType> unused_states_;
+  std::vector<BaseType> hash_table_;
+  std::vector<BaseType> path_;
+  SizeType num_of_keys_;
+  SizeType num_of_registered_states_;
+
+  // Disallows copies.
+  UnsortedDawgBuilder(const UnsortedDawgBuilder &);
+  UnsortedDawgBuilder &operator=(const UnsortedDawgBuilder &);
+
+  // Initializes an object. State 0 is the root, which is never
+  // registered, so 0 also marks empty slots of the hash table.
+  void Init() {
+    hash_table_.resize(initial_hash_table_size_, 0);
+    AllocateState();
+  }
+
+  bool InsertKey(const UCharType *key, SizeType length, ValueType value) {
+    if (states_.empty()) {
+      Init();
+    }
+
+    BaseType id = 0;
+    SizeType key_pos = 0;
+    path_.clear();
+    path_.push_back(id);
+
+    // Follows the common prefix. States on it are about to change, so
+    // they leave the register, and states shared with other keys are
+    // cloned first.
+    for ( ; key_pos < length; ++key_pos) {
+      Transition *transition = FindTransition(id, key[key_pos]);
+      if (transition == NULL) {
+        break;
+      }
+      BaseType child_id = transition->target;
+      if (states_[child_id].num_of_references > 1) {
+        BaseType clone_id = CloneState(child_id);
+        --states_[child_id].num_of_references;
+        ++states_[clone_id].num_of_references;
+        FindTransition(id, key[key_pos])->target = clone_id;
+        child_id = clone_id;
+      } else {
+        Unregister(child_id);
+      }
+      id = child_id;
+      path_.push_back(id);
+    }
+
+    // Adds new states for the rest of the key.
+    for ( ; key_pos < length; ++key_pos) {
+      BaseType child_id = AllocateState();
+      AddTransition(id, key[key_pos], child_id);
+      ++states_[child_id].num_of_references;
+      id = child_id;
+      path_.push_back(id);
+    }
+
+    if (!states_[id].is_final) {
+      states_[id].is_final = true;
+      ++num_of_keys_;
+    }
+    states_[id].value = value;
+
+    // Registers states bottom-up, replacing ones that have an equivalent.
+    for (SizeType i = path_.size() - 1; i > 0; --i) {
+      BaseType child_id = path_[i];
+      BaseType equivalent_id = FindEquivalent(child_id);
+      if (equivalent_id != 0) {
+        FindTransition(path_[i - 1], key[i - 1])->target = equivalent_id;
+        ++states_[equivalent_id].num_of_references;
+        FreeState(child_id);
+      } else {
+        Register(child_id);
+      }
+    }
+    return true;
+  }
+
+  Transition *FindTransition(BaseType id, UCharType label) {
+    std::vector<Transition> &transitions = states_[id].transitions;
+    for (SizeType i = 0; i < transitions.size(); ++i) {
+      if (transitions[i].label == label) {
+        return &transitions[i];
+      } else if (transitions[i].label > label) {
+        break;
+      }
+    }
+    return NULL;
+  }
+
+  // Adds a transition, keeping transitions sorted by label.
+  void AddTransition(BaseType id, UCharType label, BaseType target) {
+    std::vector<Transition> &transitions = states_[id].transitions;
+    SizeType i = 0;
+    while (i < transitions.size() && transitions[i].label < label) {
+      ++i;
+    }
+    Transition transition = { label, target };
+    transitions.insert(transitions.begin() + i, transition);
+  }
+
+  BaseType CloneState(BaseType id) {
+    BaseType clone_id = AllocateState();
+    State &clone = states_[clone_id];
+    const State &state = states_[id];
+    clone.transitions = state.transitions;
+    clone.value = state.value;
+    clone.is_final = state.is_final;
+    for (SizeType i = 0; i < clone.transitions.size(); ++i) {
+      ++states_[clone.transitions[i].target].num_of_references;
+    }
+    return clone_id;
+  }
+
+  BaseType AllocateState() {
+    BaseType id;
+    if (!unused_states_.empty()) {
+      id = unused_states_.back();
+      unused_states_.pop_back();
+    } else {
+      id = static_cast<BaseType>(states_.size());
+      states_.resize(states_.size() + 1);
+    }
+    State &state = states_[id];
+    state.transitions.clear();
+    state.num_of_references = 0;
+    state.value = 0;
+    state.is_final = false;
+    state.is_registered = false;
+    return id;
+  }
+
+  void FreeState(BaseType id) {
+    State &state = states_[id];
+    for (SizeType i = 0; i < state.transitions.size(); ++i) {
+      --states_[state.transitions[i].target].num_of_references;
+    }
+    std::vector<Transition>(0).swap(state.transitions);
+    unused_states_.push_back(id);
+  }
+
+  bool AreEqual(BaseType lhs_id, BaseType rhs_id) const {
+    const State &lhs = states_[lhs_id];
+    const State &rhs = states_[rhs_id];
+    if (lhs.is_final != rhs.is_final ||
+        (lhs.is_final && lhs.value != rhs.value) ||
+        lhs.transitions.size() != rhs.transitions.size()) {
+      return false;
+    }
+    for (SizeType i = 0; i < lhs.transitions.size(); ++i) {
+      if (lhs.transitions[i].label != rhs.transitions[i].label ||
+          lhs.transitions[i].target != rhs.transitions[i].target) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Finds a registered state that is equivalent to a given state.
+  BaseType FindEquivalent(BaseType id) const {
+    SizeType hash_id = HashState(id) % hash_table_.size();
+    for ( ; ; hash_id = (hash_id + 1) % hash_table_.size()) {
+      BaseType registered_id = hash_table_[hash_id];
+      if (registered_id == 0) {
+        return 0;
+      }
+      if (AreEqual(id, registered_id)) {
+        return registered_id;
+      }
+    }
+  }
+
+  void Register(BaseType id) {
+    if (num_of_registered_states_ + 1 >=
+        hash_table_.size() - (hash_table_.size() >> 2)) {
+      ExpandHashTable();
+    }
+    SizeType hash_id = HashState(id) % hash_table_.size();
+    while (hash_table_[hash_id] != 0) {
+      hash_id = (hash_id + 1) % hash_table_.size();
+    }
+    hash_table_[hash_id] = id;
+    states_[id].is_registered = true;
+    ++num_of_registered_states_;
+  }
+
+  // Removes a state from the hash table, moving back states of the same
+  // probe sequence so that lookups need no tombstones.
+  void Unregister(BaseType id) {
+    if (!states_[id].is_registered) {
+      return;
+    }
+    SizeType size = hash_table_.size();
+    SizeType hash_id = HashState(id) % size;
+    while (hash_table_[hash_id] != id) {
+      hash_id = (hash_id + 1) % size;
+    }
+    for (SizeType next_id = (hash_id + 1) % size; hash_table_[next_id] != 0;
+         next_id = (next_id + 1) % size) {
+      SizeType home_id = HashState(hash_table_[next_id]) % size;
+      // Moves the state back unless its home lies in (hash_id, next_id].
+      bool is_movable = (hash_id <= next_id) ?
+          (home_id <= hash_id || home_id > next_id) :
+          (home_id <= hash_id && home_id > next_id);
+      if (is_movable) {
+        hash_table_[hash_id] = hash_table_[next_id];
+        hash_id = next_id;
+      }
+    }
+    hash_table_[hash_id] = 0;
+    states_[id].is_registered = false;
+    --num_of_registered_states_;
+  }
+
+  void ExpandHashTable() {
+    SizeType hash_table_size = hash_table_.size() << 1;
+    std::vector<BaseType> hash_table(hash_table_size, 0);
+    for (SizeType i = 0; i < hash_table_.size(); ++i) {
+      BaseType id = hash_table_[i];
+      if (id != 0) {
+        SizeType hash_id = HashState(id) % hash_table_size;
+        while (hash_table[hash_id] != 0) {
+          hash_id = (hash_id + 1) % hash_table_size;
+        }
+        hash_table[hash_id] = id;
+      }
+    }
+    hash_table_.swap(hash_table);
+  }
+
+  // Calculates a hash value from a state.
+  BaseType HashState(BaseType id) const {
+    const State &state = states_[id];
+    BaseType hash_value = state.is_final ?
+        Hash(static_cast<BaseType>(state.value)) : 0;
+    for (SizeType i = 0; i < state.transitions.size(); ++i) {
+      hash_value = Hash(hash_value ^ (state.transitions[i].label << 24)
+                        ^ state.transitions[i].target);
+    }
+    return hash_value;
+  }
+
+  // 32-bit mix function.
+  // http://www.concentric.net/~Ttwang/tech/inthash.htm
+  static BaseType Hash(BaseType key) {
+    key = ~key + (key << 15);  // key = (key << 15) - key - 1;
+    key = key ^ (key >> 12);
+    key = key + (key << 2);
+    key = key ^ (key >> 4);
+    key = key * 2057;  // key = (key + (key << 3)) + (key << 11);
+    key = key ^ (key >> 16);
+    return key;
+  }
+};
+
+}  // namespace dawgdic
+
+#endif  // DAWGDIC_UNSORTED_DAWG_BUILDER_H
@@ -19,7 +19,8 @@ setup(
         Extension(
             name="simtrie",
             sources=['simtrie/simtrie.pyx'],
-            extra_compile_args=["-O3", "-std=c++14"],
+            extra_compile_args=["-O3", "-std=c++14", "-pthread"],
+            extra_link_args=["-pthread"],
             include_dirs=['lib', numpy.get_include()],
             language="c++",
         )
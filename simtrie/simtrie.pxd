@@ -1,3 +1,7 @@
+from libc.stdint cimport int64_t, uint16_t, uint32_t, uint64_t
+from libcpp cimport bool as cpp_bool
+from libcpp.vector cimport vector
+
 cdef extern from "../lib/dawgdic/base-types.h" namespace "dawgdic":
 	# 8-bit characters.
 	ctypedef char CharType
@@ -10,7 +14,7 @@ cdef extern from "../lib/dawgdic/base-types.h" namespace "dawgdic":
 	ctypedef unsigned int BaseType
 
 	# 32 or 64-bit unsigned integer.
-	ctypedef int SizeType
+	ctypedef size_t SizeType
 
 	# Function for reading and writing data.
 	ctypedef bint (*IOFunction)(void *stream, void *buf, size_t size)
@@ -36,9 +40,63 @@ cdef extern from "../lib/dawgdic/completer.h" namespace "dawgdic" nogil:
 		void Start(BaseType index, char *prefix)
 		void Start(BaseType index, char *prefix, SizeType length)
 
+		# Skips the keys before prefix + key, right after Start().
+		void Seek(char *key, SizeType length)
+
 		# Gets the next key.
 		bint Next()
 
+	# completes keys of a Dictionary64.
+	cdef cppclass Completer64:
+		Completer64()
+		Completer64(Dictionary64 &dic, Guide &guide)
+
+		void set_dic(Dictionary64 &dic)
+		void set_guide(Guide &guide)
+
+		char *key()
+		SizeType length()
+		int64_t value()
+
+		void Start(uint64_t index)
+		void Start(uint64_t index, char *prefix)
+		void Start(uint64_t index, char *prefix, SizeType length)
+		void Seek(char *key, SizeType length)
+
+		bint Next()
+
+	# completes keys of a Louds, which is its own guide.
+	cdef cppclass LoudsCompleter:
+		LoudsCompleter()
+
+		void set_dic(Louds &dic)
+		void set_guide(Louds &guide)
+
+		char *key()
+		SizeType length()
+		ValueType value()
+
+		void Start(uint64_t index, char *prefix, SizeType length)
+		void Seek(char *key, SizeType length)
+
+		bint Next()
+
+	# completes keys of an InterleavedDictionary, which is its own guide.
+	cdef cppclass InterleavedCompleter:
+		InterleavedCompleter()
+
+		void set_dic(InterleavedDictionary &dic)
+		void set_guide(InterleavedDictionary &guide)
+
+		char *key()
+		SizeType length()
+		ValueType value()
+
+		void Start(BaseType index, char *prefix, SizeType length)
+		void Seek(char *key, SizeType length)
+
+		bint Next()
+
 cdef extern from "../lib/dawgdic/dawg.h" namespace "dawgdic":
 
 	cdef cppclass Dawg:
@@ -111,12 +169,243 @@ cdef extern from "../lib/dawgdic/dawg-builder.h" namespace "dawgdic":
 		void Clear() nogil
 
 		# Inserts a key.
-		bint Insert(CharType *key)
-		bint Insert(CharType *key, ValueType value)
-		bint Insert(CharType *key, SizeType length, ValueType value)
+		bint Insert(CharType *key) nogil
+		bint Insert(CharType *key, ValueType value) nogil
+		bint Insert(CharType *key, SizeType length, ValueType value) nogil
 
 		# Finishes building a dawg.
-		bint Finish(Dawg *dawg)
+		bint Finish(Dawg *dawg) nogil
+
+cdef extern from "../lib/dawgdic/build-monitor.h" namespace "dawgdic":
+	cdef cppclass BuildMonitor:
+		BuildMonitor() nogil
+
+		# Counts of what builders have done so far.
+		SizeType num_of_keys() nogil
+		SizeType num_of_units() nogil
+		bint is_cancelled() nogil
+
+		void add_keys(SizeType num_of_keys) nogil
+		void add_units(SizeType num_of_units) nogil
+
+		# Makes builders stop as soon as they check.
+		void Cancel() nogil
+		# Sets counts to 0 for the next phase of a build.
+		void Reset() nogil
+
+cdef extern from "../lib/dawgdic/parallel-dawg-builder.h" namespace "dawgdic":
+	cdef cppclass ParallelDawgBuilder:
+		# Builds a dawg from sorted keys on several threads.
+		@staticmethod
+		bint Build(const CharType * const *keys, const SizeType *lengths, const ValueType *values,
+			SizeType num_of_keys, SizeType num_of_threads, Dawg *dawg, BuildMonitor *monitor) nogil
+
+cdef extern from "../lib/dawgdic/external-sorter.h" namespace "dawgdic::ExternalSorter":
+	cdef enum:
+		DEFAULT_MEMORY_LIMIT
+
+cdef extern from "../lib/dawgdic/external-sorter.h" namespace "dawgdic":
+	cdef cppclass ExternalSorter:
+		ExternalSorter(SizeType memory_limit, const char *tmp_dir) nogil
+
+		SizeType num_of_keys() nogil
+		SizeType num_of_runs() nogil
+		bint failed() nogil
+
+		# These member functions are available only when Next() returns true.
+		const CharType *key() nogil
+		SizeType length() nogil
+
+		# Adds a key, writing a sorted run if the buffer is full.
+		bint Insert(const CharType *key, SizeType length) nogil
+
+		# Merges runs and gets keys in byte order without duplicates.
+		bint Finish() nogil
+		bint Next() nogil
+
+		# Removes keys and temporary files.
+		void Clear() nogil
+
+cdef extern from "../lib/dawgdic/key-arena.h" namespace "dawgdic":
+	cdef cppclass KeyArena:
+		KeyArena() nogil
+
+		# These member functions are available after Finish().
+		const CharType * const *keys() nogil
+		const SizeType *lengths() nogil
+		const ValueType *values() nogil
+
+		SizeType num_of_keys() nogil
+		SizeType size() nogil
+
+		# Adds a copy of a key, fails on empty keys and keys with '\0'.
+		bint Insert(const CharType *key, SizeType length) nogil
+		# Adds a copy of any key.
+		void Append(const CharType *key, SizeType length) nogil
+
+		# Finishes inserting keys.
+		void Finish() nogil
+
+		# Sorts keys with their insertion indices as values.
+		void Sort(SizeType num_of_threads) nogil
+
+		# Removes duplicates from sorted keys, fails on keys out of order.
+		bint Unique(SizeType *index) nogil
+
+		# Checks if sorted keys have no duplicates.
+		bint IsStrictlySorted(SizeType *index) nogil
+
+		# Removes all keys.
+		void Clear() nogil
+
+cdef extern from "../lib/dawgdic/key-file.h" namespace "dawgdic":
+	cdef cppclass KeyFile:
+		KeyFile() nogil
+
+		const CharType * const *keys() nogil
+		const SizeType *lengths() nogil
+		SizeType num_of_keys() nogil
+
+		# Maps a file and splits it into keys.
+		bint Open(const char *path, CharType delimiter) nogil
+
+		# Checks that no key contains '\0'.
+		bint Validate(SizeType *index) nogil
+
+		# Sorts keys and removes duplicates.
+		void Sort(SizeType num_of_threads) nogil
+
+		# Removes duplicates from sorted keys, fails on keys out of order.
+		bint Unique(SizeType *index) nogil
+
+		# Unmaps the file.
+		void Clear() nogil
+
+cdef extern from "../lib/dawgdic/unsorted-dawg-builder.h" namespace "dawgdic":
+	cdef cppclass UnsortedDawgBuilder:
+		UnsortedDawgBuilder() nogil
+
+		# Number of distinct keys.
+		SizeType num_of_keys() nogil
+
+		# Number of states, including the root.
+		SizeType num_of_states() nogil
+
+		# Initializes a builder.
+		void Clear() nogil
+
+		# Inserts a key in any order.
+		bint Insert(const CharType *key, SizeType length, ValueType value) nogil
+
+		# Finishes building a dawg.
+		bint Finish(Dawg *dawg) nogil
+
+cdef extern from "../lib/dawgdic/set-operations.h" namespace "dawgdic::SetOperations":
+	cdef enum Operation:
+		UNION
+		INTERSECTION
+		DIFFERENCE
+		SYMMETRIC_DIFFERENCE
+
+cdef extern from "../lib/dawgdic/set-operations.h" namespace "dawgdic":
+	cdef cppclass SetOperations:
+		# Builds a dawg from the keys of two dictionaries walked in lockstep.
+		@staticmethod
+		bint Apply(Operation operation,
+			const Dictionary &lhs_dic, const Guide *lhs_guide,
+			const Dictionary &rhs_dic, const Guide *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const Dictionary &lhs_dic, const Guide *lhs_guide,
+			const Dictionary64 &rhs_dic, const Guide *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const Dictionary64 &lhs_dic, const Guide *lhs_guide,
+			const Dictionary &rhs_dic, const Guide *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const Dictionary64 &lhs_dic, const Guide *lhs_guide,
+			const Dictionary64 &rhs_dic, const Guide *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const Louds &lhs_dic, const Louds *lhs_guide,
+			const Louds &rhs_dic, const Louds *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const Louds &lhs_dic, const Louds *lhs_guide,
+			const Dictionary &rhs_dic, const Guide *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const Louds &lhs_dic, const Louds *lhs_guide,
+			const Dictionary64 &rhs_dic, const Guide *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const Dictionary &lhs_dic, const Guide *lhs_guide,
+			const Louds &rhs_dic, const Louds *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const Dictionary64 &lhs_dic, const Guide *lhs_guide,
+			const Louds &rhs_dic, const Louds *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const Dictionary &lhs_dic, const Guide *lhs_guide,
+			const InterleavedDictionary &rhs_dic, const InterleavedDictionary *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const Dictionary64 &lhs_dic, const Guide *lhs_guide,
+			const InterleavedDictionary &rhs_dic, const InterleavedDictionary *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const Louds &lhs_dic, const Louds *lhs_guide,
+			const InterleavedDictionary &rhs_dic, const InterleavedDictionary *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const InterleavedDictionary &lhs_dic, const InterleavedDictionary *lhs_guide,
+			const Dictionary &rhs_dic, const Guide *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const InterleavedDictionary &lhs_dic, const InterleavedDictionary *lhs_guide,
+			const Dictionary64 &rhs_dic, const Guide *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const InterleavedDictionary &lhs_dic, const InterleavedDictionary *lhs_guide,
+			const Louds &rhs_dic, const Louds *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
+		@staticmethod
+		bint Apply(Operation operation,
+			const InterleavedDictionary &lhs_dic, const InterleavedDictionary *lhs_guide,
+			const InterleavedDictionary &rhs_dic, const InterleavedDictionary *rhs_guide,
+			Dawg *dawg, SizeType *num_of_keys,
+			vector[ValueType] *lhs_values, vector[ValueType] *rhs_values) nogil
 
 cdef extern from "../lib/dawgdic/dictionary.h" namespace "dawgdic":
 	cdef cppclass Dictionary:
@@ -143,6 +432,10 @@ cdef extern from "../lib/dawgdic/dictionary.h" namespace "dawgdic":
 		# Writes a dictionry to an output stream.
 		bint Write(IOFunction write, void *stream) except +
 
+		# Reads and writes units without a size prefix.
+		bint ReadUnits(IOFunction read, void *stream, SizeType size, bint swap_byte_order) except +
+		bint WriteUnits(IOFunction write, void *stream) except +
+
 		# Exact matching.
 		bint Contains(CharType *key) nogil
 		bint Contains(CharType *key, SizeType length) nogil
@@ -166,6 +459,7 @@ cdef extern from "../lib/dawgdic/dictionary.h" namespace "dawgdic":
 
 		# Maps memory with its size.
 		const void *Map(const void *address) nogil
+		void Map(const void *address, SizeType size) nogil
 
 		# Initializes a dictionary.
 		void Clear() nogil
@@ -175,10 +469,212 @@ cdef extern from "../lib/dawgdic/dictionary.h" namespace "dawgdic":
 		# Shrinks a vector.
 		void Shrink() nogil
 
+	# a dictionary of 64-bit units, for automata too large for Dictionary.
+	cdef cppclass Dictionary64:
+
+		Dictionary64() nogil
+
+		DictionaryUnit64 *units() nogil
+		SizeType size() nogil
+		SizeType total_size() nogil
+
+		uint64_t root() nogil
+
+		bint has_value(uint64_t index) nogil
+		int64_t value(uint64_t index) nogil
+
+		# Reads and writes units without a size prefix.
+		bint ReadUnits(IOFunction read, void *stream, SizeType size, bint swap_byte_order) except +
+		bint WriteUnits(IOFunction write, void *stream) except +
+
+		bint Contains(CharType *key, SizeType length) nogil
+		int64_t Find(CharType *key, SizeType length) nogil
+
+		bint Follow(CharType label, uint64_t *index) nogil
+		bint Follow(CharType *s, SizeType length, uint64_t *index) nogil
+
+		void Map(const void *address, SizeType size) nogil
+
+		void Clear() nogil
+
+cdef extern from "../lib/dawgdic/interleaved-dictionary.h" namespace "dawgdic":
+	# a dictionary whose units carry the labels of its guide, which it
+	# replaces.
+	cdef cppclass InterleavedDictionary:
+		InterleavedDictionary() nogil
+
+		SizeType size() nogil
+		SizeType total_size() nogil
+
+		bint has_value(BaseType index) nogil
+
+		bint ReadUnits(IOFunction read, void *stream, SizeType size, bint swap_byte_order) except +
+		bint WriteUnits(IOFunction write, void *stream) except +
+
+		bint Contains(CharType *key, SizeType length) nogil
+		ValueType Find(CharType *key, SizeType length) nogil
+
+		bint Follow(CharType *s, SizeType length, BaseType *index) nogil
+
+		void Map(const void *address, SizeType size) nogil
+
+		void Clear() nogil
+
+		# Builds units from a dictionary and its guide.
+		bint Build(const Dictionary &dic, const Guide &guide) nogil
+
+cdef extern from "../lib/dawgdic/interleaved-dictionary-unit.h" namespace "dawgdic":
+	cdef cppclass InterleavedDictionaryUnit:
+		InterleavedDictionaryUnit() nogil
+
+cdef extern from "../lib/dawgdic/louds.h" namespace "dawgdic":
+	# a succinct trie, which takes less memory than a dictionary and its
+	# guide but follows transitions more slowly.
+	cdef cppclass Louds:
+		Louds() nogil
+
+		uint64_t *units() nogil
+		SizeType size() nogil
+		SizeType total_size() nogil
+		SizeType num_of_nodes() nogil
+
+		uint64_t root() nogil
+
+		bint has_value(uint64_t index) nogil
+		ValueType value(uint64_t index) nogil
+
+		bint ReadUnits(IOFunction read, void *stream, SizeType size, bint swap_byte_order) except +
+		bint WriteUnits(IOFunction write, void *stream) except +
+
+		bint Contains(CharType *key, SizeType length) nogil
+		ValueType Find(CharType *key, SizeType length) nogil
+
+		bint Follow(CharType label, uint64_t *index) nogil
+		bint Follow(CharType *s, SizeType length, uint64_t *index) nogil
+
+		bint Map(const void *address, SizeType size) nogil
+
+		void Clear() nogil
+
+cdef extern from "../lib/dawgdic/louds-builder.h" namespace "dawgdic":
+	cdef cppclass LoudsBuilder:
+		@staticmethod
+		bint Build(const Dawg &dawg, Louds *louds, BuildMonitor *monitor) nogil
+
+cdef extern from "../lib/dawgdic/rank-index.h" namespace "dawgdic":
+	cdef cppclass RankIndex:
+		RankIndex() nogil
+
+		SizeType size() nogil
+		SizeType total_size() nogil
+
+		# Finds the rank of a key, or returns false.
+		bint Rank(const Dictionary &dic, const CharType *key, SizeType length, SizeType *rank) nogil
+		bint Rank(const InterleavedDictionary &dic, const CharType *key, SizeType length, SizeType *rank) nogil
+		bint Rank(const Louds &louds, const CharType *key, SizeType length, SizeType *rank) nogil
+
+		# Finds the key of a rank, or returns false.
+		bint Select(const Dictionary &dic, const Guide &guide, SizeType rank, vector[CharType] *key) nogil
+		bint Select(const InterleavedDictionary &dic, const InterleavedDictionary &guide, SizeType rank,
+			vector[CharType] *key) nogil
+		bint Select(const Louds &louds, const Louds &guide, SizeType rank, vector[CharType] *key) nogil
+
+		# Finds the ranks of the keys with a prefix, or returns false.
+		bint Range(const Dictionary &dic, const Guide &guide, SizeType num_of_keys,
+			const CharType *prefix, SizeType length, SizeType *begin, SizeType *end) nogil
+		bint Range(const InterleavedDictionary &dic, const InterleavedDictionary &guide,
+			SizeType num_of_keys, const CharType *prefix, SizeType length,
+			SizeType *begin, SizeType *end) nogil
+		bint Range(const Louds &louds, const Louds &guide, SizeType num_of_keys,
+			const CharType *prefix, SizeType length, SizeType *begin, SizeType *end) nogil
+
+		bint ReadUnits(IOFunction read, void *stream, SizeType size, bint swap_byte_order) nogil
+		bint WriteUnits(IOFunction write, void *stream) nogil
+		void Map(const void *address, SizeType size) nogil
+		void Clear() nogil
+
+	cdef cppclass RankIndex64:
+		RankIndex64() nogil
+
+		SizeType size() nogil
+		SizeType total_size() nogil
+
+		bint Rank(const Dictionary64 &dic, const CharType *key, SizeType length, SizeType *rank) nogil
+		bint Select(const Dictionary64 &dic, const Guide &guide, SizeType rank, vector[CharType] *key) nogil
+		bint Range(const Dictionary64 &dic, const Guide &guide, SizeType num_of_keys,
+			const CharType *prefix, SizeType length, SizeType *begin, SizeType *end) nogil
+
+		bint ReadUnits(IOFunction read, void *stream, SizeType size, bint swap_byte_order) nogil
+		bint WriteUnits(IOFunction write, void *stream) nogil
+		void Map(const void *address, SizeType size) nogil
+		void Clear() nogil
+
+cdef extern from "../lib/dawgdic/rank-index-builder.h" namespace "dawgdic":
+	cdef cppclass RankIndexBuilder:
+		# Counts the keys below each index, and returns false if a count
+		# does not fit into a unit.
+		@staticmethod
+		bint Build(const Dictionary &dic, const Guide &guide, RankIndex *rank_index) nogil
+		@staticmethod
+		bint Build(const Dictionary64 &dic, const Guide &guide, RankIndex64 *rank_index) nogil
+		@staticmethod
+		bint Build(const InterleavedDictionary &dic, const InterleavedDictionary &guide,
+			RankIndex *rank_index) nogil
+		@staticmethod
+		bint Build(const Louds &louds, const Louds &guide, RankIndex *rank_index) nogil
+
+cdef extern from "../lib/dawgdic/batch-lookup.h" namespace "dawgdic":
+	cdef cppclass BatchLookup:
+		# Exact matching of many keys, where key i takes the bytes from
+		# offsets[i] up to offsets[i + 1].
+		@staticmethod
+		void Contains(const Dictionary &dic, const CharType *keys,
+			const SizeType *offsets, SizeType num_of_keys, cpp_bool *found) nogil
+		@staticmethod
+		void Contains(const Dictionary64 &dic, const CharType *keys,
+			const SizeType *offsets, SizeType num_of_keys, cpp_bool *found) nogil
+		@staticmethod
+		void Contains(const InterleavedDictionary &dic, const CharType *keys,
+			const SizeType *offsets, SizeType num_of_keys, cpp_bool *found) nogil
+		@staticmethod
+		void Contains(const Louds &louds, const CharType *keys,
+			const SizeType *offsets, SizeType num_of_keys, cpp_bool *found) nogil
+
+		# Finds values, or -1 for keys not found.
+		@staticmethod
+		void Find(const Dictionary &dic, const CharType *keys,
+			const SizeType *offsets, SizeType num_of_keys, int64_t *values) nogil
+		@staticmethod
+		void Find(const Dictionary64 &dic, const CharType *keys,
+			const SizeType *offsets, SizeType num_of_keys, int64_t *values) nogil
+		@staticmethod
+		void Find(const InterleavedDictionary &dic, const CharType *keys,
+			const SizeType *offsets, SizeType num_of_keys, int64_t *values) nogil
+		@staticmethod
+		void Find(const Louds &louds, const CharType *keys,
+			const SizeType *offsets, SizeType num_of_keys, int64_t *values) nogil
+
 cdef extern from "../lib/dawgdic/dictionary-builder.h" namespace "dawgdic::DictionaryBuilder":
 	cdef cppclass DictionaryBuilder:
 		@staticmethod
-		bint Build (Dawg &dawg, Dictionary *dic) nogil
+		bint Build (Dawg &dawg, Dictionary *dic, BaseType *num_of_unused_units, Guide *guide,
+			BuildMonitor *monitor, SizeType hot_size) nogil
+
+cdef extern from "../lib/dawgdic/parallel-dictionary-builder.h" namespace "dawgdic":
+	cdef cppclass ParallelDictionaryBuilder:
+		# Builds a dictionary from a dawg on several threads, and a guide
+		# if given. Small dawgs are built sequentially. Units are laid out
+		# for searches if hot_size is not 0.
+		@staticmethod
+		bint Build(const Dawg &dawg, SizeType num_of_threads, Dictionary *dic,
+			BaseType *num_of_unused_units, Guide *guide, BuildMonitor *monitor,
+			SizeType hot_size) nogil
+
+	cdef cppclass ParallelDictionaryBuilder64:
+		@staticmethod
+		bint Build(const Dawg &dawg, SizeType num_of_threads, Dictionary64 *dic,
+			uint64_t *num_of_unused_units, Guide *guide, BuildMonitor *monitor,
+			SizeType hot_size) nogil
 
 cdef extern from "../lib/dawgdic/dictionary-unit.h" namespace "dawgdic":
 	cdef cppclass DictionaryUnit:
@@ -210,6 +706,65 @@ cdef extern from "../lib/dawgdic/dictionary-unit.h" namespace "dawgdic":
 		# Reads an offset to child units from a non-leaf unit.
 		BaseType offset() nogil
 
+	cdef cppclass DictionaryUnit64:
+		DictionaryUnit64() nogil
+
+cdef extern from "../lib/dawgdic/file-format.h" namespace "dawgdic":
+	cdef struct FileSection:
+		uint32_t type
+		uint32_t flags
+		uint64_t offset
+		uint64_t size
+		uint64_t count
+
+	cdef struct FileHeader:
+		char magic[8]
+		uint32_t byte_order
+		uint16_t major_version
+		uint16_t minor_version
+		uint32_t flags
+		uint32_t alignment
+		uint32_t num_of_sections
+		uint32_t section_table_offset
+		uint64_t num_of_keys
+
+	cdef cppclass FileFormat:
+		@staticmethod
+		void InitHeader(FileHeader *header) nogil
+		@staticmethod
+		void SetFlag(FileHeader *header, HeaderFlag flag) nogil
+		@staticmethod
+		bint HasMagic(const FileHeader &header) nogil
+		@staticmethod
+		bint IsSwapped(const FileHeader &header) nogil
+		@staticmethod
+		bint IsSupported(const FileHeader &header) nogil
+		@staticmethod
+		void SwapHeader(FileHeader *header) nogil
+		@staticmethod
+		void SwapSection(FileSection *section) nogil
+		@staticmethod
+		uint64_t Align(uint64_t offset, uint64_t alignment) nogil
+
+cdef extern from "../lib/dawgdic/file-format.h" namespace "dawgdic::FileFormat":
+	cdef enum:
+		DEFAULT_ALIGNMENT
+		PAGE_ALIGNMENT
+
+	cdef enum SectionType:
+		DICTIONARY_SECTION
+		GUIDE_SECTION
+		METADATA_SECTION
+		VALUES_SECTION
+		LOUDS_SECTION
+		INTERLEAVED_SECTION
+		RANKS_SECTION
+
+	cdef enum HeaderFlag:
+		WIDE_UNITS_FLAG
+		SUCCINCT_FLAG
+		INTERLEAVED_FLAG
+
 cdef extern from "../lib/dawgdic/guide.h" namespace "dawgdic":
 	cdef cppclass Guide:
 
@@ -232,8 +787,13 @@ cdef extern from "../lib/dawgdic/guide.h" namespace "dawgdic":
 		# Writes a dictionry to an output stream.
 		bint Write(IOFunction write, void *stream) const
 
+		# Reads and writes units without a size prefix.
+		bint ReadUnits(IOFunction read, void *stream, SizeType size) except +
+		bint WriteUnits(IOFunction write, void *stream) const
+
 		# Maps memory with its size.
 		const void *Map(const void *address) nogil
+		void Map(const void *address, SizeType size) nogil
 
 		# Swaps Guides.
 		void Swap(Guide *Guide)
@@ -287,6 +847,51 @@ cdef extern from "../lib/dawgdic/similar.h" namespace "dawgdic" nogil:
 		# Gets the next key.
 		bint next() nogil
 
+	cdef cppclass LCS64:
+		LCS64()
+
+		void set_dic(Dictionary64 &dic)
+		void set_guide(Guide &guide)
+
+		char *key()
+		SizeType key_length()
+		int64_t value()
+		char *lcs()
+		SizeType lcs_length()
+
+		void start(char *s, size_t len, int min_length) nogil
+		bint next() nogil
+
+	cdef cppclass LoudsLCS:
+		LoudsLCS()
+
+		void set_dic(Louds &dic)
+		void set_guide(Louds &guide)
+
+		char *key()
+		SizeType key_length()
+		ValueType value()
+		char *lcs()
+		SizeType lcs_length()
+
+		void start(char *s, size_t len, int min_length) nogil
+		bint next() nogil
+
+	cdef cppclass InterleavedLCS:
+		InterleavedLCS()
+
+		void set_dic(InterleavedDictionary &dic)
+		void set_guide(InterleavedDictionary &guide)
+
+		char *key()
+		SizeType key_length()
+		ValueType value()
+		char *lcs()
+		SizeType lcs_length()
+
+		void start(char *s, size_t len, int min_length) nogil
+		bint next() nogil
+
 	cdef cppclass Similar[CostType]:
 		Similar()
 
@@ -313,6 +918,63 @@ cdef extern from "../lib/dawgdic/similar.h" namespace "dawgdic" nogil:
 		void set_enable_split(bint enable)
 		void set_enable_merge(bint enable)
 
+	cdef cppclass Similar64[CostType]:
+		Similar64()
+
+		void set_dic(Dictionary64 &dic)
+		void set_guide(Guide &guide)
+		void set_costs(const Costs[CostType] &costs)
+
+		char *key()
+		SizeType key_length()
+		int64_t value()
+		CostType cost()
+
+		void start(char *s, size_t len, CostType max_cost) nogil
+		bint next() nogil
+
+		void set_enable_transpose(bint enable)
+		void set_enable_split(bint enable)
+		void set_enable_merge(bint enable)
+
+	cdef cppclass LoudsSimilar[CostType]:
+		LoudsSimilar()
+
+		void set_dic(Louds &dic)
+		void set_guide(Louds &guide)
+		void set_costs(const Costs[CostType] &costs)
+
+		char *key()
+		SizeType key_length()
+		ValueType value()
+		CostType cost()
+
+		void start(char *s, size_t len, CostType max_cost) nogil
+		bint next() nogil
+
+		void set_enable_transpose(bint enable)
+		void set_enable_split(bint enable)
+		void set_enable_merge(bint enable)
+
+	cdef cppclass InterleavedSimilar[CostType]:
+		InterleavedSimilar()
+
+		void set_dic(InterleavedDictionary &dic)
+		void set_guide(InterleavedDictionary &guide)
+		void set_costs(const Costs[CostType] &costs)
+
+		char *key()
+		SizeType key_length()
+		ValueType value()
+		CostType cost()
+
+		void start(char *s, size_t len, CostType max_cost) nogil
+		bint next() nogil
+
+		void set_enable_transpose(bint enable)
+		void set_enable_split(bint enable)
+		void set_enable_merge(bint enable)
+
 cdef extern from "<istream>" namespace "std" nogil:
 	cdef cppclass istream:
 		istream() except +
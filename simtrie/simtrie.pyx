@@ -9,22 +9,97 @@ cimport simtrie.simtrie
 from simtrie.simtrie cimport *
 
 import collections
+import heapq
+import contextlib
+import threading
 import sys
 import pickle
 import io
 import os
+import resource
+import time
 import msgpack
+import numpy
 
-from libc.stdint cimport uint8_t, uint16_t, uint64_t
+from libc.stdint cimport int64_t, uint8_t, uint16_t, uint32_t, uint64_t
+from libc.string cimport memcpy
 from libcpp.string cimport string
 from libcpp.vector cimport vector
 
 cimport posix.fcntl
 cimport posix.unistd
-from posix.mman cimport mmap, munmap, PROT_READ, MAP_SHARED
+from posix.mman cimport mmap, munmap, mlock, munlock, posix_madvise, PROT_READ, MAP_SHARED
+from posix.mman cimport POSIX_MADV_NORMAL, POSIX_MADV_RANDOM, POSIX_MADV_SEQUENTIAL, POSIX_MADV_WILLNEED
+from libc.errno cimport errno
+from cpython.unicode cimport PyUnicode_DATA, PyUnicode_GET_LENGTH
+
+cdef extern from "Python.h":
+	bint PyUnicode_IS_ASCII(object o)
 
 cdef void *MAP_FAILED = <void*>(-1)
 
+cdef extern from *:
+	"""
+	#include <sys/mman.h>
+	#include <unistd.h>
+	#include <vector>
+
+	#ifdef MAP_POPULATE
+	#define SIMTRIE_MAP_POPULATE MAP_POPULATE
+	#else
+	#define SIMTRIE_MAP_POPULATE 0
+	#endif
+
+	#ifdef MADV_HUGEPAGE
+	#define SIMTRIE_MADV_HUGEPAGE MADV_HUGEPAGE
+	#else
+	#define SIMTRIE_MADV_HUGEPAGE -1
+	#endif
+
+	// Reads one byte of each page to fault in a mapping.
+	static void simtrie_touch_pages(const void *addr, size_t size) {
+		const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		const volatile unsigned char *p = static_cast<const volatile unsigned char *>(addr);
+		unsigned char sum = 0;
+		for (size_t i = 0; i < size; i += page_size) {
+			sum ^= p[i];
+		}
+		(void)sum;
+	}
+
+	// Counts the bytes of a mapping that are resident in memory.
+	static long simtrie_resident_bytes(void *addr, size_t size) {
+		const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		std::vector<unsigned char> pages((size + page_size - 1) / page_size);
+	#ifdef __APPLE__
+		if (mincore(addr, size, reinterpret_cast<char *>(pages.data())) != 0) {
+	#else
+		if (mincore(addr, size, pages.data()) != 0) {
+	#endif
+			return -1;
+		}
+		size_t resident = 0;
+		for (size_t i = 0; i < pages.size(); i++) {
+			if (pages[i] & 1) {
+				resident += page_size;
+			}
+		}
+		return static_cast<long>(resident < size ? resident : size);
+	}
+	"""
+	int SIMTRIE_MAP_POPULATE
+	int SIMTRIE_MADV_HUGEPAGE
+	int madvise(void *addr, size_t size, int advice) nogil
+	void simtrie_touch_pages(const void *addr, size_t size) nogil
+	long simtrie_resident_bytes(void *addr, size_t size) nogil
+
+cdef dict _ADVICE = {
+	"normal": POSIX_MADV_NORMAL,
+	"random": POSIX_MADV_RANDOM,
+	"sequential": POSIX_MADV_SEQUENTIAL,
+	"willneed": POSIX_MADV_WILLNEED
+}
+
 cdef extern from *:
 	"""
 	#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
@@ -52,68 +127,456 @@ cdef bint read_from_stream(void *stream, void *buf, size_t size):
 	n = s.readinto(ndarray)
 	return False if n is None else n == size
 
+cdef bytes MAGIC = b"SIMTRIE\0"
+
+cdef bint _has_magic(data) except -1:
+	return <size_t>len(data) >= sizeof(FileHeader) and data[:len(MAGIC)] == MAGIC
+
+cdef bint _parse_header(bytes data, FileHeader *header) except *:
+	# validates a header and returns whether it needs byte swapping.
+	cdef bint swapped
+
+	if len(data) != sizeof(FileHeader):
+		raise IOError("truncated file header")
+	memcpy(header, <const char*>data, sizeof(FileHeader))
+
+	swapped = FileFormat.IsSwapped(header[0])
+	if swapped:
+		FileFormat.SwapHeader(header)
+	if not FileFormat.IsSupported(header[0]):
+		raise IOError("unsupported file format")
+
+	return swapped
+
+cdef list _parse_sections(bytes data, uint64_t table_offset, const FileHeader *header, bint swapped):
+	# returns the sections in a table as (type, offset, size, count), sorted by offset.
+	cdef FileSection section
+	cdef const char *p
+	cdef uint32_t i
+	cdef list sections = []
+
+	if <uint64_t>len(data) != table_offset - sizeof(FileHeader) + \
+			header.num_of_sections * sizeof(FileSection):
+		raise IOError("truncated section table")
+	p = <const char*>data + (table_offset - sizeof(FileHeader))
+
+	for i in range(header.num_of_sections):
+		memcpy(&section, p + i * sizeof(FileSection), sizeof(FileSection))
+		if swapped:
+			FileFormat.SwapSection(&section)
+		sections.append((section.type, section.offset, section.size, section.count))
+
+	sections.sort(key=lambda s: s[1])
+	return sections
+
+ctypedef fused AnyCompleter:
+	Completer
+	Completer64
+	LoudsCompleter
+	InterleavedCompleter
+
+ctypedef fused AnyWalker:
+	Completer
+	Completer64
+	LoudsCompleter
+	InterleavedCompleter
+	Similar[float]
+	Similar64[float]
+	LoudsSimilar[float]
+	InterleavedSimilar[float]
+	LCS
+	LCS64
+	LoudsLCS
+	InterleavedLCS
+
+cdef _bind(AnyWalker *walker, Set owner):
+	# sets the units of owner, of the kind the walker is for, and their
+	# guide. a louds or an interleaved dictionary is its own guide.
+	if AnyWalker is LoudsCompleter or AnyWalker is LoudsSimilar[float] or AnyWalker is LoudsLCS:
+		walker.set_dic(owner.louds)
+		walker.set_guide(owner.louds)
+	elif AnyWalker is InterleavedCompleter or AnyWalker is InterleavedSimilar[float] or \
+			AnyWalker is InterleavedLCS:
+		walker.set_dic(owner.idct)
+		walker.set_guide(owner.idct)
+	elif AnyWalker is Completer64 or AnyWalker is Similar64[float] or AnyWalker is LCS64:
+		walker.set_dic(owner.dct64)
+		walker.set_guide(owner.guide)
+	else:
+		walker.set_dic(owner.dct)
+		walker.set_guide(owner.guide)
+
+cdef _start_completer(AnyCompleter *completer, Set owner, uint64_t index, bytes b_prefix,
+	bytes b_seek):
+	# starts completing keys with a prefix at index, from the first that
+	# is not before the prefix followed by b_seek.
+	_bind(completer, owner)
+	completer.Start(index, b_prefix, len(b_prefix))
+	completer.Seek(b_seek, len(b_seek))
+
 cdef class Iterator:
 	cdef Completer completer
+	cdef Completer64 completer64
+	cdef LoudsCompleter louds_completer
+	cdef InterleavedCompleter interleaved_completer
+	cdef bint _wide
+	cdef bint _succinct
+	cdef bint _interleaved
 	cdef bytes b_prefix
-
-	def __init__(self, Set owner, unicode prefix):
-		cdef Dictionary *dct = &owner.dct
-		cdef BaseType index = dct.root()
-
-		self.completer.set_dic(owner.dct)
-		self.completer.set_guide(owner.guide)
-
-		if prefix:
-			b_prefix = prefix.encode("utf8")
-
-			if not dct.Follow(<CharType*>b_prefix, &index):
-				raise StopIteration
-
-			self.completer.Start(index, b_prefix, len(b_prefix))
+	cdef Set _owner
+	cdef unicode _stop
+	# keys left to return before the limit, or -1 without one.
+	cdef Py_ssize_t _remaining
+	# whether the completer holds a key that has not been returned yet,
+	# and if so, whether there is one.
+	cdef bint _pending
+	cdef bint _has_key
+
+	def __init__(self, Set owner, unicode prefix, unicode start=None, unicode stop=None, limit=None):
+		# start: the first key, or any key before it that is not before the
+		# last key returned; keys before it are skipped in a walk down.
+		# stop: the key after the last. limit: the most keys to return.
+		cdef bytes b_prefix = prefix.encode("utf8")
+		cdef bytes b_start = start.encode("utf8") if start is not None else b""
+		cdef bytes b_seek
+		cdef uint64_t index = 0
+
+		self._owner = owner  # keeps units alive
+		self._wide = owner._wide
+		self._succinct = owner._succinct
+		self._interleaved = owner._interleaved
+		self._stop = stop
+		self._remaining = -1
+		if limit is not None:
+			if limit < 0:
+				raise ValueError("limit must not be negative")
+			self._remaining = limit
+
+		if not owner._follow(b_prefix, len(b_prefix), &index):
+			self._pending = True
+			return
+		if b_start.startswith(b_prefix):
+			b_seek = b_start[len(b_prefix):]
+		elif b_start < b_prefix:
+			b_seek = b""
+		else:
+			# all keys with the prefix are before start.
+			self._pending = True
+			return
+
+		if self._succinct:
+			_start_completer(&self.louds_completer, owner, index, b_prefix, b_seek)
+		elif self._interleaved:
+			_start_completer(&self.interleaved_completer, owner, index, b_prefix, b_seek)
+		elif self._wide:
+			_start_completer(&self.completer64, owner, index, b_prefix, b_seek)
 		else:
-			self.completer.Start(index, b"", 0)
+			_start_completer(&self.completer, owner, index, b_prefix, b_seek)
 
 	def __iter__(self):
 		return self
 
+	property cursor:
+		# where the next page starts: the next key, to be passed as start,
+		# or None if no keys are left. it is serializable, and resuming
+		# from it takes a walk down instead of skipping the keys before.
+		def __get__(self):
+			if self._peek():
+				return self._key()
+			return None
+
+	cdef bint _next(self):
+		# moves to the next key in range.
+		if self._remaining == 0 or not self._peek():
+			return False
+		self._pending = False
+		if self._remaining > 0:
+			self._remaining -= 1
+		return True
+
+	cdef bint _peek(self):
+		# lets the completer hold the next key in range without returning
+		# it, and returns whether there is one.
+		if not self._pending:
+			self._pending = True
+			# strings compare by code point, as their utf8 encodings do.
+			self._has_key = self._next_key() and (self._stop is None or self._key() < self._stop)
+		return self._has_key
+
+	cdef bint _next_key(self):
+		if self._succinct:
+			return self.louds_completer.Next()
+		if self._interleaved:
+			return self.interleaved_completer.Next()
+		if self._wide:
+			return self.completer64.Next()
+		return self.completer.Next()
+
+	cdef unicode _key(self):
+		if self._succinct:
+			return (<char*>self.louds_completer.key()).decode("utf8")
+		if self._interleaved:
+			return (<char*>self.interleaved_completer.key()).decode("utf8")
+		if self._wide:
+			return (<char*>self.completer64.key()).decode("utf8")
+		return (<char*>self.completer.key()).decode("utf8")
+
+	cdef int64_t _value(self):
+		if self._succinct:
+			return self.louds_completer.value()
+		if self._interleaved:
+			return self.interleaved_completer.value()
+		if self._wide:
+			return self.completer64.value()
+		return self.completer.value()
+
 cdef class KeyIterator(Iterator):
 	def __next__(self):
-		if self.completer.Next():
-			return (<char*>self.completer.key()).decode("utf8")
+		if self._next():
+			return self._key()
 		else:
 			raise StopIteration
 
 cdef class ValueIterator(Iterator):
 	cdef object _values
 
-	def __init__(self, Set owner, unicode prefix, values):
-		super().__init__(owner, prefix)
+	def __init__(self, Set owner, unicode prefix, values, unicode start=None, unicode stop=None, limit=None):
+		super().__init__(owner, prefix, start, stop, limit)
 		self._values = values
 
 	def __next__(self):
-		if self.completer.Next():
-			return self._values[self.completer.value()]
+		if self._next():
+			return self._values[self._value()]
 		else:
 			raise StopIteration
 
 cdef class KeyValueIterator(Iterator):
 	cdef object _values
 
-	def __init__(self, Set owner, unicode prefix, values):
-		super().__init__(owner, prefix)
+	def __init__(self, Set owner, unicode prefix, values, unicode start=None, unicode stop=None, limit=None):
+		super().__init__(owner, prefix, start, stop, limit)
 		self._values = values
 
 	def __next__(self):
-		if self.completer.Next():
-			return ((<char*>self.completer.key()).decode("utf8"), self._values[self.completer.value()])
+		if self._next():
+			return (self._key(), self._values[self._value()])
 		else:
 			raise StopIteration
 
-def sorted(iterable):
-	elements = [(<unicode>key).encode('utf8')
-		if isinstance(key, unicode) else key for key in iterable]
-	elements.sort()
-	return elements
+cdef _insert_key(KeyArena *arena, key, exception):
+	# copies the utf8 encoding of a key into an arena. ascii strings are
+	# copied directly, without creating a bytes object. keys are not
+	# checked if exception is None.
+	cdef bytes b_key
+	cdef const char *data
+	cdef Py_ssize_t length
+
+	if isinstance(key, unicode) and PyUnicode_IS_ASCII(key):
+		data = <const char*>PyUnicode_DATA(key)
+		length = PyUnicode_GET_LENGTH(key)
+	else:
+		if isinstance(key, unicode):
+			b_key = <bytes>(<unicode>key).encode('utf8')
+		else:
+			b_key = key
+		data = b_key
+		length = len(b_key)
+
+	if exception is None:
+		arena.Append(data, length)
+	elif not arena.Insert(data, length):
+		raise exception("error on inserting key %s" % key)
+
+cdef _pack_keys(keys, vector[CharType] *data, vector[SizeType] *offsets):
+	# concatenates the utf8 encodings of keys. key i takes the bytes from
+	# offsets[i] up to offsets[i + 1].
+	cdef bytes b_key
+	cdef const char *key_data
+	cdef Py_ssize_t length
+	cdef SizeType end
+
+	offsets.push_back(0)
+	for key in keys:
+		if isinstance(key, unicode) and PyUnicode_IS_ASCII(key):
+			key_data = <const char*>PyUnicode_DATA(key)
+			length = PyUnicode_GET_LENGTH(key)
+		else:
+			if isinstance(key, unicode):
+				b_key = <bytes>(<unicode>key).encode('utf8')
+			else:
+				b_key = key
+			key_data = b_key
+			length = len(b_key)
+
+		end = data.size()
+		data.resize(end + length)
+		if length != 0:
+			memcpy(data.data() + end, key_data, length)
+		offsets.push_back(data.size())
+
+cdef bytes _arena_key(KeyArena *arena, SizeType index):
+	return arena.keys()[index][:arena.lengths()[index]]
+
+cdef SizeType _num_of_threads(threads):
+	return os.cpu_count() if threads is None else threads
+
+class BuildCancelled(Exception):
+	# raised when a progress callback cancels a build.
+	pass
+
+class BuildStats(object):
+	# statistics of a build, as passed to progress callbacks. phase is one
+	# of "reading", "sorting", "dawg", "dictionary" and "done". keys counts
+	# the keys read or inserted into the dawg so far, units the units
+	# allocated for the dictionary. states and merging_states are known once
+	# the dawg is built, unused_units once the dictionary is. timings maps
+	# phases to seconds, and peak_rss is the peak resident memory of the
+	# process in bytes.
+	__slots__ = ("phase", "keys", "states", "merging_states", "units",
+		"unused_units", "timings", "peak_rss")
+
+	def __init__(self, **kwargs):
+		for name in self.__slots__:
+			setattr(self, name, kwargs.get(name))
+
+	def __repr__(self):
+		return "BuildStats(%s)" % ", ".join(
+			"%s=%r" % (name, getattr(self, name)) for name in self.__slots__)
+
+def _peak_rss():
+	# ru_maxrss is in kilobytes on linux and in bytes on macos.
+	rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+	return rss if sys.platform == "darwin" else rss * 1024
+
+class _TqdmProgress(object):
+	# shows the progress of a build in a tqdm bar per phase, as keys are
+	# counted again in each phase.
+	def __init__(self):
+		self.bar = None
+		self.phase = None
+
+	def __call__(self, stats):
+		if stats.phase != self.phase:
+			if self.bar is not None:
+				self.bar.close()
+			self.phase = stats.phase
+			self.bar = None
+			if stats.phase == "done":
+				return
+			from tqdm import tqdm
+			self.bar = tqdm(desc=stats.phase, unit=" keys")
+		self.bar.n = stats.keys or 0
+		if stats.units is not None:
+			self.bar.set_postfix(units=stats.units, refresh=False)
+		self.bar.refresh()
+
+_PROGRESS_INTERVAL = 0.25
+
+# units at the top of the trie that locality=True places breadth first,
+# which with their guide take about 384 KB.
+_HOT_SIZE = 1 << 16
+
+cdef class _BuildMonitor:
+	# times the phases of a build and counts keys and units. most phases
+	# run in C++ without the GIL, so progress callbacks are called from a
+	# watcher thread every _PROGRESS_INTERVAL seconds. a callback cancels
+	# the build by returning False or by raising an exception, which the
+	# builders notice through monitor.
+	cdef BuildMonitor monitor
+	cdef object stats
+	cdef object _callback
+	cdef object _thread
+	cdef object _stopped
+	cdef object _error
+	cdef double _phase_start
+
+	def __init__(self, progress=None):
+		self.stats = BuildStats(timings={})
+		self._callback = _TqdmProgress() if progress is True else progress
+		self._stopped = threading.Event()
+		if self._callback is not None:
+			self._thread = threading.Thread(target=self._watch, daemon=True)
+			self._thread.start()
+
+	def _watch(self):
+		while not self._stopped.wait(_PROGRESS_INTERVAL):
+			if not self._report():
+				break
+
+	def _report(self):
+		try:
+			result = self._callback(self.snapshot())
+		except BaseException as e:
+			self._error = e
+			self.monitor.Cancel()
+			return False
+		if result is False:
+			self.monitor.Cancel()
+			return False
+		return True
+
+	def snapshot(self):
+		stats = BuildStats()
+		for name in BuildStats.__slots__:
+			setattr(stats, name, getattr(self.stats, name))
+		if stats.phase in ("reading", "dawg"):
+			stats.keys = self.monitor.num_of_keys()
+		elif stats.phase == "dictionary":
+			stats.units = self.monitor.num_of_units()
+		stats.timings = dict(self.stats.timings)
+		if stats.phase != "done":
+			stats.timings[stats.phase] = time.perf_counter() - self._phase_start
+		stats.peak_rss = _peak_rss()
+		return stats
+
+	cdef phase(self, name):
+		cdef double now = time.perf_counter()
+		self.check()
+		if self.stats.phase is not None:
+			self.stats.timings[self.stats.phase] = now - self._phase_start
+			if self.stats.phase in ("reading", "dawg"):
+				self.stats.keys = self.monitor.num_of_keys()
+		self.monitor.Reset()
+		self.stats.phase = name
+		self._phase_start = now
+
+	cdef check(self):
+		# raises if the build has been cancelled.
+		if self.monitor.is_cancelled():
+			self.stop()
+			if self._error is not None:
+				raise self._error
+			raise BuildCancelled()
+
+	cdef stop(self):
+		self._stopped.set()
+		if self._thread is not None and self._thread is not threading.current_thread():
+			self._thread.join()
+
+	cdef finish(self, size_t num_of_units, long num_of_unused_units):
+		self.phase("done")
+		self.stop()
+		self.stats.units = num_of_units
+		self.stats.unused_units = num_of_unused_units
+		self.stats.peak_rss = _peak_rss()
+		if self._callback is not None:
+			self._callback(self.snapshot())
+		return self.stats
+
+def sorted(iterable, threads=1):
+	# encodes keys to utf8 and sorts them in byte order. unlike keys of a
+	# set, these may be empty or contain '\0'.
+	cdef KeyArena arena
+	cdef SizeType num_of_threads = _num_of_threads(threads)
+	cdef SizeType i
+
+	for key in iterable:
+		_insert_key(&arena, key, None)
+	arena.Finish()
+	with nogil:
+		arena.Sort(num_of_threads)
+
+	return [_arena_key(&arena, i) for i in range(arena.num_of_keys())]
 
 def _to_numpy_array(values):
 	# returns None if no compact numpy array could be created.
@@ -172,79 +635,420 @@ cdef class Metric:
 				raise ValueError("illegal cost rule (%s, %s) -> %s" % (old, new, cost))
 
 
+ctypedef fused AnySimilar:
+	Similar[float]
+	Similar64[float]
+	LoudsSimilar[float]
+	InterleavedSimilar[float]
+
+cdef _start_similar(AnySimilar *nearest, Set owner, bytes b_search, int max_cost,
+	Metric metric, dict kwargs):
+	# starts a search on the units of owner.
+	_bind(nearest, owner)
+	if metric:
+		nearest.set_costs(metric.costs)
+
+	nearest.set_enable_transpose(kwargs.get("allow_transpose", False))
+	nearest.set_enable_merge(kwargs.get("allow_merge", False))
+	nearest.set_enable_split(kwargs.get("allow_split", False))
+
+	nearest.start(b_search, len(b_search), max_cost)
+
+cdef tuple _next_similar(AnySimilar *nearest):
+	if not nearest.next():
+		raise StopIteration
+	key = nearest.key()[:nearest.key_length()].decode("utf8")
+	return key, nearest.value(), nearest.cost()
+
+ctypedef fused AnyLCS:
+	LCS
+	LCS64
+	LoudsLCS
+	InterleavedLCS
+
+cdef _start_lcs(AnyLCS *lcs, Set owner, bytes b_search, int min_length):
+	_bind(lcs, owner)
+	lcs.start(b_search, len(b_search), min_length)
+
+cdef tuple _next_lcs(AnyLCS *lcs):
+	if not lcs.next():
+		raise StopIteration
+	seq = lcs.lcs()[:lcs.lcs_length()].decode("utf8")
+	key = lcs.key()[:lcs.key_length()].decode("utf8")
+	return seq, key
+
+cdef class SimilarIterator:
+	# yields the keys within max_cost of search, with their values and costs.
+	cdef Similar[float] nearest
+	cdef Similar64[float] nearest64
+	cdef LoudsSimilar[float] louds_nearest
+	cdef InterleavedSimilar[float] interleaved_nearest
+	cdef Set _owner
+	cdef bytes _search
+	cdef Metric _metric
+
+	def __init__(self, Set owner, unicode search, int max_cost, Metric metric, dict kwargs):
+		self._owner = owner  # keeps units alive
+		self._search = search.encode('utf8')
+		self._metric = metric  # keeps costs alive
+
+		if owner._succinct:
+			_start_similar(&self.louds_nearest, owner, self._search, max_cost, metric, kwargs)
+		elif owner._interleaved:
+			_start_similar(&self.interleaved_nearest, owner, self._search, max_cost, metric, kwargs)
+		elif owner._wide:
+			_start_similar(&self.nearest64, owner, self._search, max_cost, metric, kwargs)
+		else:
+			_start_similar(&self.nearest, owner, self._search, max_cost, metric, kwargs)
+
+	def __iter__(self):
+		return self
+
+	def __next__(self):
+		if self._owner._succinct:
+			return _next_similar(&self.louds_nearest)
+		if self._owner._interleaved:
+			return _next_similar(&self.interleaved_nearest)
+		if self._owner._wide:
+			return _next_similar(&self.nearest64)
+		return _next_similar(&self.nearest)
+
+cdef class LCSIterator:
+	# yields the keys that share a substring of at least min_length with
+	# search, with the substring.
+	cdef LCS lcs
+	cdef LCS64 lcs64
+	cdef LoudsLCS louds_lcs
+	cdef InterleavedLCS interleaved_lcs
+	cdef Set _owner
+	cdef bytes _search
+
+	def __init__(self, Set owner, unicode search, int min_length):
+		self._owner = owner  # keeps units alive
+		self._search = search.encode('utf8')
+
+		if owner._succinct:
+			_start_lcs(&self.louds_lcs, owner, self._search, min_length)
+		elif owner._interleaved:
+			_start_lcs(&self.interleaved_lcs, owner, self._search, min_length)
+		elif owner._wide:
+			_start_lcs(&self.lcs64, owner, self._search, min_length)
+		else:
+			_start_lcs(&self.lcs, owner, self._search, min_length)
+
+	def __iter__(self):
+		return self
+
+	def __next__(self):
+		if self._owner._succinct:
+			return _next_lcs(&self.louds_lcs)
+		if self._owner._interleaved:
+			return _next_lcs(&self.interleaved_lcs)
+		if self._owner._wide:
+			return _next_lcs(&self.lcs64)
+		return _next_lcs(&self.lcs)
+
+
+ctypedef fused LhsUnits:
+	Dictionary
+	Dictionary64
+	Louds
+	InterleavedDictionary
+
+ctypedef fused RhsUnits:
+	Dictionary
+	Dictionary64
+	Louds
+	InterleavedDictionary
+
+cdef bint _apply_to(Operation operation, LhsUnits *lhs, const Guide *lhs_guide, Set other,
+	const Guide *rhs_guide, Dawg *dawg, SizeType *num_of_keys,
+	vector[ValueType] *lhs_values, vector[ValueType] *rhs_values):
+	# applies an operation to lhs and the units of other, whatever kind they are.
+	if other._succinct:
+		return _apply_units(operation, lhs, lhs_guide, &other.louds, rhs_guide,
+			dawg, num_of_keys, lhs_values, rhs_values)
+	elif other._interleaved:
+		return _apply_units(operation, lhs, lhs_guide, &other.idct, rhs_guide,
+			dawg, num_of_keys, lhs_values, rhs_values)
+	elif other._wide:
+		return _apply_units(operation, lhs, lhs_guide, &other.dct64, rhs_guide,
+			dawg, num_of_keys, lhs_values, rhs_values)
+	else:
+		return _apply_units(operation, lhs, lhs_guide, &other.dct, rhs_guide,
+			dawg, num_of_keys, lhs_values, rhs_values)
+
+cdef bint _apply_units(Operation operation, LhsUnits *lhs, const Guide *lhs_guide,
+	RhsUnits *rhs, const Guide *rhs_guide, Dawg *dawg, SizeType *num_of_keys,
+	vector[ValueType] *lhs_values, vector[ValueType] *rhs_values):
+	# a louds or an interleaved dictionary is its own guide.
+	cdef bint ok
+	with nogil:
+		if (LhsUnits is Louds or LhsUnits is InterleavedDictionary) and \
+				(RhsUnits is Louds or RhsUnits is InterleavedDictionary):
+			ok = SetOperations.Apply(operation, lhs[0], lhs, rhs[0], rhs,
+				dawg, num_of_keys, lhs_values, rhs_values)
+		elif LhsUnits is Louds or LhsUnits is InterleavedDictionary:
+			ok = SetOperations.Apply(operation, lhs[0], lhs, rhs[0], rhs_guide,
+				dawg, num_of_keys, lhs_values, rhs_values)
+		elif RhsUnits is Louds or RhsUnits is InterleavedDictionary:
+			ok = SetOperations.Apply(operation, lhs[0], lhs_guide, rhs[0], rhs,
+				dawg, num_of_keys, lhs_values, rhs_values)
+		else:
+			ok = SetOperations.Apply(operation, lhs[0], lhs_guide, rhs[0], rhs_guide,
+				dawg, num_of_keys, lhs_values, rhs_values)
+	return ok
+
+
 cdef class Set:
-	cdef int _size
+	cdef Py_ssize_t _size
+	# units are kept in dct, in dct64 if _wide is set, or with no guide in
+	# louds if _succinct is set or in idct if _interleaved is set.
 	cdef Dictionary dct
+	cdef Dictionary64 dct64
+	cdef Louds louds
+	cdef InterleavedDictionary idct
+	cdef bint _wide
+	cdef bint _succinct
+	cdef bint _interleaved
+	# units at the top of the trie placed breadth first, or 0.
+	cdef SizeType _hot_size
 	cdef Dawg dawg
 	cdef Guide guide
 	cdef bint _completions
 	cdef Completer completer
+	# numbers of keys below units, in ranks64 if _wide is set.
+	cdef RankIndex ranks
+	cdef RankIndex64 ranks64
+	cdef bint _ranks
 
 	cdef int _fd
 	cdef void *_mmap_addr
 	cdef size_t _mmap_size
-
-	def __init__(self, iterable=None, sorted=False, completions=True):
-		self._completions = completions
-		self._build_from_iterable(iterable, sorted)
+	cdef bint _locked
+	cdef object _buffer
+	cdef object _path
+	cdef readonly object _identity
+	cdef object _options
+	cdef long _num_of_unused_units
+	cdef object _build_stats
+
+	def __cinit__(self):
 		self._fd = -1
+		self._num_of_unused_units = -1
+
+	def __init__(self, iterable=None, sorted=False, completions=True, threads=1, progress=None,
+		wide=False, succinct=False, locality=False, interleaved=False, ranks=False):
+		# threads: number of threads used for building, None for all cores.
+		# progress: a callable that gets BuildStats while building and
+		# returns False to cancel, or True for a tqdm progress bar.
+		# wide: use 64-bit units, which take twice the memory but are
+		# needed for sets beyond about 2^29 units.
+		# succinct: store keys in a LOUDS trie, which takes a fraction of
+		# the memory but is several times slower to search.
+		# locality: lay units out so that similarity searches miss the
+		# cache less often, for a few percent more units.
+		# interleaved: store guide labels in the units, which take a third
+		# more memory but read one cache line per node when walking the
+		# trie. implies completions; ignored with wide or succinct.
+		# ranks: count keys below each unit for rank() and key_at(), which
+		# takes 4 bytes per unit (8 with wide). implies completions.
+		self._completions = completions or succinct or interleaved or ranks
+		self._ranks = ranks
+		self._wide = wide and not succinct
+		self._succinct = succinct
+		self._interleaved = interleaved and not wide and not succinct
+		self._hot_size = _HOT_SIZE if locality else 0
+		self._build_from_iterable(iterable, sorted, threads, progress)
 
 	def __dealloc__(self):
-		self.dct.Clear()
+		self._clear_units()
 		self.dawg.Clear()
-		self.guide.Clear()
-
-	def _build_dawg(self, iterable, sorted):
-		if iterable is None:
-			elements = []
-		elif not sorted:
-			elements = [(<unicode>key).encode('utf8')
-				if isinstance(key, unicode) else key for key in iterable]
-			elements.sort()
-		else:
-			elements = iterable
 
-		cdef DawgBuilder dawg_builder
-		cdef bytes b_key
-		cdef bytes b_last_key = None
-		cdef bint check_order = False
-		cdef int n = 0
-
-		for key in elements:
-			if isinstance(key, unicode):
-				b_key = <bytes>(<unicode>key).encode('utf8')
-			else:
-				b_key = key
+		if self._fd >= 0:
+			munmap(self._mmap_addr, self._mmap_size)
+			posix.unistd.close(self._fd)
 
-			if check_order and b_key < b_last_key:
-				raise ValueError("input is not sorted at key %s" % key)
-			if b_key == b_last_key:
-				continue  # ignore duplicate keys
+	def _build_dawg(self, iterable, sorted, threads, _BuildMonitor monitor):
+		# keys are copied into one arena, then sorted and deduplicated in C++.
+		cdef KeyArena arena
+		cdef SizeType num_of_threads = _num_of_threads(threads)
+		cdef bint check_order = sorted
+		cdef SizeType index = 0
+		cdef bint ok
 
-			if not dawg_builder.Insert(b_key, len(b_key), 0):
-				raise ValueError("error on inserting key %s" % key)
+		monitor.phase("reading")
+		if iterable is not None:
+			for key in iterable:
+				_insert_key(&arena, key, ValueError)
+				monitor.monitor.add_keys(1)
+				if monitor.monitor.is_cancelled():
+					monitor.check()
+		arena.Finish()
+
+		monitor.phase("sorting")
+		with nogil:
+			if not check_order:
+				arena.Sort(num_of_threads)
+			ok = arena.Unique(&index)
+		if not ok:
+			raise ValueError("input is not sorted at key %s" %
+				_arena_key(&arena, index).decode("utf8", "replace"))
+
+		self._build_dawg_from_keys(arena.keys(), arena.lengths(), NULL, arena.num_of_keys(),
+			threads, monitor)
+		self._size = arena.num_of_keys()
+
+	cdef _build_dawg_from_keys(self, const CharType * const *keys, const SizeType *lengths,
+		const ValueType *values, SizeType num_of_keys, threads, _BuildMonitor monitor):
+
+		cdef SizeType num_of_threads = _num_of_threads(threads)
+		cdef bint ok
 
-			n += 1
-			b_last_key = b_key
-			check_order = sorted
+		monitor.phase("dawg")
+		with nogil:
+			ok = ParallelDawgBuilder.Build(
+				keys, lengths, values, num_of_keys, num_of_threads, &self.dawg,
+				&monitor.monitor)
 
-		if not dawg_builder.Finish(&self.dawg):
+		if not ok:
+			monitor.check()
 			raise RuntimeError("internal error in dawg building")
+		monitor.stats.states = self.dawg.num_of_states()
+		monitor.stats.merging_states = self.dawg.num_of_merging_states()
 
-		self._size = n
-
-	def _build_from_iterable(self, iterable, sorted):
-		self._build_dawg(iterable, sorted)
+	def _build_from_iterable(self, iterable, sorted, threads=1, progress=None):
+		cdef _BuildMonitor monitor = _BuildMonitor(progress)
+		try:
+			self._build_dawg(iterable, sorted, threads, monitor)
+			self._build_dictionary(threads, monitor)
+		finally:
+			monitor.stop()
+		self._build_stats = monitor.finish(self._num_of_units(), self._num_of_unused_units)
+
+	cdef _build_dictionary(self, threads=1, _BuildMonitor monitor=None):
+		cdef SizeType num_of_threads = _num_of_threads(threads)
+		cdef BaseType num_of_unused_units = 0
+		cdef uint64_t num_of_unused_units64 = 0
+		# the completion guide is built in the same walk as the dictionary.
+		cdef Guide *guide = &self.guide if self._completions else NULL
+		cdef BuildMonitor *c_monitor = NULL
+		cdef bint ok
 
-		if not DictionaryBuilder.Build(self.dawg, &self.dct):
+		if monitor is not None:
+			monitor.phase("dictionary")
+			c_monitor = &monitor.monitor
+		with nogil:
+			if self._succinct:
+				ok = LoudsBuilder.Build(self.dawg, &self.louds, c_monitor)
+			elif self._wide:
+				ok = ParallelDictionaryBuilder64.Build(
+					self.dawg, num_of_threads, &self.dct64, &num_of_unused_units64, guide, c_monitor,
+					self._hot_size)
+			else:
+				ok = ParallelDictionaryBuilder.Build(
+					self.dawg, num_of_threads, &self.dct, &num_of_unused_units, guide, c_monitor,
+					self._hot_size)
+				num_of_unused_units64 = num_of_unused_units
+				if ok and self._interleaved:
+					# the dictionary and its guide are replaced by their
+					# interleaved units.
+					ok = self.idct.Build(self.dct, self.guide)
+		if self._interleaved:
+			self.dct.Clear()
+			self.guide.Clear()
+		if not ok:
+			if monitor is not None:
+				monitor.check()
+			if not self._wide and not self._succinct:
+				raise RuntimeError("dictionary building failed; very large sets need wide=True")
 			raise RuntimeError("dictionary building failed")
+		self._num_of_unused_units = num_of_unused_units64
 
-		if self._completions:
-			if not GuideBuilder.Build(self.dawg, self.dct, &self.guide):
-				raise RuntimeError("completion guide building failed")
-
+		if self._completions and not self._succinct and not self._interleaved:
 			self.completer.set_dic(self.dct)
 			self.completer.set_guide(self.guide)
+		if self._ranks:
+			self._build_ranks()
+
+	cdef _build_ranks(self):
+		cdef bint ok
+		with nogil:
+			if self._succinct:
+				ok = RankIndexBuilder.Build(self.louds, self.louds, &self.ranks)
+			elif self._interleaved:
+				ok = RankIndexBuilder.Build(self.idct, self.idct, &self.ranks)
+			elif self._wide:
+				ok = RankIndexBuilder.Build(self.dct64, self.guide, &self.ranks64)
+			else:
+				ok = RankIndexBuilder.Build(self.dct, self.guide, &self.ranks)
+		if not ok:
+			raise RuntimeError("rank building failed; sets beyond 2^32 keys need wide=True")
+
+	@staticmethod
+	def from_file(path, sorted=False, delimiter="\n", completions=True, threads=1, progress=None,
+		wide=False, succinct=False, locality=False, interleaved=False, ranks=False):
+		# builds a set from a text file with one key per delimiter (a single
+		# byte; for "\n", "\r\n" is accepted as well). the file is mapped,
+		# split and sorted in C++ without creating python objects and
+		# without holding the GIL. empty keys are skipped.
+		cdef bytes b_path = os.fsencode(path)
+		cdef bytes b_delimiter = delimiter.encode("utf8") if isinstance(delimiter, unicode) else delimiter
+		cdef const char *c_path = b_path
+		cdef CharType c_delimiter
+		cdef KeyFile key_file
+		cdef bint check_order = sorted
+		cdef SizeType num_of_threads = _num_of_threads(threads)
+		cdef SizeType index = 0
+		cdef bint valid, ok
+		cdef Set s = Set.__new__(Set)
+
+		cdef _BuildMonitor monitor
+
+		if len(b_delimiter) != 1:
+			raise ValueError("delimiter must be a single byte")
+		c_delimiter = b_delimiter[0]
+		s._completions = completions or succinct or interleaved or ranks
+		s._ranks = ranks
+		s._wide = wide and not succinct
+		s._succinct = succinct
+		s._interleaved = interleaved and not wide and not succinct
+		s._hot_size = _HOT_SIZE if locality else 0
+
+		monitor = _BuildMonitor(progress)
+		try:
+			monitor.phase("reading")
+			with nogil:
+				ok = key_file.Open(c_path, c_delimiter)
+				valid = ok and key_file.Validate(&index)
+			if not ok:
+				raise IOError("failed to open %s" % path)
+			monitor.monitor.add_keys(key_file.num_of_keys())
+
+			monitor.phase("sorting")
+			ok = valid
+			with nogil:
+				if valid:
+					if check_order:
+						ok = key_file.Unique(&index)
+					else:
+						key_file.Sort(num_of_threads)
+			if not ok:
+				key = key_file.keys()[index][:key_file.lengths()[index]].decode("utf8", "replace")
+				if not valid:
+					raise ValueError("error on inserting key %s" % key)
+				raise ValueError("input is not sorted at key %s" % key)
+
+			s._build_dawg_from_keys(key_file.keys(), key_file.lengths(),
+				NULL, key_file.num_of_keys(), threads, monitor)
+			s._size = key_file.num_of_keys()
+			key_file.Clear()
+
+			s._build_dictionary(threads, monitor)
+		finally:
+			monitor.stop()
+		s._build_stats = monitor.finish(s._num_of_units(), s._num_of_unused_units)
+		return s
 
 	cpdef bytes tobytes(self):
 		cdef bytes res
@@ -257,44 +1061,257 @@ cdef class Set:
 		return res
 
 	cpdef frombytes(self, bytes data):
-		stream = io.BytesIO(data)
+		return self.frombuffer(data)
+
+	cpdef frombuffer(self, data):
+		# maps this object onto the memory of an object supporting the
+		# buffer protocol (bytes, memoryview, shared memory, numpy arrays)
+		# without copying it. the buffer must not be modified afterwards.
+		cdef const uint8_t[::1] view
+		cdef FileHeader header
+		cdef size_t unit_size = sizeof(DictionaryUnit)
+		cdef bint swapped = False
+
+		self.close()
+		buffer = memoryview(data).cast("B")
+		if len(buffer) == 0:
+			raise IOError("read failed")
+		view = buffer
+
+		if _has_magic(buffer[:sizeof(FileHeader)]):
+			memcpy(&header, &view[0], sizeof(FileHeader))
+			swapped = FileFormat.IsSwapped(header)
+			if header.flags & (WIDE_UNITS_FLAG | SUCCINCT_FLAG):
+				unit_size = sizeof(uint64_t)
+
+		if swapped or <size_t>(&view[0]) % unit_size != 0:
+			# units cannot be used in place.
+			stream = io.BytesIO(buffer)
+			try:
+				return self.read(stream)
+			finally:
+				stream.close()
+
+		self._buffer = buffer
 		try:
-			self.read(stream)
-		finally:
-			stream.close()
+			self._map(&view[0], len(view))
+		except:
+			self.close()
+			raise
 		return self
 
-	def dump(self, f):
-		f.write(self._size.to_bytes(8, byteorder='big'))
-		res = self.dct.Write(&write_to_stream, <void*>f)
-		if res and self._completions:
-			self.guide.Write(&write_to_stream, <void*>f)
-		if not res:
-			raise IOError("write failed")
+	def _metadata(self):
+		return {"type": self.__class__.__name__}
+
+	def _dump_values(self):
+		return None
+
+	def _load_values(self, data):
+		pass
+
+	cdef list _layout(self, uint64_t alignment):
+		# lists the sections of this object as (type, count, size, payload).
+		cdef list sections = []
+
+		if self._succinct:
+			sections.append((LOUDS_SECTION, self._num_of_units(), self._units_size(), None))
+		elif self._interleaved:
+			sections.append((INTERLEAVED_SECTION, self._num_of_units(), self._units_size(), None))
+		else:
+			sections.append((DICTIONARY_SECTION, self._num_of_units(), self._units_size(), None))
+		if self._completions and not self._succinct and not self._interleaved:
+			sections.append((GUIDE_SECTION, self.guide.size(), self.guide.total_size(), None))
+		if self._ranks and self._wide:
+			sections.append((RANKS_SECTION, self.ranks64.size(), self.ranks64.total_size(), None))
+		elif self._ranks:
+			sections.append((RANKS_SECTION, self.ranks.size(), self.ranks.total_size(), None))
+
+		metadata = msgpack.packb(self._metadata(), use_bin_type=True)
+		sections.append((METADATA_SECTION, 0, len(metadata), metadata))
+
+		values = self._dump_values()
+		if values is not None:
+			sections.append((VALUES_SECTION, 0, len(values), values))
+
+		return sections
+
+	def dump(self, f, alignment=DEFAULT_ALIGNMENT):
+		cdef FileHeader header
+		cdef FileSection section
+		cdef bytes table = b""
+		cdef uint64_t pos
+		cdef bint res = True
+
+		if alignment < 8 or (alignment & (alignment - 1)) != 0:
+			raise ValueError("alignment must be a power of 2 and at least 8")
+
+		sections = self._layout(alignment)
+
+		FileFormat.InitHeader(&header)
+		if self._wide:
+			FileFormat.SetFlag(&header, WIDE_UNITS_FLAG)
+		if self._succinct:
+			FileFormat.SetFlag(&header, SUCCINCT_FLAG)
+		if self._interleaved:
+			FileFormat.SetFlag(&header, INTERLEAVED_FLAG)
+		header.alignment = alignment
+		header.num_of_sections = len(sections)
+		header.num_of_keys = self._size
+
+		pos = FileFormat.Align(sizeof(FileHeader) + len(sections) * sizeof(FileSection), alignment)
+		offsets = []
+		for section_type, count, size, payload in sections:
+			section.type = section_type
+			section.flags = 0
+			section.offset = pos
+			section.size = size
+			section.count = count
+			table += (<char*>&section)[:sizeof(FileSection)]
+			offsets.append(pos)
+			pos = FileFormat.Align(pos + size, alignment)
+
+		f.write((<char*>&header)[:sizeof(FileHeader)])
+		f.write(table)
+		pos = sizeof(FileHeader) + len(table)
+
+		for (section_type, count, size, payload), offset in zip(sections, offsets):
+			f.write(b"\0" * (offset - pos))
+			if section_type == DICTIONARY_SECTION and self._wide:
+				res = self.dct64.WriteUnits(&write_to_stream, <void*>f)
+			elif section_type == DICTIONARY_SECTION:
+				res = self.dct.WriteUnits(&write_to_stream, <void*>f)
+			elif section_type == GUIDE_SECTION:
+				res = self.guide.WriteUnits(&write_to_stream, <void*>f)
+			elif section_type == LOUDS_SECTION:
+				res = self.louds.WriteUnits(&write_to_stream, <void*>f)
+			elif section_type == INTERLEAVED_SECTION:
+				res = self.idct.WriteUnits(&write_to_stream, <void*>f)
+			elif section_type == RANKS_SECTION and self._wide:
+				res = self.ranks64.WriteUnits(&write_to_stream, <void*>f)
+			elif section_type == RANKS_SECTION:
+				res = self.ranks.WriteUnits(&write_to_stream, <void*>f)
+			else:
+				f.write(payload)
+			if not res:
+				raise IOError("write failed")
+			pos = offset + size
+
 		return self
 
 	def read(self, f):
+		cdef FileHeader header
+		cdef bint swapped
+		cdef uint64_t pos
+		cdef bint res = True
+
+		data = f.read(sizeof(FileHeader))
+		if not _has_magic(data):
+			return self._read_legacy(io.BytesIO(data + f.read()))
+
+		swapped = _parse_header(data, &header)
+		table = f.read(header.section_table_offset - sizeof(FileHeader) +
+			header.num_of_sections * sizeof(FileSection))
+		sections = _parse_sections(table, header.section_table_offset, &header, swapped)
+		pos = header.section_table_offset + header.num_of_sections * sizeof(FileSection)
+
+		self._clear_units()
+		self._wide = (header.flags & WIDE_UNITS_FLAG) != 0
+		self._succinct = (header.flags & SUCCINCT_FLAG) != 0
+		self._interleaved = (header.flags & INTERLEAVED_FLAG) != 0
+		self._completions = self._succinct or self._interleaved
+		self._ranks = False
+
+		try:
+			for section_type, offset, size, count in sections:
+				if offset < pos:
+					raise IOError("overlapping sections")
+				if len(f.read(offset - pos)) != offset - pos:
+					raise IOError("unexpected end of file")
+
+				if section_type == DICTIONARY_SECTION and self._wide:
+					res = size == count * sizeof(DictionaryUnit64) and \
+						self.dct64.ReadUnits(&read_from_stream, <void*>f, count, swapped)
+				elif section_type == DICTIONARY_SECTION:
+					res = size == count * sizeof(DictionaryUnit) and \
+						self.dct.ReadUnits(&read_from_stream, <void*>f, count, swapped)
+				elif section_type == GUIDE_SECTION:
+					res = size == count * sizeof(GuideUnit) and \
+						self.guide.ReadUnits(&read_from_stream, <void*>f, count)
+					self._completions = True
+				elif section_type == LOUDS_SECTION:
+					res = size == count * sizeof(uint64_t) and \
+						self.louds.ReadUnits(&read_from_stream, <void*>f, count, swapped)
+				elif section_type == INTERLEAVED_SECTION:
+					res = size == count * sizeof(InterleavedDictionaryUnit) and \
+						self.idct.ReadUnits(&read_from_stream, <void*>f, count, swapped)
+				elif section_type == RANKS_SECTION and self._wide:
+					res = size == count * sizeof(uint64_t) and \
+						self.ranks64.ReadUnits(&read_from_stream, <void*>f, count, swapped)
+					self._ranks = True
+				elif section_type == RANKS_SECTION:
+					res = size == count * sizeof(uint32_t) and \
+						self.ranks.ReadUnits(&read_from_stream, <void*>f, count, swapped)
+					self._ranks = True
+				else:
+					data = f.read(size)
+					res = len(data) == size
+					if res and section_type == VALUES_SECTION:
+						self._load_values(data)
+					# unknown sections are skipped.
+
+				if not res:
+					raise IOError("read failed")
+				pos = offset + size
+		except:
+			self._clear_units()
+			raise
+
+		self._size = header.num_of_keys
+		self._num_of_unused_units = -1
+		self._build_stats = None
+		return self
+
+	def _read_legacy(self, f):
+		# reads files written before the introduction of the file header.
 		self._size = int.from_bytes(f.read(8), 'big')
+		self._num_of_unused_units = -1
+		self._build_stats = None
+		self._clear_units()
+		self._wide = False
+		self._succinct = False
+		self._interleaved = False
+		self._ranks = False
 		res = self.dct.Read(&read_from_stream, <void*>f)
 		if res and self._completions:
 			res = self.guide.Read(&read_from_stream, <void*>f)
 		if not res:
-			self.dct.Clear()
-			self.guide.Clear()
+			self._clear_units()
 			raise IOError("read failed")
+		data = f.read()
+		if data:
+			self._load_values(data)
 		return self
 
 	@staticmethod
 	def load(f):
-		if isinstance(f, bytes):
-			return Set().frombytes(f)
-		else:
+		if hasattr(f, "read"):
 			return Set().read(f)
-
-	def _open(self, unicode path):
+		else:
+			return Set().frombuffer(f)
+
+	def _open(self, unicode path, populate=False, advice=None, lock=False, huge_pages=False):
+		# populate: fault in all pages before returning.
+		# advice: expected access pattern, one of "normal", "random",
+		#   "sequential" or "willneed" (start reading ahead in the background).
+		# lock: keep all pages resident (subject to RLIMIT_MEMLOCK).
+		# huge_pages: ask for transparent huge pages where the kernel
+		#   supports them for file mappings.
 		if self._fd >= 0:
 			self.close()
 
+		if advice is not None and advice not in _ADVICE:
+			raise ValueError("illegal advice %s" % advice)
+
 		cdef size_t size = os.path.getsize(path)
 
 		cdef int fd = posix.fcntl.open(
@@ -302,40 +1319,236 @@ cdef class Set:
 		if fd < 0:
 			raise IOError("failed to open " + path)
 
-		cdef void *buf = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0)
+		cdef int flags = MAP_SHARED
+		if populate:
+			flags |= SIMTRIE_MAP_POPULATE
+
+		cdef void *buf = mmap(NULL, size, PROT_READ, flags, fd, 0)
 		if buf == MAP_FAILED:
-			posix.unistd.close(self._fd)
+			posix.unistd.close(fd)
 			raise IOError("failed to mmap file " + path)
 
 		self._fd = fd
 		self._mmap_addr = buf
 		self._mmap_size = size
+		self._locked = False
 
-		cdef bytes b_size = (<const uint8_t*>(buf))[0:8]
-		self._size = int.from_bytes(b_size, 'big')
+		try:
+			if huge_pages and SIMTRIE_MADV_HUGEPAGE >= 0:
+				# advisory only, file systems may not support huge pages.
+				madvise(buf, size, SIMTRIE_MADV_HUGEPAGE)
+			if advice is not None:
+				posix_madvise(buf, size, _ADVICE[advice])
+			if populate and SIMTRIE_MAP_POPULATE == 0:
+				with nogil:
+					simtrie_touch_pages(buf, size)
+			if lock:
+				if mlock(buf, size) != 0:
+					raise OSError(errno, "failed to lock pages of " + path)
+				self._locked = True
+
+			self._map(<const uint8_t*>buf, size)
+		except:
+			self.close()
+			raise
 
-		cdef const void *buf1 = self.dct.Map(<const uint8_t*>(buf) + 8)
-		if self._completions:
-			self.guide.Map(buf1)
+		self._path = path
+		self._identity = _file_identity(os.fstat(fd))
+		self._options = dict(
+			populate=populate, advice=advice, lock=lock, huge_pages=huge_pages)
 
 		return self
 
+	def residency(self):
+		# reports how many bytes of this object's memory are mapped from a
+		# file and how many of them are currently resident in memory.
+		cdef long resident
+
+		if self._fd < 0:
+			size = self._units_size() + self.guide.total_size()
+			return {"mapped": 0, "resident": size, "locked": False}
+
+		resident = simtrie_resident_bytes(self._mmap_addr, self._mmap_size)
+		if resident < 0:
+			raise OSError(errno, "mincore failed")
+		return {"mapped": self._mmap_size, "resident": resident, "locked": self._locked}
+
+	@property
+	def wide(self):
+		# whether units are 64-bit.
+		return self._wide
+
+	@property
+	def succinct(self):
+		# whether keys are stored in a LOUDS trie.
+		return self._succinct
+
+	@property
+	def interleaved(self):
+		# whether units carry the labels of their guide.
+		return self._interleaved
+
+	@property
+	def ranks(self):
+		# whether rank() and key_at() are available.
+		return self._ranks
+
+	def _build_options(self):
+		# options that build a set laid out like this one. locality is not
+		# saved in files, so loaded sets report it as off.
+		return dict(completions=self._completions, wide=self._wide, succinct=self._succinct,
+			interleaved=self._interleaved, ranks=self._ranks, locality=self._hot_size != 0)
+
+	@property
+	def build_stats(self):
+		# BuildStats of the build that made this object, with the time and
+		# memory each phase took. None for loaded objects and for results of
+		# set operations.
+		return self._build_stats
+
+	def occupancy(self):
+		# reports the number of units in the double array and how many of
+		# them are unused gaps between placed nodes. the gaps are only known
+		# for objects built in this process, not for loaded ones. units of
+		# succinct objects are the 64-bit words of their trie.
+		cdef size_t size = self._num_of_units()
+
+		if self._num_of_unused_units < 0:
+			return {"units": size, "unused": None, "fill_ratio": None}
+		fill_ratio = 1.0 - self._num_of_unused_units / size if size > 0 else 1.0
+		return {"units": size, "unused": self._num_of_unused_units, "fill_ratio": fill_ratio}
+
+	cdef _map(self, const uint8_t *buf, size_t size):
+		cdef FileHeader header
+		cdef const void *buf1
+		cdef uint64_t offset, section_size, count
+
+		if not _has_magic(buf[0:min(size, sizeof(FileHeader))]):
+			self._map_legacy(buf, size)
+			return
+
+		if _parse_header(buf[0:sizeof(FileHeader)], &header):
+			raise IOError("file was written on a machine with a different "
+				"byte order and cannot be mapped; use load() instead")
+
+		table_end = header.section_table_offset + \
+			header.num_of_sections * sizeof(FileSection)
+		if table_end > size:
+			raise IOError("truncated file")
+
+		sections = _parse_sections(
+			buf[sizeof(FileHeader):table_end], header.section_table_offset, &header, False)
+
+		self._wide = (header.flags & WIDE_UNITS_FLAG) != 0
+		self._succinct = (header.flags & SUCCINCT_FLAG) != 0
+		self._interleaved = (header.flags & INTERLEAVED_FLAG) != 0
+		self._completions = self._succinct or self._interleaved
+		self._ranks = False
+		unit_size = sizeof(DictionaryUnit64) if self._wide else sizeof(DictionaryUnit)
+		for section_type, offset, section_size, count in sections:
+			if offset + section_size > size:
+				raise IOError("truncated file")
+
+			if section_type == DICTIONARY_SECTION:
+				if section_size != count * unit_size or offset % unit_size != 0:
+					raise IOError("illegal dictionary section")
+				if self._wide:
+					self.dct64.Map(buf + offset, count)
+				else:
+					self.dct.Map(buf + offset, count)
+			elif section_type == GUIDE_SECTION:
+				if section_size != count * sizeof(GuideUnit):
+					raise IOError("illegal guide section")
+				self.guide.Map(buf + offset, count)
+				self._completions = True
+			elif section_type == LOUDS_SECTION:
+				if section_size != count * sizeof(uint64_t) or offset % sizeof(uint64_t) != 0 or \
+						not self.louds.Map(buf + offset, count):
+					raise IOError("illegal louds section")
+			elif section_type == INTERLEAVED_SECTION:
+				if section_size != count * sizeof(InterleavedDictionaryUnit) or \
+						offset % sizeof(DictionaryUnit) != 0:
+					raise IOError("illegal interleaved section")
+				self.idct.Map(buf + offset, count)
+			elif section_type == RANKS_SECTION:
+				rank_size = sizeof(uint64_t) if self._wide else sizeof(uint32_t)
+				if section_size != count * rank_size or offset % rank_size != 0:
+					raise IOError("illegal ranks section")
+				if self._wide:
+					self.ranks64.Map(buf + offset, count)
+				else:
+					self.ranks.Map(buf + offset, count)
+				self._ranks = True
+			elif section_type == VALUES_SECTION:
+				self._load_values(buf[offset:offset + section_size])
+
+		self._size = header.num_of_keys
+		self._num_of_unused_units = -1
+		self._build_stats = None
+
+	cdef _map_legacy(self, const uint8_t *buf, size_t size):
+		# legacy files start with the number of keys, followed by dictionary
+		# and guide with their numbers of units.
+		cdef size_t pos = 8
+		cdef size_t count
+
+		if size < pos + sizeof(BaseType):
+			raise IOError("read failed")
+		self._size = int.from_bytes(buf[0:8], 'big')
+		self._num_of_unused_units = -1
+		self._build_stats = None
+		self._wide = False
+		self._succinct = False
+		self._interleaved = False
+		self._ranks = False
+
+		count = (<const BaseType*>(buf + pos))[0]
+		pos += sizeof(BaseType)
+		if size < pos + count * sizeof(DictionaryUnit):
+			raise IOError("read failed")
+		self.dct.Map(buf + pos, count)
+		pos += count * sizeof(DictionaryUnit)
+
+		if self._completions:
+			if size < pos + sizeof(BaseType):
+				raise IOError("read failed")
+			count = (<const BaseType*>(buf + pos))[0]
+			pos += sizeof(BaseType)
+			if size < pos + count * sizeof(GuideUnit):
+				raise IOError("read failed")
+			self.guide.Map(buf + pos, count)
+			pos += count * sizeof(GuideUnit)
+
+		if pos < size:
+			self._load_values(buf[pos:size])
+
 	def close(self):
-		self.dct.Clear()
-		self.guide.Clear()
+		self._clear_units()
+		self._num_of_unused_units = -1
+		self._build_stats = None
+		self._buffer = None
+		self._path = None
 
 		if self._fd >= 0:
+			if self._locked:
+				munlock(self._mmap_addr, self._mmap_size)
+				self._locked = False
 			munmap(self._mmap_addr, self._mmap_size)
 			posix.unistd.close(self._fd)
 			self._fd = -1
 
 		return self
 
-	def file_size(self):
-		return 8 + self.dct.file_size() + self.guide.file_size()
+	def file_size(self, alignment=DEFAULT_ALIGNMENT):
+		cdef uint64_t pos
+		sections = self._layout(alignment)
+		pos = sizeof(FileHeader) + len(sections) * sizeof(FileSection)
+		for section_type, count, size, payload in sections:
+			pos = FileFormat.Align(pos, alignment) + size
+		return pos
 
 	def prefixes(self, key):
-		cdef BaseType index = self.dct.root()
+		cdef uint64_t index = 0  # the root
 		cdef bytes b_key
 		cdef bint use_bytes
 		cdef int pos = 1
@@ -349,61 +1562,98 @@ cdef class Set:
 			use_bytes = False
 
 		for ch in b_key:
-			if not self.dct.Follow(ch, &index):
+			if not self._follow(&ch, 1, &index):
 				return
-			if self.dct.has_value(index):
+			if self._has_value(index):
 				if use_bytes:
 					yield b_key[:pos]
 				else:
 					yield b_key[:pos].decode('utf8')
 			pos += 1
 
-	def keys(self, unicode prefix=""):
+	def keys(self, unicode prefix="", unicode start=None, unicode stop=None, limit=None):
+		# keys from start up to stop, and at most limit of them. the cursor
+		# of the result tells where the next page starts.
 		if not self._completions:
 			raise RuntimeError("iterations are not enabled")
-		try:
-			return KeyIterator(self, prefix)
-		except StopIteration:
-			return []
+		return KeyIterator(self, prefix, start, stop, limit)
+
+	def _similar(self, unicode search, int max_cost, Metric metric, dict kwargs):
+		# yields keys with their values and costs.
+		return SimilarIterator(self, search, max_cost, metric, kwargs)
+
+	def similar(self, search, max_cost=1, metric=None, **kwargs):
+		for key, value, cost in self._similar(search, max_cost, metric, kwargs):
+			yield key, cost
+
+	def lcs(self, unicode search, int min_length=3):
+		return LCSIterator(self, search, min_length)
+
+	cdef _apply(self, Set other, Operation operation, Set result,
+		vector[ValueType] *lhs_values, vector[ValueType] *rhs_values):
+		# builds result from the keys of self and other, walking both in
+		# lockstep without creating python objects.
+		cdef const Guide *lhs_guide = &self.guide if self._completions else NULL
+		cdef const Guide *rhs_guide = &other.guide if other._completions else NULL
+		cdef SizeType num_of_keys = 0
+		cdef bint ok
 
-	cdef _init_nearest(self, Similar[float] *nearest, unicode search, int max_cost, Metric metric, dict kwargs):
-		nearest.set_dic(self.dct)
-		nearest.set_guide(self.guide)
+		if self._succinct:
+			ok = _apply_to(operation, &self.louds, lhs_guide, other, rhs_guide,
+				&result.dawg, &num_of_keys, lhs_values, rhs_values)
+		elif self._interleaved:
+			ok = _apply_to(operation, &self.idct, lhs_guide, other, rhs_guide,
+				&result.dawg, &num_of_keys, lhs_values, rhs_values)
+		elif self._wide:
+			ok = _apply_to(operation, &self.dct64, lhs_guide, other, rhs_guide,
+				&result.dawg, &num_of_keys, lhs_values, rhs_values)
+		else:
+			ok = _apply_to(operation, &self.dct, lhs_guide, other, rhs_guide,
+				&result.dawg, &num_of_keys, lhs_values, rhs_values)
+		if not ok:
+			raise RuntimeError("internal error in dawg building")
 
-		if metric:
-			nearest.set_costs(metric.costs)
+		result._succinct = self._succinct or other._succinct
+		result._wide = (self._wide or other._wide) and not result._succinct
+		result._interleaved = (self._interleaved or other._interleaved) and \
+			not result._wide and not result._succinct
+		result._ranks = self._ranks or other._ranks
+		result._completions = self._completions or result._succinct or result._interleaved or \
+			result._ranks
+		result._hot_size = max(self._hot_size, other._hot_size)
+		result._size = num_of_keys
+		result._build_dictionary()
+		result.dawg.Clear()
+		return result
 
-		nearest.set_enable_transpose(kwargs.get("allow_transpose", False))
-		nearest.set_enable_merge(kwargs.get("allow_merge", False))
-		nearest.set_enable_split(kwargs.get("allow_split", False))
+	def _combine(self, other, Operation operation):
+		if not isinstance(other, Set):
+			other = Set(other)
+		return self._apply(other, operation, Set.__new__(Set), NULL, NULL)
 
-		cdef bytes b_search = search.encode('utf8')
-		nearest.start(b_search, len(b_search), max_cost)
+	def union(self, other):
+		return self._combine(other, UNION)
 
-	def similar(self, search, max_cost=1, metric=None, **kwargs):
-		cdef Similar[float] nearest
-		self._init_nearest(&nearest, search, max_cost, metric, kwargs)
-		cdef str key
+	def intersection(self, other):
+		return self._combine(other, INTERSECTION)
 
-		while nearest.next():
-			key = nearest.key()[:nearest.key_length()].decode("utf8")
-			yield key, nearest.cost()
+	def difference(self, other):
+		return self._combine(other, DIFFERENCE)
 
-	def lcs(self, search, min_length=3):
-		cdef LCS lcs
-		cdef str key
+	def symmetric_difference(self, other):
+		return self._combine(other, SYMMETRIC_DIFFERENCE)
 
-		lcs.set_dic(self.dct)
-		lcs.set_guide(self.guide)
+	def __or__(self, other):
+		return self.union(other)
 
-		cdef bytes b_search = search.encode('utf8')
-		lcs.start(b_search, len(b_search), min_length)
+	def __and__(self, other):
+		return self.intersection(other)
 
-		while lcs.next():
-			seq = lcs.lcs()[:lcs.lcs_length()].decode("utf8")
-			key = lcs.key()[:lcs.key_length()].decode("utf8")
-			yield seq, key
+	def __sub__(self, other):
+		return self.difference(other)
 
+	def __xor__(self, other):
+		return self.symmetric_difference(other)
 
 	def __contains__(self, key):
 		cdef bytes b_key
@@ -411,16 +1661,253 @@ cdef class Set:
 			b_key = key
 		else:
 			b_key = <bytes>key.encode('utf8')
-		return self.dct.Contains(b_key, len(b_key))
+		return self._contains(b_key, len(b_key))
+
+	def contains_many(self, keys):
+		# checks many keys at once, and returns a numpy array of bools.
+		# lookups are interleaved, so that they wait for memory together.
+		cdef vector[CharType] data
+		cdef vector[SizeType] offsets
+		cdef SizeType num_of_keys
+		cdef np.npy_intp shape[1]
+		cdef cpp_bool *found
+
+		_pack_keys(keys, &data, &offsets)
+		num_of_keys = offsets.size() - 1
+		shape[0] = <np.npy_intp>num_of_keys
+		result = np.PyArray_SimpleNew(1, shape, np.NPY_BOOL)
+		found = <cpp_bool*>np.PyArray_DATA(<np.ndarray>result)
+
+		with nogil:
+			if self._succinct:
+				BatchLookup.Contains(self.louds, data.data(), offsets.data(), num_of_keys, found)
+			elif self._wide:
+				BatchLookup.Contains(self.dct64, data.data(), offsets.data(), num_of_keys, found)
+			elif self._interleaved:
+				BatchLookup.Contains(self.idct, data.data(), offsets.data(), num_of_keys, found)
+			else:
+				BatchLookup.Contains(self.dct, data.data(), offsets.data(), num_of_keys, found)
+		return result
+
+	def _find_many(self, keys):
+		# finds the values of many keys at once as a numpy array, with -1 for
+		# keys not found.
+		cdef vector[CharType] data
+		cdef vector[SizeType] offsets
+		cdef SizeType num_of_keys
+		cdef np.npy_intp shape[1]
+		cdef int64_t *values
+
+		_pack_keys(keys, &data, &offsets)
+		num_of_keys = offsets.size() - 1
+		shape[0] = <np.npy_intp>num_of_keys
+		result = np.PyArray_SimpleNew(1, shape, np.NPY_INT64)
+		values = <int64_t*>np.PyArray_DATA(<np.ndarray>result)
+
+		with nogil:
+			if self._succinct:
+				BatchLookup.Find(self.louds, data.data(), offsets.data(), num_of_keys, values)
+			elif self._wide:
+				BatchLookup.Find(self.dct64, data.data(), offsets.data(), num_of_keys, values)
+			elif self._interleaved:
+				BatchLookup.Find(self.idct, data.data(), offsets.data(), num_of_keys, values)
+			else:
+				BatchLookup.Find(self.dct, data.data(), offsets.data(), num_of_keys, values)
+		return result
+
+	def rank(self, key):
+		# position of a key in sorted order, found in a single walk down.
+		# needs ranks=True.
+		cdef bytes b_key = key if isinstance(key, bytes) else <bytes>key.encode('utf8')
+		cdef SizeType rank = 0
+		cdef bint found
+
+		self._check_ranks()
+		if self._succinct:
+			found = self.ranks.Rank(self.louds, b_key, len(b_key), &rank)
+		elif self._interleaved:
+			found = self.ranks.Rank(self.idct, b_key, len(b_key), &rank)
+		elif self._wide:
+			found = self.ranks64.Rank(self.dct64, b_key, len(b_key), &rank)
+		else:
+			found = self.ranks.Rank(self.dct, b_key, len(b_key), &rank)
+		if not found:
+			raise KeyError(key)
+		return rank
+
+	def key_at(self, Py_ssize_t rank):
+		# key at a position in sorted order, like list(self)[rank].
+		# needs ranks=True.
+		cdef vector[CharType] key
+		cdef bint found
+
+		self._check_ranks()
+		if rank < 0:
+			rank += self._size
+		if rank < 0 or rank >= self._size:
+			raise IndexError("rank out of range")
+		if self._succinct:
+			found = self.ranks.Select(self.louds, self.louds, rank, &key)
+		elif self._interleaved:
+			found = self.ranks.Select(self.idct, self.idct, rank, &key)
+		elif self._wide:
+			found = self.ranks64.Select(self.dct64, self.guide, rank, &key)
+		else:
+			found = self.ranks.Select(self.dct, self.guide, rank, &key)
+		if not found:
+			raise IndexError("rank out of range")
+		return key.data()[:key.size()].decode("utf8")
+
+	def count(self, prefix=""):
+		# number of keys that start with prefix. with ranks=True, it is
+		# found in a single walk down; otherwise keys are enumerated.
+		cdef bytes b_prefix = prefix if isinstance(prefix, bytes) else <bytes>prefix.encode('utf8')
+		cdef SizeType begin = 0, end = 0
+		cdef Iterator it
+		cdef Py_ssize_t n = 0
+
+		if self._ranks:
+			if not self._prefix_range(b_prefix, len(b_prefix), &begin, &end):
+				return 0
+			return end - begin
+		if not self._completions:
+			raise RuntimeError("iterations are not enabled")
+		it = KeyIterator(self, b_prefix.decode('utf8'))
+		while it._next():
+			n += 1
+		return n
+
+	def count_many(self, prefixes):
+		# counts keys for many prefixes, and returns a numpy array.
+		cdef vector[CharType] data
+		cdef vector[SizeType] offsets
+		cdef SizeType num_of_prefixes, i
+		cdef SizeType begin = 0, end = 0
+		cdef np.npy_intp shape[1]
+		cdef int64_t *counts
+
+		if not self._ranks:
+			return numpy.array([self.count(prefix) for prefix in prefixes], dtype=numpy.int64)
+
+		_pack_keys(prefixes, &data, &offsets)
+		num_of_prefixes = offsets.size() - 1
+		shape[0] = <np.npy_intp>num_of_prefixes
+		result = np.PyArray_SimpleNew(1, shape, np.NPY_INT64)
+		counts = <int64_t*>np.PyArray_DATA(<np.ndarray>result)
+
+		with nogil:
+			for i in range(num_of_prefixes):
+				if self._prefix_range(data.data() + offsets[i], offsets[i + 1] - offsets[i],
+						&begin, &end):
+					counts[i] = end - begin
+				else:
+					counts[i] = 0
+		return result
+
+	def has_keys_with_prefix(self, prefix):
+		# every state of the trie leads to a key, so this only follows the
+		# prefix.
+		cdef bytes b_prefix = prefix if isinstance(prefix, bytes) else <bytes>prefix.encode('utf8')
+		cdef uint64_t index = 0
+
+		if self._size == 0:
+			return False
+		return self._follow(b_prefix, len(b_prefix), &index)
+
+	cdef bint _prefix_range(self, const char *prefix, SizeType length,
+		SizeType *begin, SizeType *end) nogil:
+		# finds the ranks of the keys that start with prefix.
+		if self._succinct:
+			return self.ranks.Range(self.louds, self.louds, self._size,
+				<CharType*>prefix, length, begin, end)
+		if self._interleaved:
+			return self.ranks.Range(self.idct, self.idct, self._size,
+				<CharType*>prefix, length, begin, end)
+		if self._wide:
+			return self.ranks64.Range(self.dct64, self.guide, self._size,
+				<CharType*>prefix, length, begin, end)
+		return self.ranks.Range(self.dct, self.guide, self._size,
+			<CharType*>prefix, length, begin, end)
+
+	cdef _check_ranks(self):
+		if not self._ranks:
+			raise ValueError("ranks are not available; build the set with ranks=True")
 
 	def __len__(self):
 		return self._size
 
+	# lookups in any kind of dictionary. indices are those of dct, dct64,
+	# louds or idct, depending on _wide, _succinct and _interleaved.
+
+	cdef bint _follow(self, const char *key, SizeType length, uint64_t *index) nogil:
+		# follows transitions from index, and updates it on success.
+		cdef BaseType narrow_index
+		if self._succinct:
+			return self.louds.Follow(<CharType*>key, length, index)
+		if self._wide:
+			return self.dct64.Follow(<CharType*>key, length, index)
+		narrow_index = <BaseType>index[0]
+		if self._interleaved:
+			if not self.idct.Follow(<CharType*>key, length, &narrow_index):
+				return False
+		elif not self.dct.Follow(<CharType*>key, length, &narrow_index):
+			return False
+		index[0] = narrow_index
+		return True
+
+	cdef bint _has_value(self, uint64_t index) nogil:
+		if self._succinct:
+			return self.louds.has_value(index)
+		if self._wide:
+			return self.dct64.has_value(index)
+		if self._interleaved:
+			return self.idct.has_value(<BaseType>index)
+		return self.dct.has_value(<BaseType>index)
+
+	cdef bint _contains(self, const char *key, SizeType length) nogil:
+		if self._succinct:
+			return self.louds.Contains(<CharType*>key, length)
+		if self._wide:
+			return self.dct64.Contains(<CharType*>key, length)
+		if self._interleaved:
+			return self.idct.Contains(<CharType*>key, length)
+		return self.dct.Contains(<CharType*>key, length)
+
+	cdef int64_t _find(self, const char *key, SizeType length) nogil:
+		# gets the value of a key, or -1.
+		if self._succinct:
+			return self.louds.Find(<CharType*>key, length)
+		if self._wide:
+			return self.dct64.Find(<CharType*>key, length)
+		if self._interleaved:
+			return self.idct.Find(<CharType*>key, length)
+		return self.dct.Find(<CharType*>key, length)
+
+	cdef SizeType _num_of_units(self) nogil:
+		if self._succinct:
+			return self.louds.size()
+		if self._interleaved:
+			return self.idct.size()
+		return self.dct64.size() if self._wide else self.dct.size()
+
+	cdef SizeType _units_size(self) nogil:
+		if self._succinct:
+			return self.louds.total_size()
+		if self._interleaved:
+			return self.idct.total_size()
+		return self.dct64.total_size() if self._wide else self.dct.total_size()
+
+	cdef _clear_units(self):
+		self.dct.Clear()
+		self.dct64.Clear()
+		self.louds.Clear()
+		self.idct.Clear()
+		self.guide.Clear()
+		self.ranks.Clear()
+		self.ranks64.Clear()
+
 	def __iter__(self):
-		try:
-			return KeyIterator(self, "")
-		except StopIteration:
-			return []
+		return KeyIterator(self, "")
 
 	def __enter__(self):
 		return self
@@ -432,122 +1919,202 @@ cdef class Set:
 	def __reduce__(self):
 		return self.__class__, tuple(), self.tobytes()
 
+	def __reduce_ex__(self, protocol):
+		if self._path is not None:
+			# mapped files are pickled by reference, so that unpickling
+			# maps the same file and shares its pages.
+			return _reopen, (self.__class__, self._path, self._identity, self._options)
+		elif protocol >= 5 and hasattr(pickle, "PickleBuffer"):
+			# allows out-of-band transfer; buffer-backed objects pass on
+			# their buffer without serializing.
+			data = self._buffer if self._buffer is not None else self.tobytes()
+			return _frombuffer, (self.__class__, pickle.PickleBuffer(data))
+		else:
+			return self.__reduce__()
+
 	def __setstate__(self, state):
 		self.frombytes(state)
 
 cdef class Dict(Set):
+	# values of the leaves, which are either one per key in key order or,
+	# with interned values, one per distinct value.
 	cdef object _values
+	cdef object _values_array
+	cdef bint _intern_values
 
-	def __init__(self, *args, completions=False, **kwargs):
+	def __init__(self, *args, completions=False, intern_values=False, **kwargs):
+		# intern_values: store each distinct value once and let keys refer
+		# to it, so that keys with equal suffixes and values share states.
+		# values must be hashable.
 		if len(args) == 1 and isinstance(args[0], dict):
 			args = [args[0].items()]
+		self._intern_values = intern_values
 		super().__init__(*args, **kwargs)
 
 	def  __getitem__(self, key):
 		cdef bytes b_key = <bytes>key.encode('utf8')
-		index = self.dct.Find(b_key, len(b_key))
+		index = self._find(b_key, len(b_key))
 		if index < 0:
 			raise KeyError(key)
 		return self._values[index]
 
-	def keys(self, unicode prefix=""):
+	def get_many(self, keys, default=None):
+		# looks up many keys at once like contains_many, and returns a numpy
+		# array of their values, with default for keys not found.
+		indices = self._find_many(keys)
+		values = self._get_values_array()
+		found = indices >= 0
+		if found.all():
+			return values[indices]
+
 		try:
-			return KeyIterator(self, prefix)
-		except StopIteration:
-			return []
+			dtype = numpy.result_type(values, numpy.asarray(default))
+		except TypeError:
+			dtype = object
+		result = numpy.empty(len(indices), dtype=dtype)
+		result[found] = values[indices[found]]
+		result[~found] = default
+		return result
+
+	def _get_values_array(self):
+		# values as a numpy array. ints or floats get their own dtype,
+		# anything else is kept as objects.
+		if self._values_array is None:
+			values = self._values or ()
+			types = set(map(type, values))
+			if len(types) == 1 and types.pop() in (int, float):
+				self._values_array = numpy.asarray(values)
+			else:
+				self._values_array = numpy.empty(len(values), dtype=object)
+				for i, value in enumerate(values):
+					self._values_array[i] = value
+		return self._values_array
 
-	def values(self, unicode prefix=""):
-		if not prefix:
+	def keys(self, unicode prefix="", unicode start=None, unicode stop=None, limit=None):
+		return KeyIterator(self, prefix, start, stop, limit)
+
+	def values(self, unicode prefix="", unicode start=None, unicode stop=None, limit=None):
+		if (not prefix and start is None and stop is None and limit is None
+				and len(self._values or ()) == self._size):
 			return self._values
-		else:
-			try:
-				return ValueIterator(self, prefix, self._values)
-			except StopIteration:
-				return []
+		return ValueIterator(self, prefix, self._values, start, stop, limit)
 
-	def items(self, unicode prefix=""):
-		try:
-			return KeyValueIterator(self, prefix, self._values)
-		except StopIteration:
-			return []
+	def items(self, unicode prefix="", unicode start=None, unicode stop=None, limit=None):
+		return KeyValueIterator(self, prefix, self._values, start, stop, limit)
 
 	def similar(self, search, max_cost=1, metric=None, **kwargs):
-		cdef Similar[float] nearest
-		self._init_nearest(&nearest, search, max_cost, metric, kwargs)
-		cdef str key
-
-		while nearest.next():
-			key = nearest.key()[:nearest.key_length()].decode("utf8")
-			yield key, self._values[nearest.value()], nearest.cost()
-
-	def dump(self, f):
-		super().dump(f)
-		if isinstance(self._values, np.ndarray):
-			self._values.dump(f)
-		else:
-			f.write(msgpack.packb(self._values, use_bin_type=True))
-		return self
+		for key, value, cost in self._similar(search, max_cost, metric, kwargs):
+			yield key, self._values[value], cost
+
+	def _combine(self, other, Operation operation, merge=None):
+		# merge(value, other_value) gives the value of a key in both dicts.
+		# without it, union and symmetric_difference take values from
+		# other (like dict.update), the others from self.
+		cdef vector[ValueType] lhs_values
+		cdef vector[ValueType] rhs_values
+		cdef Dict result = Dict.__new__(Dict)
+		cdef SizeType i
+
+		if not isinstance(other, Set):
+			other = Dict(other) if isinstance(other, dict) else Set(other)
+		needs_other_values = operation in (UNION, SYMMETRIC_DIFFERENCE) or merge is not None
+		if needs_other_values and not isinstance(other, Dict):
+			raise TypeError("other must be a Dict")
+
+		self._apply(other, operation, result, &lhs_values, &rhs_values)
+
+		lhs = self._values
+		rhs = (<Dict>other)._values if isinstance(other, Dict) else None
+		values = []
+		for i in range(lhs_values.size()):
+			if lhs_values[i] < 0:
+				values.append(rhs[rhs_values[i]])
+			elif rhs_values[i] < 0:
+				values.append(lhs[lhs_values[i]])
+			elif merge is not None:
+				values.append(merge(lhs[lhs_values[i]], rhs[rhs_values[i]]))
+			elif operation == UNION:
+				values.append(rhs[rhs_values[i]])
+			else:
+				values.append(lhs[lhs_values[i]])
+		result._values = tuple(values)
+		return result
 
-	def read(self, f):
-		super().read(f)
-		data = f.read()
-		#np.load(f)
-		self._values = msgpack.unpackb(data, use_list=False, raw=False)
-		return self
+	def union(self, other, merge=None):
+		return self._combine(other, UNION, merge)
 
-	@staticmethod
-	def load(f):
-		if isinstance(f, bytes):
-			return Dict().frombytes(f)
-		else:
-			return Dict().read(f)
+	def intersection(self, other, merge=None):
+		return self._combine(other, INTERSECTION, merge)
 
-	def _open(self, unicode path):
-		raise NotImplementedError("mmap support for Dict not yet implemented")
-		super()._open(path)
-		self._values = []
-		# msgpack.unpackb(_mem_addr + , use_list=False, raw=False)
-		# FIXME
-
-	def file_size(self):
-		return super().file_size() + len(msgpack.packb(self._values, use_bin_type=True))
-
-	def _build_dawg(self, iterable, sorted):
-		if iterable is None:
-			elements = []
-		elif not sorted:
-			elements = [((<unicode>key).encode('utf8'), value)
-				if isinstance(key, unicode) else (key, value) for key, value in iterable]
-			elements.sort(key=lambda kv: kv[0])
-		else:
-			elements = iterable
+	def difference(self, other):
+		return self._combine(other, DIFFERENCE)
 
-		cdef DawgBuilder dawg_builder
-		cdef bytes b_key
-		cdef bytes b_last_key = None
-		cdef bint check_order = False
-		cdef int index
-		cdef object values = []
+	def symmetric_difference(self, other):
+		return self._combine(other, SYMMETRIC_DIFFERENCE)
 
-		for index, key in enumerate(elements):
-			key, value = key
-			values.append(value)
+	def _dump_values(self):
+		return msgpack.packb(self._values, use_bin_type=True)
 
-			if isinstance(key, unicode):
-				b_key = <bytes>(<unicode>key).encode('utf8')
-			else:
-				b_key = key
-
-			if check_order and b_key < b_last_key:
-				raise ValueError("input is not sorted at key %s" % key)
-			if b_key == b_last_key:
-				raise ValueError("input contained duplicate key %s" % key)
+	def _load_values(self, data):
+		self._values = msgpack.unpackb(data, use_list=False, raw=False)
+		self._values_array = None
 
-			if not dawg_builder.Insert(b_key, len(b_key), index):
-				raise RuntimeError("error on inserting key %s" % key)
+	def _build_options(self):
+		# loaded dicts do not record interning, but have fewer values than
+		# keys if any were shared.
+		options = super()._build_options()
+		options["intern_values"] = self._intern_values or len(self._values or ()) < self._size
+		return options
 
-			b_last_key = b_key
-			check_order = sorted
+	@staticmethod
+	def load(f):
+		if hasattr(f, "read"):
+			return Dict().read(f)
+		else:
+			return Dict().frombuffer(f)
+
+	def _build_dawg(self, iterable, sorted, threads, _BuildMonitor monitor):
+		cdef KeyArena arena
+		cdef SizeType num_of_threads = _num_of_threads(threads)
+		cdef bint check_order = sorted
+		cdef SizeType index = 0
+		cdef SizeType i
+		cdef bint ok
+		cdef list values = []
+		cdef const ValueType *order
+		cdef vector[ValueType] indices
+
+		monitor.phase("reading")
+		if iterable is not None:
+			for key, value in iterable:
+				_insert_key(&arena, key, RuntimeError)
+				values.append(value)
+				monitor.monitor.add_keys(1)
+				if monitor.monitor.is_cancelled():
+					monitor.check()
+		arena.Finish()
+
+		monitor.phase("sorting")
+		with nogil:
+			if not check_order:
+				arena.Sort(num_of_threads)
+			ok = arena.IsStrictlySorted(&index)
+		if not ok:
+			key = _arena_key(&arena, index).decode("utf8", "replace")
+			if _arena_key(&arena, index) == _arena_key(&arena, index - 1):
+				raise ValueError("input contained duplicate key %s" % key)
+			raise ValueError("input is not sorted at key %s" % key)
+
+		# values are stored in key order, and each key maps to its position
+		# or, if values are interned, to the first position of its value.
+		order = arena.values()
+		values = [values[order[i]] for i in range(arena.num_of_keys())]
+		indices.resize(arena.num_of_keys())
+		if self._intern_values:
+			values = self._intern(values, indices.data())
+		else:
+			for i in range(arena.num_of_keys()):
+				indices[i] = i
 
 		'''
 		cdef tuple int_types = (np.int8, np.int16, np.int32, np.int64)
@@ -567,10 +2134,555 @@ cdef class Dict(Set):
 
 		# numpy.asarray(values)
 
-		if not dawg_builder.Finish(&self.dawg):
+		self._build_dawg_from_keys(
+			arena.keys(), arena.lengths(), indices.data(), arena.num_of_keys(), threads, monitor)
+		self._size = arena.num_of_keys()
+
+	cdef list _intern(self, list values, ValueType *indices):
+		# returns the distinct values in order of appearance, and sets the
+		# index of each value among them. values of different types are
+		# kept apart, even if they are equal (like 1 and True).
+		cdef dict ids = {}
+		cdef list distinct = []
+		cdef SizeType i
+
+		for i, value in enumerate(values):
+			try:
+				id = ids.setdefault((type(value), value), len(distinct))
+			except TypeError:
+				raise TypeError("interned values must be hashable, got %r" % (value,))
+			if id == len(distinct):
+				distinct.append(value)
+			indices[i] = id
+		return distinct
+
+cdef class SetBuilder:
+	# builds a Set from keys in any order. the automaton is minimized after
+	# each key, so memory grows with the size of the result rather than with
+	# the number of keys, and keys need not be collected and sorted first.
+	cdef UnsortedDawgBuilder builder
+
+	def add(self, key):
+		cdef bytes b_key
+		if isinstance(key, unicode):
+			b_key = <bytes>(<unicode>key).encode('utf8')
+		else:
+			b_key = key
+		if not self.builder.Insert(b_key, len(b_key), 0):
+			raise ValueError("error on inserting key %s" % key)
+
+	def update(self, iterable):
+		for key in iterable:
+			self.add(key)
+
+	@property
+	def num_of_states(self):
+		return self.builder.num_of_states()
+
+	def __len__(self):
+		return self.builder.num_of_keys()
+
+	def build(self, completions=True, wide=False, succinct=False, locality=False,
+		interleaved=False, ranks=False):
+		# returns the Set and resets the builder.
+		cdef Set s = Set.__new__(Set)
+		cdef bint ok
+
+		s._completions = completions or succinct or interleaved or ranks
+		s._ranks = ranks
+		s._wide = wide and not succinct
+		s._succinct = succinct
+		s._interleaved = interleaved and not wide and not succinct
+		s._hot_size = _HOT_SIZE if locality else 0
+		s._size = self.builder.num_of_keys()
+		with nogil:
+			ok = self.builder.Finish(&s.dawg)
+		if not ok:
 			raise RuntimeError("internal error in dawg building")
 
-def open(unicode path):
-	return Set()._open(path)
+		s._build_dictionary()
+		return s
+
+def _file_identity(st):
+	return (st.st_dev, st.st_ino, st.st_size, st.st_mtime_ns)
+
+def _reopen(cls, path, identity, options):
+	if _file_identity(os.stat(path)) != identity:
+		raise IOError("%s was modified after it was pickled" % path)
+	return cls()._open(path, **options)
+
+def _frombuffer(cls, data):
+	return cls().frombuffer(data)
+
+def _file_type(unicode path):
+	# peeks at the metadata of a file to find the class that wrote it.
+	cdef FileHeader header
+
+	with io.open(path, "rb") as f:
+		data = f.read(sizeof(FileHeader))
+		if not _has_magic(data):
+			return Set
+		swapped = _parse_header(data, &header)
+		table = f.read(header.section_table_offset - sizeof(FileHeader) +
+			header.num_of_sections * sizeof(FileSection))
+		for section_type, offset, size, count in _parse_sections(
+				table, header.section_table_offset, &header, swapped):
+			if section_type == METADATA_SECTION:
+				f.seek(offset)
+				metadata = msgpack.unpackb(f.read(size), raw=False)
+				return Dict if metadata.get("type") == "Dict" else Set
+
+	return Set
+
+def open(unicode path, **kwargs):
+	# see Set._open for options that control paging.
+	return _file_type(path)()._open(path, **kwargs)
+
+def build(unicode path, keys, completions=True, memory_limit=DEFAULT_MEMORY_LIMIT,
+	tmp_dir=None, alignment=DEFAULT_ALIGNMENT, wide=False, succinct=False, locality=False,
+	interleaved=False, ranks=False):
+	# writes a Set file from keys that need be neither sorted nor fit into
+	# memory. keys are buffered up to memory_limit bytes, spilled to sorted
+	# runs in tmp_dir and merged into the dawg, which only holds the
+	# minimized automaton. the result can then be mapped with open(path).
+	cdef bytes b_key
+	cdef bytes b_tmp_dir = os.fsencode(tmp_dir) if tmp_dir is not None else None
+	cdef ExternalSorter *sorter
+	cdef DawgBuilder builder
+	cdef SizeType num_of_keys = 0
+	cdef bint ok = True
+	cdef Set s
+
+	if memory_limit <= 0:
+		raise ValueError("memory_limit must be positive")
+
+	sorter = new ExternalSorter(memory_limit,
+		<const char*>b_tmp_dir if b_tmp_dir is not None else NULL)
+	try:
+		for key in keys:
+			if isinstance(key, unicode):
+				b_key = <bytes>(<unicode>key).encode('utf8')
+			else:
+				b_key = key
+
+			if not b_key or b"\0" in b_key:
+				raise ValueError("error on inserting key %s" % key)
+
+			if not sorter.Insert(<const CharType*>b_key, len(b_key)):
+				raise IOError("writing a sorted run failed")
+
+		with nogil:
+			ok = sorter.Finish()
+			while ok and sorter.Next():
+				ok = builder.Insert(<CharType*>sorter.key(), sorter.length(), 0)
+				num_of_keys += 1
+			ok = ok and not sorter.failed()
+
+		if not ok:
+			raise IOError("merging sorted runs failed")
+	finally:
+		del sorter
+
+	s = Set.__new__(Set)
+	s._completions = completions or succinct or interleaved or ranks
+	s._ranks = ranks
+	s._wide = wide and not succinct
+	s._succinct = succinct
+	s._interleaved = interleaved and not wide and not succinct
+	s._hot_size = _HOT_SIZE if locality else 0
+	if not builder.Finish(&s.dawg):
+		raise RuntimeError("internal error in dawg building")
+	builder.Clear()
+
+	s._build_dictionary()
+	s.dawg.Clear()
+	s._size = num_of_keys
+
+	with io.open(path, "wb") as f:
+		s.dump(f, alignment)
+
+class Handle:
+	# holds a mapped Set or Dict that can be replaced by a newly written
+	# file while in use. readers that obtained the previous object keep it
+	# (and its mapping) alive until they drop their last reference; new
+	# readers get the new object. files should be replaced atomically, i.e.
+	# written under a temporary name and then renamed.
+
+	def __init__(self, path, **kwargs):
+		self._lock = threading.Lock()
+		self._path = path
+		self._options = kwargs
+		self._current = open(path, **kwargs)
+
+	@property
+	def path(self):
+		return self._path
+
+	def get(self):
+		return self._current
+
+	@contextlib.contextmanager
+	def acquire(self):
+		# pins the current object for the duration of a with block.
+		current = self._current
+		yield current
+
+	def swap(self, path=None):
+		# maps a new file and makes it current.
+		with self._lock:
+			return self._swap_locked(path)
+
+	def reload(self):
+		# swaps if the file at path is not the one currently mapped. the
+		# check and the swap are one step, so that of concurrent reloads
+		# only the first maps the new file.
+		with self._lock:
+			if _file_identity(os.stat(self._path)) == self._current._identity:
+				return False
+			self._swap_locked(None)
+			return True
+
+	def _swap_locked(self, path):
+		if path is None:
+			path = self._path
+		current = open(path, **self._options)
+		self._current = current
+		self._path = path
+		return current
+
+def _utf8(key):
+	return key.encode("utf8")
+
+def _sorted_by_utf8(items, key=_utf8):
+	# the builtin sorted is shadowed by simtrie.sorted in this module.
+	items = list(items)
+	items.sort(key=key)
+	return items
+
+def _check_key(key):
+	if isinstance(key, bytes):
+		key = key.decode("utf8")
+	if not key or "\0" in key:
+		raise ValueError("error on inserting key %s" % key)
+	return key
+
+class _Mutable:
+	# common part of MutableSet and MutableDict: a static base plus a delta
+	# of added keys and a set of deleted ones (tombstones). a key that is
+	# in the base and in the delta is also a tombstone, so len() is
+	# len(base) - len(deleted) + len(added). the three are kept in one tuple
+	# that is replaced at once when a compaction finishes.
+
+	def __init__(self, base, compact_threshold=None, **kwargs):
+		# compact_threshold: number of changes after which a compaction
+		#   starts in the background, None to compact only on request.
+		# kwargs are passed on when building a new base (e.g. threads), and
+		# override the layout of the given base, which is kept otherwise.
+		self._lock = threading.RLock()
+		self._options = base._build_options()
+		self._options.update((k, v) for k, v in kwargs.items() if k != "sorted")
+		self._state = (base, self._new_delta(), set())
+		self._version = 0
+		self._delta_cache = None
+		self._compaction = None
+		self._compaction_error = None
+		self.compact_threshold = compact_threshold
+
+	@property
+	def base(self):
+		return self._state[0]
+
+	@property
+	def num_of_changes(self):
+		base, added, deleted = self._state
+		return len(added) + len(deleted)
+
+	def __contains__(self, key):
+		base, added, deleted = self._state
+		if isinstance(key, bytes):
+			key = key.decode("utf8")
+		return key in added or (key not in deleted and key in base)
+
+	def __len__(self):
+		base, added, deleted = self._state
+		return len(base) - len(deleted) + len(added)
+
+	def __iter__(self):
+		return self.keys()
 
+	def keys(self, prefix=""):
+		# keys of base and delta, merged in byte order.
+		base, added, deleted = self._state
+		new_keys = _sorted_by_utf8([key for key in list(added) if key.startswith(prefix)])
+		base_keys = (key for key in base.keys(prefix) if key not in deleted)
+		return heapq.merge(base_keys, new_keys, key=_utf8)
 
+	def lcs(self, search, min_length=3):
+		# results from the base come first, then those from the delta.
+		base, added, deleted = self._state
+		for seq, key in base.lcs(search, min_length):
+			if key not in deleted:
+				yield seq, key
+		if added:
+			yield from self._delta(added).lcs(search, min_length)
+
+	def compact(self, wait=False):
+		# rebuilds the base from base and delta in a background thread and
+		# swaps it in. changes made meanwhile are kept in the new delta.
+		# an error of the compaction is raised after waiting for it or, if
+		# nobody waited, by the next call.
+		with self._lock:
+			self._raise_compaction_error()
+			thread = self._start_compaction()
+		if wait:
+			thread.join()
+			with self._lock:
+				self._raise_compaction_error()
+		return thread
+
+	def _start_compaction(self):
+		with self._lock:
+			if self._compaction is None:
+				base, added, deleted = self._state
+				self._compaction = threading.Thread(
+					target=self._compact, args=(base, self._copy_delta(added), set(deleted)),
+					daemon=True)
+				self._compaction.start()
+			return self._compaction
+
+	def _raise_compaction_error(self):
+		error, self._compaction_error = self._compaction_error, None
+		if error is not None:
+			raise error
+
+	def _compact(self, base, added, deleted):
+		try:
+			new_base = self._build_base(self._merged_items(base, added, deleted), sorted=True)
+
+			with self._lock:
+				state = self._state
+				new_added = self._new_delta()
+				new_deleted = set()
+				for key in set(state[1]) | state[2] | set(added) | deleted:
+					present, value = self._lookup(state, key)
+					if key in new_base:
+						if present and self._same_value(new_base, key, value):
+							continue
+						new_deleted.add(key)
+					if present:
+						self._put(new_added, key, value)
+				self._state = (new_base, new_added, new_deleted)
+				self._version += 1
+		except BaseException as error:
+			# the delta stays as it is; the error is kept for compact().
+			with self._lock:
+				self._compaction_error = error
+		finally:
+			with self._lock:
+				self._compaction = None
+
+	def _changed(self):
+		self._version += 1
+		threshold = self.compact_threshold
+		if threshold is not None and self._compaction is None and \
+				self.num_of_changes >= threshold:
+			self._start_compaction()
+
+	def _delta(self, added):
+		# a small trie over the delta for similarity searches, rebuilt
+		# after changes.
+		version = self._version
+		cache = self._delta_cache
+		if cache is None or cache[0] != version:
+			cache = (version, self._build_base(self._delta_items(added), sorted=False))
+			self._delta_cache = cache
+		return cache[1]
+
+class MutableSet(_Mutable):
+	# a Set that supports add and discard without rebuilding.
+
+	def __init__(self, iterable=None, compact_threshold=None, **kwargs):
+		if isinstance(iterable, Set) and not isinstance(iterable, Dict):
+			base = iterable
+		else:
+			base = Set(iterable, **kwargs)
+		super().__init__(base, compact_threshold, **kwargs)
+
+	def add(self, key):
+		key = _check_key(key)
+		with self._lock:
+			base, added, deleted = self._state
+			if key in deleted:
+				deleted.discard(key)
+			elif key not in added and key not in base:
+				added.add(key)
+			else:
+				return
+			self._changed()
+
+	def update(self, iterable):
+		for key in iterable:
+			self.add(key)
+
+	def discard(self, key):
+		if isinstance(key, bytes):
+			key = key.decode("utf8")
+		with self._lock:
+			base, added, deleted = self._state
+			if key in added:
+				added.discard(key)
+			elif key in base and key not in deleted:
+				deleted.add(key)
+			else:
+				return
+			self._changed()
+
+	def remove(self, key):
+		if key not in self:
+			raise KeyError(key)
+		self.discard(key)
+
+	def similar(self, search, max_cost=1, metric=None, **kwargs):
+		# results from the base come first, then those from the delta.
+		base, added, deleted = self._state
+		for key, cost in base.similar(search, max_cost, metric, **kwargs):
+			if key not in deleted:
+				yield key, cost
+		if added:
+			yield from self._delta(added).similar(search, max_cost, metric, **kwargs)
+
+	def _new_delta(self):
+		return set()
+
+	def _copy_delta(self, added):
+		return set(added)
+
+	def _put(self, added, key, value):
+		added.add(key)
+
+	def _lookup(self, state, key):
+		base, added, deleted = state
+		return key in added or (key not in deleted and key in base), None
+
+	def _same_value(self, base, key, value):
+		return True
+
+	def _build_base(self, iterable, sorted):
+		return Set(iterable, sorted=sorted, **self._options)
+
+	def _delta_items(self, added):
+		return list(added)
+
+	def _merged_items(self, base, added, deleted):
+		return heapq.merge(
+			(key for key in base.keys() if key not in deleted),
+			_sorted_by_utf8(added), key=_utf8)
+
+class MutableDict(_Mutable):
+	# a Dict that supports assignment and deletion without rebuilding. the
+	# base needs completions to be iterable.
+
+	def __init__(self, iterable=None, compact_threshold=None, **kwargs):
+		if isinstance(iterable, Dict):
+			base = iterable
+		else:
+			if isinstance(iterable, dict):
+				iterable = iterable.items()
+			kwargs["completions"] = True
+			base = Dict(iterable, **kwargs)
+		super().__init__(base, compact_threshold, **kwargs)
+
+	def __getitem__(self, key):
+		base, added, deleted = self._state
+		if isinstance(key, bytes):
+			key = key.decode("utf8")
+		if key in added:
+			return added[key]
+		if key in deleted:
+			raise KeyError(key)
+		return base[key]
+
+	def get(self, key, default=None):
+		try:
+			return self[key]
+		except KeyError:
+			return default
+
+	def __setitem__(self, key, value):
+		key = _check_key(key)
+		with self._lock:
+			base, added, deleted = self._state
+			if key not in added and key not in deleted and key in base:
+				deleted.add(key)  # shadows the value in the base
+			added[key] = value
+			self._changed()
+
+	def __delitem__(self, key):
+		if isinstance(key, bytes):
+			key = key.decode("utf8")
+		with self._lock:
+			base, added, deleted = self._state
+			if key in added:
+				del added[key]
+			elif key in base and key not in deleted:
+				deleted.add(key)
+			else:
+				raise KeyError(key)
+			self._changed()
+
+	def update(self, items):
+		if isinstance(items, dict):
+			items = items.items()
+		for key, value in items:
+			self[key] = value
+
+	def items(self, prefix=""):
+		base, added, deleted = self._state
+		new_items = _sorted_by_utf8([(key, value) for key, value in list(added.items())
+			if key.startswith(prefix)], key=lambda item: _utf8(item[0]))
+		base_items = ((key, value) for key, value in base.items(prefix) if key not in deleted)
+		return heapq.merge(base_items, new_items, key=lambda item: _utf8(item[0]))
+
+	def values(self, prefix=""):
+		return (value for key, value in self.items(prefix))
+
+	def similar(self, search, max_cost=1, metric=None, **kwargs):
+		# results from the base come first, then those from the delta.
+		base, added, deleted = self._state
+		for key, value, cost in base.similar(search, max_cost, metric, **kwargs):
+			if key not in deleted:
+				yield key, value, cost
+		if added:
+			yield from self._delta(added).similar(search, max_cost, metric, **kwargs)
+
+	def _new_delta(self):
+		return {}
+
+	def _copy_delta(self, added):
+		return dict(added)
+
+	def _put(self, added, key, value):
+		added[key] = value
+
+	def _lookup(self, state, key):
+		base, added, deleted = state
+		if key in added:
+			return True, added[key]
+		if key not in deleted and key in base:
+			return True, base[key]
+		return False, None
+
+	def _same_value(self, base, key, value):
+		return base[key] == value
+
+	def _build_base(self, iterable, sorted):
+		return Dict(iterable, sorted=sorted, **self._options)
+
+	def _delta_items(self, added):
+		return list(added.items())
+
+	def _merged_items(self, base, added, deleted):
+		key = lambda item: _utf8(item[0])
+		return heapq.merge(
+			((k, v) for k, v in base.items() if k not in deleted),
+			_sorted_by_utf8(added.items(), key=key), key=key)
@@ -1,11 +1,26 @@
 # -*- coding: utf-8 -*-
 from __future__ import absolute_import, unicode_literals
+import os
 import pickle
+import random
+import struct
+import sys
+import threading
 from io import BytesIO
 
 import pytest
 import simtrie
 
+def random_keys(seed, alphabet, max_length, count):
+    # count keys of 1 to max_length characters, with repetitions.
+    rng = random.Random(seed)
+    return [''.join(rng.choice(alphabet) for _ in range(rng.randint(1, max_length)))
+            for _ in range(count)]
+
+# distinct keys, sorted, shared by tests that need a few thousand short
+# keys with some non-ascii characters.
+KEYS = sorted(set(random_keys(5, 'abcdé', 6, 3000)))
+
 def test_contains():
     d = simtrie.Dict({'foo': 1, 'bar': 2, 'foobar': 3})
 
@@ -18,6 +33,11 @@ def test_contains():
     assert b'foo' in d
     assert b'x' not in d
 
+def test_dict_len():
+    assert len(simtrie.Dict({'foo': 1, 'bar': 2, 'foobar': 3})) == 3
+    assert len(simtrie.Dict([('foo', 1)])) == 1
+    assert len(simtrie.Dict([])) == 0
+
 
 class TestDAWG(object):
 
@@ -344,3 +364,1154 @@ def test_lev_substitute():
     assert(lev('asdf', 'zsdf') == pytest.approx(1.2))
     assert(lev('zsdf', 'asdf') == pytest.approx(0.1))
 
+
+
+class TestFileFormat(object):
+    keys = ['f', 'bar', 'foo', 'foobar']
+
+    def test_header(self):
+        data = simtrie.Set(self.keys).tobytes()
+        assert data[:8] == b'SIMTRIE\x00'
+        magic, byte_order, major, minor, flags, alignment, n_sections, \
+            table_offset, n_keys = struct.unpack_from('=8sIHHIIIIQ', data)
+        assert byte_order == 0x01020304
+        assert major == 1
+        assert n_keys == 4
+        for i in range(n_sections):
+            _, _, offset, size, _ = struct.unpack_from(
+                '=IIQQQ', data, table_offset + i * 32)
+            assert offset % alignment == 0
+            assert offset + size <= len(data)
+
+    def test_page_alignment(self):
+        s = simtrie.Set(self.keys)
+        buf = BytesIO()
+        s.dump(buf, alignment=4096)
+        assert len(buf.getvalue()) == s.file_size(alignment=4096)
+        s2 = simtrie.Set.load(buf.getvalue())
+        assert list(s2) == sorted(self.keys)
+
+    def test_open(self, tmp_path):
+        path = str(tmp_path / 'set.bin')
+        with open(path, 'wb') as f:
+            simtrie.Set(self.keys).dump(f)
+
+        with simtrie.open(path) as s:
+            assert isinstance(s, simtrie.Set)
+            assert len(s) == 4
+            assert list(s.keys('foo')) == ['foo', 'foobar']
+
+    def test_open_dict(self, tmp_path):
+        path = str(tmp_path / 'dict.bin')
+        with open(path, 'wb') as f:
+            simtrie.Dict({'foo': 1, 'bar': [2, 3]}).dump(f)
+
+        with simtrie.open(path) as d:
+            assert isinstance(d, simtrie.Dict)
+            assert d['foo'] == 1
+            assert d['bar'] == (2, 3)
+
+    def test_legacy_format(self):
+        # number of keys, dictionary and guide with size prefixes.
+        s = simtrie.Set(self.keys)
+        data = s.tobytes()
+        _, _, _, _, _, _, n_sections, table_offset, _ = \
+            struct.unpack_from('=8sIHHIIIIQ', data)
+        legacy = (4).to_bytes(8, 'big')
+        for i in range(n_sections):
+            section_type, _, offset, size, count = struct.unpack_from(
+                '=IIQQQ', data, table_offset + i * 32)
+            if section_type in (1, 2):
+                legacy += struct.pack('=I', count) + data[offset:offset + size]
+        s2 = simtrie.Set.load(legacy)
+        assert list(s2) == sorted(self.keys)
+
+    def test_foreign_byte_order(self, tmp_path):
+        data = bytearray(simtrie.Set(self.keys).tobytes())
+        native = '<' if sys.byteorder == 'little' else '>'
+        foreign = '>' if native == '<' else '<'
+
+        header = struct.unpack_from(native + '8sIHHIIIIQ', data)
+        struct.pack_into(foreign + '8sIHHIIIIQ', data, 0, *header)
+        table_offset, n_sections = header[7], header[6]
+        for i in range(n_sections):
+            section = struct.unpack_from(
+                native + 'IIQQQ', data, table_offset + i * 32)
+            struct.pack_into(
+                foreign + 'IIQQQ', data, table_offset + i * 32, *section)
+            section_type, _, offset, size, count = section
+            if section_type == 1:
+                units = struct.unpack_from(native + '%dI' % count, data, offset)
+                struct.pack_into(foreign + '%dI' % count, data, offset, *units)
+
+        s = simtrie.Set.load(bytes(data))
+        assert list(s) == sorted(self.keys)
+        assert 'foobar' in s
+
+        path = str(tmp_path / 'foreign.bin')
+        with open(path, 'wb') as f:
+            f.write(data)
+        with pytest.raises(IOError):
+            simtrie.open(path)
+
+    def test_unknown_sections_are_skipped(self):
+        # appends a section of a type unknown to this reader. the entry
+        # goes into the padding between section table and first section.
+        data = bytearray(simtrie.Set(self.keys).tobytes())
+        table_offset = struct.unpack_from('=8sIHHIIIIQ', data)[7]
+        n_sections = struct.unpack_from('=I', data, 24)[0]
+        offset = (len(data) + 63) // 64 * 64
+        struct.pack_into('=IIQQQ', data, table_offset + n_sections * 32,
+                         1000, 0, offset, 8, 1)
+        struct.pack_into('=I', data, 24, n_sections + 1)
+        data += b'\0' * (offset - len(data)) + b'appended'
+
+        s = simtrie.Set.load(bytes(data))
+        assert list(s) == sorted(self.keys)
+
+
+class TestBuffers(object):
+    payload = {'foo': 1, 'bar': 5, 'foobar': 3}
+
+    def check(self, d):
+        for key, value in self.payload.items():
+            assert d[key] == value
+        assert list(d.keys('foo')) == ['foo', 'foobar']
+
+    def test_memoryview(self):
+        data = simtrie.Dict(self.payload).tobytes()
+        self.check(simtrie.Dict.load(memoryview(data)))
+
+    def test_unaligned(self):
+        data = b'x' + simtrie.Dict(self.payload).tobytes()
+        self.check(simtrie.Dict().frombuffer(memoryview(data)[1:]))
+
+    def test_numpy(self):
+        np = pytest.importorskip('numpy')
+        data = simtrie.Dict(self.payload).tobytes()
+        array = np.frombuffer(data, dtype=np.uint8).copy()
+        d = simtrie.Dict().frombuffer(array)
+        del array
+        self.check(d)
+
+    def test_shared_memory(self):
+        shared_memory = pytest.importorskip('multiprocessing.shared_memory')
+        data = simtrie.Dict(self.payload).tobytes()
+        shm = shared_memory.SharedMemory(create=True, size=len(data))
+        try:
+            shm.buf[:len(data)] = data
+            d = simtrie.Dict().frombuffer(shm.buf[:len(data)])
+            self.check(d)
+            d.close()
+        finally:
+            shm.close()
+            shm.unlink()
+
+    def test_iterator_keeps_buffer(self):
+        data = bytearray(simtrie.Set(['foo', 'foobar']).tobytes())
+        keys = simtrie.Set().frombuffer(data).keys('foo')
+        assert list(keys) == ['foo', 'foobar']
+
+
+class TestPaging(object):
+    keys = ['f', 'bar', 'foo', 'foobar']
+
+    def path(self, tmp_path):
+        path = str(tmp_path / 'set.bin')
+        with open(path, 'wb') as f:
+            simtrie.Set(self.keys).dump(f, alignment=4096)
+        return path
+
+    def test_populate(self, tmp_path):
+        with simtrie.open(self.path(tmp_path), populate=True,
+                          advice='random') as s:
+            assert list(s) == sorted(self.keys)
+            residency = s.residency()
+            assert residency['mapped'] == s.file_size(alignment=4096)
+            assert residency['resident'] == residency['mapped']
+
+    def test_huge_pages(self, tmp_path):
+        with simtrie.open(self.path(tmp_path), huge_pages=True,
+                          advice='willneed') as s:
+            assert 'foobar' in s
+
+    def test_lock(self, tmp_path):
+        try:
+            s = simtrie.open(self.path(tmp_path), lock=True)
+        except OSError:
+            pytest.skip('memory locking not permitted')
+        assert s.residency()['locked']
+        s.close()
+
+    def test_illegal_advice(self, tmp_path):
+        with pytest.raises(ValueError):
+            simtrie.open(self.path(tmp_path), advice='never')
+
+    def test_in_memory(self):
+        residency = simtrie.Set(self.keys).residency()
+        assert residency['mapped'] == 0
+        assert residency['resident'] > 0
+
+
+class TestPickling(object):
+    payload = {'foo': 1, 'bar': 5, 'foobar': 3}
+
+    def test_mapped_by_reference(self, tmp_path):
+        path = str(tmp_path / 'dict.bin')
+        with open(path, 'wb') as f:
+            simtrie.Dict(self.payload).dump(f)
+
+        d = simtrie.open(path, advice='random')
+        data = pickle.dumps(d)
+        assert len(data) < 200
+        d2 = pickle.loads(data)
+        assert d2.residency()['mapped'] > 0
+        assert dict(d2.items()) == self.payload
+
+    def test_modified_file(self, tmp_path):
+        path = str(tmp_path / 'set.bin')
+        with open(path, 'wb') as f:
+            simtrie.Set(['foo']).dump(f)
+        data = pickle.dumps(simtrie.open(path))
+
+        with open(path, 'wb') as f:
+            simtrie.Set(['foo', 'bar']).dump(f)
+        with pytest.raises(IOError):
+            pickle.loads(data)
+
+    def test_out_of_band(self):
+        if not hasattr(pickle, 'PickleBuffer'):
+            pytest.skip('requires pickle protocol 5')
+
+        d = simtrie.Dict(self.payload)
+        buffers = []
+        data = pickle.dumps(d, protocol=5, buffer_callback=buffers.append)
+        assert len(buffers) == 1
+        d2 = pickle.loads(data, buffers=buffers)
+        assert dict(d2.items()) == self.payload
+
+        # buffer-backed objects pass on their buffer.
+        buffers2 = []
+        pickle.dumps(d2, protocol=5, buffer_callback=buffers2.append)
+        assert bytes(buffers2[0]) == bytes(buffers[0])
+
+
+class TestHandle(object):
+
+    def write(self, path, keys):
+        tmp = path + '.tmp'
+        with open(tmp, 'wb') as f:
+            simtrie.Set(keys).dump(f)
+        os.replace(tmp, path)
+
+    def test_reload(self, tmp_path):
+        path = str(tmp_path / 'set.bin')
+        self.write(path, ['foo'])
+
+        handle = simtrie.Handle(path, advice='random')
+        assert handle.reload() is False
+
+        with handle.acquire() as old:
+            keys = old.keys()
+            self.write(path, ['foo', 'bar'])
+            assert handle.reload() is True
+
+            # in-flight readers keep using the old mapping.
+            assert list(keys) == ['foo']
+            assert 'bar' not in old
+
+        assert 'bar' in handle.get()
+        assert len(handle.get()) == 2
+
+    def test_concurrent_reload(self, tmp_path):
+        path = str(tmp_path / 'set.bin')
+        self.write(path, ['foo'])
+        handle = simtrie.Handle(path)
+        self.write(path, ['foo', 'bar'])
+
+        barrier = threading.Barrier(8)
+        results = []
+
+        def reload():
+            barrier.wait()
+            results.append(handle.reload())
+        threads = [threading.Thread(target=reload) for _ in range(8)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        assert results.count(True) == 1
+        assert 'bar' in handle.get()
+
+    def test_swap(self, tmp_path):
+        path1 = str(tmp_path / 'set1.bin')
+        path2 = str(tmp_path / 'set2.bin')
+        self.write(path1, ['foo'])
+        self.write(path2, ['bar'])
+
+        handle = simtrie.Handle(path1)
+        handle.swap(path2)
+        assert handle.path == path2
+        assert list(handle.get()) == ['bar']
+
+
+class TestParallelBuild(object):
+
+    def keys(self):
+        return random_keys(42, 'abcdefghijä中', 12, 100000)
+
+    def test_same_as_sequential(self):
+        keys = self.keys()
+        s1 = simtrie.Set(keys)
+        s2 = simtrie.Set(keys, threads=4)
+        assert len(s1) == len(s2)
+        assert list(s1) == list(s2)
+        for key in keys[:1000]:
+            assert key in s2
+            assert key + 'x' not in s2
+        assert list(s2.keys('abc')) == list(s1.keys('abc'))
+
+    def test_merging_states(self):
+        # the merged dawg flags exactly the states reached by two or more
+        # transitions. states of the minimal automaton are counted here by
+        # their transitions and whether they end a key.
+        keys = sorted(set(random_keys(8, 'abcdefgh', 10, 80000)))
+        trie = {}
+        for key in keys:
+            node = trie
+            for byte in key.encode('utf8'):
+                node = node.setdefault(byte, {})
+            node[None] = None
+
+        ids, in_degrees = {}, []
+
+        def state(node):
+            transitions = tuple((byte, state(child)) for byte, child in sorted(
+                node.items(), key=lambda item: -1 if item[0] is None else item[0])
+                if byte is not None)
+            signature = (None in node, transitions)
+            if signature not in ids:
+                ids[signature] = len(ids)
+                in_degrees.append(0)
+                for byte, child in transitions:
+                    in_degrees[child] += 1
+            return ids[signature]
+        state(trie)
+        expected = sum(1 for n in in_degrees if n >= 2)
+
+        s = simtrie.Set(keys, threads=2)
+        assert s.build_stats.merging_states == expected
+
+    def test_independent_subtrees(self):
+        # keys with distinct values share no suffixes, so their subtrees
+        # are placed on separate threads. the layout does not depend on
+        # the number of threads.
+        payload = dict((key, i) for i, key in enumerate(self.keys()))
+        d1 = simtrie.Dict(payload)
+        d2 = simtrie.Dict(payload, threads=2)
+        d3 = simtrie.Dict(payload, threads=3)
+        assert list(d2.items()) == list(d1.items())
+        assert d2.tobytes() == d3.tobytes()
+        assert d2.occupancy()['units'] < d1.occupancy()['units'] * 1.1
+
+    def test_dict(self):
+        payload = dict((key, i) for i, key in enumerate(self.keys()))
+        d = simtrie.Dict(payload, threads=None)
+        for key in list(payload)[:1000]:
+            assert d[key] == payload[key]
+
+    def test_errors(self):
+        with pytest.raises(ValueError):
+            simtrie.Set(['b', 'a'] * 50000, sorted=True, threads=4)
+        with pytest.raises(ValueError):
+            simtrie.Set(self.keys() + ['foo\x00bar'], threads=4)
+
+
+class TestExternalBuild(object):
+
+    def keys(self):
+        return random_keys(7, 'abcdxyzäö', 10, 20000)
+
+    def test_in_memory(self, tmp_path):
+        keys = self.keys()
+        path = str(tmp_path / 'set.simtrie')
+        simtrie.build(path, iter(keys))
+        with simtrie.open(path) as s:
+            assert list(s) == list(simtrie.Set(keys))
+            assert s.tobytes() == simtrie.Set(keys).tobytes()
+
+    def test_runs(self, tmp_path):
+        # a tiny buffer forces many runs and a multi-pass merge.
+        keys = self.keys()
+        path = str(tmp_path / 'set.simtrie')
+        simtrie.build(path, keys + keys[:100], memory_limit=1024,
+                      tmp_dir=str(tmp_path), completions=False)
+        with simtrie.open(path) as s:
+            assert len(s) == len(set(keys))
+            assert all(key in s for key in keys)
+        assert os.listdir(str(tmp_path)) == ['set.simtrie']
+
+    def test_errors(self, tmp_path):
+        path = str(tmp_path / 'set.simtrie')
+        with pytest.raises(ValueError):
+            simtrie.build(path, ['a', ''])
+        with pytest.raises(IOError):
+            simtrie.build(path, ['a', 'b'], memory_limit=1,
+                          tmp_dir=str(tmp_path / 'missing'))
+
+
+class TestFromFile(object):
+
+    def test_unsorted(self, tmp_path):
+        keys = ['foo', 'bar', 'bär', 'foobar', 'bar', 'f']
+        path = tmp_path / 'keys.txt'
+        path.write_bytes('\n'.join(keys).encode('utf8') + b'\r\n\n')
+        s = simtrie.Set.from_file(str(path))
+        assert list(s) == list(simtrie.Set(keys))
+        assert list(s.keys('foo')) == ['foo', 'foobar']
+
+    def test_sorted(self, tmp_path):
+        path = tmp_path / 'keys.txt'
+        path.write_bytes(b'a\tab\tab\tb')
+        s = simtrie.Set.from_file(str(path), sorted=True, delimiter='\t', threads=2)
+        assert list(s) == ['a', 'ab', 'b']
+        assert len(s) == 3
+
+        path.write_bytes(b'b\na\n')
+        with pytest.raises(ValueError):
+            simtrie.Set.from_file(str(path), sorted=True)
+
+    def test_errors(self, tmp_path):
+        path = tmp_path / 'keys.txt'
+        path.write_bytes(b'a\nb\x00c\n')
+        with pytest.raises(ValueError):
+            simtrie.Set.from_file(str(path))
+        with pytest.raises(ValueError):
+            simtrie.Set.from_file(str(path), delimiter='ab')
+        with pytest.raises(IOError):
+            simtrie.Set.from_file(str(tmp_path / 'missing.txt'))
+
+    def test_empty(self, tmp_path):
+        path = tmp_path / 'keys.txt'
+        path.write_bytes(b'')
+        s = simtrie.Set.from_file(str(path))
+        assert len(s) == 0
+        assert 'a' not in s
+
+
+class TestKeySorting(object):
+
+    def keys(self):
+        return random_keys(3, ['a', 'b', 'z', 'é', '中', '\U0001f600', '\x7f'], 8, 5000)
+
+    def test_sorted(self):
+        keys = self.keys() + [b'bytes', b'\xff']
+        expected = sorted(
+            key.encode('utf8') if isinstance(key, str) else key for key in keys)
+        assert simtrie.sorted(keys) == expected
+        assert simtrie.sorted(keys, threads=4) == expected
+
+    def test_sorted_any_key(self):
+        # unlike keys of a set, sorted keys may be empty or contain '\0'.
+        keys = ['b', '', 'a\0b', 'a', '\0', '']
+        assert simtrie.sorted(keys) == [b'', b'', b'\0', b'a', b'a\0b', b'b']
+        assert simtrie.sorted(['', '']) == [b'', b'']
+
+    def test_set(self):
+        keys = self.keys()
+        s = simtrie.Set(keys, threads=4)
+        assert list(s) == [key.decode('utf8') for key in sorted(
+            set(key.encode('utf8') for key in keys))]
+
+    def test_dict_values_in_key_order(self):
+        keys = list(set(self.keys()))
+        d = simtrie.Dict((key, i) for i, key in enumerate(keys))
+        assert [keys[i] for i in d.values()] == list(d.keys())
+        assert all(d[key] == i for i, key in enumerate(keys))
+
+    def test_dict_errors(self):
+        with pytest.raises(ValueError):
+            simtrie.Dict([('b', 1), ('a', 2), ('b', 3)])
+        with pytest.raises(ValueError):
+            simtrie.Dict([('b', 1), ('a', 2)], sorted=True)
+        with pytest.raises(RuntimeError):
+            simtrie.Dict([('a\x00b', 1)])
+
+
+class TestSetBuilder(object):
+
+    def keys(self):
+        return random_keys(5, 'abcä', 9, 3000)
+
+    def test_same_as_sorted_build(self):
+        keys = self.keys()
+        random.Random(1).shuffle(keys)
+        builder = simtrie.SetBuilder()
+        builder.update(keys)
+        assert len(builder) == len(set(keys))
+        s = builder.build()
+        assert s.tobytes() == simtrie.Set(keys).tobytes()
+        assert list(s.keys('ab')) == list(simtrie.Set(keys).keys('ab'))
+        assert len(builder) == 0
+
+    def test_minimal_after_each_key(self):
+        keys = self.keys()
+        unsorted = simtrie.SetBuilder()
+        unsorted.update(keys)
+        ordered = simtrie.SetBuilder()
+        ordered.update(sorted(set(keys)))
+        assert unsorted.num_of_states == ordered.num_of_states
+
+    def test_errors(self):
+        builder = simtrie.SetBuilder()
+        with pytest.raises(ValueError):
+            builder.add('')
+        with pytest.raises(ValueError):
+            builder.add('a\x00b')
+        assert len(builder.build()) == 0
+
+
+class TestMutable(object):
+
+    def test_set(self):
+        s = simtrie.MutableSet(['bar', 'foo', 'foobar'])
+        s.add('food')
+        s.add('foo')
+        s.discard('bar')
+        s.discard('missing')
+        assert 'food' in s and b'food' in s
+        assert 'bar' not in s
+        assert len(s) == 3
+        assert list(s) == ['foo', 'foobar', 'food']
+        assert list(s.keys('foo')) == ['foo', 'foobar', 'food']
+        assert [key for key, cost in s.similar('fod', 1)] == ['foo', 'food']
+        s.add('bar')
+        assert 'bar' in s and len(s) == 4
+        with pytest.raises(KeyError):
+            s.remove('baz')
+        with pytest.raises(ValueError):
+            s.add('')
+
+    def test_set_lcs(self):
+        s = simtrie.MutableSet(['bookish'])
+        s.add('boorish')
+        assert set(key for seq, key in s.lcs('bookish', 4)) == set(['bookish', 'boorish'])
+
+    def test_compaction(self):
+        s = simtrie.MutableSet(['a', 'b', 'c'])
+        s.update(['d', 'e'])
+        s.discard('a')
+        s.compact(wait=True)
+        assert s.num_of_changes == 0
+        assert list(s.base) == ['b', 'c', 'd', 'e']
+        assert list(s) == ['b', 'c', 'd', 'e']
+
+    def test_changes_during_compaction(self):
+        s = simtrie.MutableSet(['a', 'b'])
+        s.add('c')
+        base, added, deleted = s._state
+        snapshot = (base, set(added), set(deleted))
+        s.discard('c')
+        s.add('x')
+        s.discard('b')
+        # compacts the state from before the last changes.
+        s._compact(*snapshot)
+        assert list(s.base) == ['a', 'b', 'c']
+        assert list(s) == ['a', 'x']
+        assert len(s) == 2
+
+    def test_automatic_compaction(self):
+        s = simtrie.MutableSet(compact_threshold=10)
+        s.update(str(i) for i in range(25))
+        thread = s._compaction
+        if thread is not None:
+            thread.join()
+        assert sorted(s) == sorted(str(i) for i in range(25))
+        assert len(s.base) >= 10
+
+    def test_compaction_error(self):
+        s = simtrie.MutableSet(['a'])
+        s.add('b')
+
+        def fail(iterable, sorted):
+            raise MemoryError()
+        s._build_base = fail
+        with pytest.raises(MemoryError):
+            s.compact(wait=True)
+        assert s.num_of_changes == 1
+
+        s.compact().join()
+        with pytest.raises(MemoryError):
+            s.compact()
+        assert s._compaction is None
+        del s._build_base
+        s.compact(wait=True)
+        assert s.num_of_changes == 0 and list(s) == ['a', 'b']
+
+    def test_dict(self):
+        d = simtrie.MutableDict({'foo': 1, 'bar': 2})
+        d['foo'] = 3
+        d['baz'] = 4
+        del d['bar']
+        assert d['foo'] == 3 and d.get('bar') is None
+        assert len(d) == 2
+        assert list(d.items()) == [('baz', 4), ('foo', 3)]
+        assert sorted(d.similar('fao', 1)) == [('foo', 3, 1.0)]
+        with pytest.raises(KeyError):
+            del d['bar']
+        d.compact(wait=True)
+        assert len(d.base) == 2
+        assert d.base['foo'] == 3
+        assert list(d.items()) == [('baz', 4), ('foo', 3)]
+        assert d.num_of_changes == 0
+
+    @pytest.mark.parametrize('options', [{'ranks': True, 'succinct': True},
+                                         {'ranks': True, 'wide': True}, {'interleaved': True}])
+    def test_compaction_keeps_layout(self, options):
+        base = simtrie.Set(['a', 'b'], **options)
+        s = simtrie.MutableSet(base)
+        s.add('c')
+        s.compact(wait=True)
+        assert s.base._build_options() == base._build_options()
+        if options.get('ranks'):
+            assert s.base.rank('c') == 2 and s.base.key_at(1) == 'b'
+
+    def test_compaction_options_override(self):
+        s = simtrie.MutableSet(simtrie.Set(['a'], succinct=True), succinct=False)
+        s.add('b')
+        s.compact(wait=True)
+        assert not s.base.succinct
+
+
+class TestSetAlgebra(object):
+
+    def keys(self, seed):
+        return set(random_keys(seed, 'abcdé', 6, 2000))
+
+    @pytest.mark.parametrize('completions', [True, False])
+    def test_sets(self, completions):
+        a, b = self.keys(1), self.keys(2)
+        sa = simtrie.Set(a, completions=completions)
+        sb = simtrie.Set(b)
+        # results are identical to sets built from the keys.
+        expected = lambda keys: simtrie.Set(keys, completions=completions).tobytes()
+        assert sa.union(sb).tobytes() == expected(a | b)
+        assert (sa & sb).tobytes() == expected(a & b)
+        assert (sa - sb).tobytes() == expected(a - b)
+        assert (sa ^ sb).tobytes() == expected(a ^ b)
+        assert len(sa | sb) == len(a | b)
+        assert all(key in sa - sb for key in a - b)
+
+    def test_plain_iterables(self):
+        s = simtrie.Set(['a', 'b'])
+        assert list(s.union(['c'])) == ['a', 'b', 'c']
+        assert list(s - simtrie.Set()) == ['a', 'b']
+        assert list(simtrie.Set() & s) == []
+
+    def test_dicts(self):
+        a = simtrie.Dict({'apple': 1, 'banana': 2, 'cherry': 3})
+        b = simtrie.Dict({'banana': 20, 'date': 40})
+        assert dict(a.union(b).items()) == {'apple': 1, 'banana': 20, 'cherry': 3, 'date': 40}
+        assert dict(a.union(b, merge=lambda x, y: x + y).items())['banana'] == 22
+        assert dict(a.intersection(b).items()) == {'banana': 2}
+        assert dict(a.difference(simtrie.Set(['apple'])).items()) == {'banana': 2, 'cherry': 3}
+        assert dict(a.symmetric_difference(b).items()) == {'apple': 1, 'cherry': 3, 'date': 40}
+        assert a.union(b)['date'] == 40
+        with pytest.raises(TypeError):
+            a.union(simtrie.Set(['x']))
+
+
+class TestOccupancy(object):
+
+    def test_wide_nodes(self):
+        # nodes with many children, as for byte-level and CJK keys.
+        cjk = [chr(i) for i in range(0x4e00, 0x4f00)]
+        keys = set(random_keys(3, cjk, 3, 5000))
+        keys.update(chr(i) + chr(j) for i in range(1, 128) for j in range(1, 128, 3))
+        s = simtrie.Set(keys)
+        assert all(key in s for key in keys)
+        assert list(s) == sorted(keys)
+
+        occupancy = s.occupancy()
+        assert occupancy['units'] % 256 == 0
+        assert 0 <= occupancy['unused'] < occupancy['units']
+        assert occupancy['fill_ratio'] == 1.0 - occupancy['unused'] / occupancy['units']
+
+    def test_loaded(self):
+        s = simtrie.Set(['foo', 'bar'])
+        occupancy = simtrie.Set().frombytes(s.tobytes()).occupancy()
+        assert occupancy['units'] == s.occupancy()['units']
+        assert occupancy['unused'] is None
+
+
+class TestLongKeys(object):
+
+    def test_completions(self):
+        # building and walking keys does not recurse once per character.
+        a = 'a' * 300000
+        s = simtrie.Set([a, a + 'b', 'b' * 1000])
+        assert a + 'b' in s
+        assert list(s.keys('a' * 1000)) == [a, a + 'b']
+        assert list(s.keys('b')) == ['b' * 1000]
+
+    def test_parallel(self):
+        keys = ['a' * 100000 + str(i) for i in range(100)]
+        d = simtrie.Dict(dict((key, i) for i, key in enumerate(keys)),
+                         threads=2)
+        assert d[keys[50]] == 50
+        assert len(list(d.keys('a' * 99999))) == 100
+
+
+class TestBuildProgress(object):
+
+    def keys(self, n=300000):
+        return ['%x-%d' % (i * 2654435761 % 2 ** 32, i) for i in range(n)]
+
+    def test_stats(self):
+        calls = []
+        s = simtrie.Set(self.keys(1000), progress=calls.append)
+        stats = s.build_stats
+        assert stats.phase == 'done'
+        assert stats.keys == 1000
+        assert stats.states > 0
+        assert stats.units == s.occupancy()['units']
+        assert stats.unused_units == s.occupancy()['unused']
+        assert set(stats.timings) == set(['reading', 'sorting', 'dawg', 'dictionary'])
+        assert stats.peak_rss > 0
+        assert calls[-1].phase == 'done'
+
+    def test_from_file(self, tmpdir):
+        path = str(tmpdir.join('keys.txt'))
+        with open(path, 'w') as f:
+            f.write('\n'.join(self.keys(100)))
+        s = simtrie.Set.from_file(path, progress=lambda stats: None)
+        assert s.build_stats.keys == 100
+
+    def test_cancel(self):
+        with pytest.raises(simtrie.BuildCancelled):
+            simtrie.Set(self.keys(), progress=lambda stats: stats.phase == 'reading')
+
+    def test_error(self):
+        def progress(stats):
+            raise KeyboardInterrupt()
+        with pytest.raises(KeyboardInterrupt):
+            simtrie.Dict(dict((key, 1) for key in self.keys()), progress=progress)
+
+    def test_tqdm(self):
+        pytest.importorskip('tqdm')
+        d = simtrie.Dict({'foo': 1}, progress=True)
+        assert d['foo'] == 1
+
+
+class TestWideUnits(object):
+    keys = ['f', 'bar', 'foo', 'foobar', 'fooé', 'baz']
+
+    def test_lookups(self):
+        s = simtrie.Set(self.keys, wide=True)
+        assert s.wide and not simtrie.Set(self.keys).wide
+        assert all(key in s for key in self.keys)
+        assert 'fo' not in s
+        assert list(s) == sorted(self.keys)
+        assert list(s.keys('foo')) == ['foo', 'foobar', 'fooé']
+        assert list(s.prefixes('foobar')) == ['f', 'foo', 'foobar']
+        assert list(s.similar('fob', 1)) == list(simtrie.Set(self.keys).similar('fob', 1))
+        assert list(s.lcs('xfoobx')) == list(simtrie.Set(self.keys).lcs('xfoobx'))
+
+    def test_dict(self):
+        values = dict((key, i) for i, key in enumerate(self.keys))
+        d = simtrie.Dict(values, wide=True, threads=2)
+        assert all(d[key] == i for key, i in values.items())
+        assert dict(d.items()) == values
+        assert [value for key, value, cost in d.similar('baq', 1)] == [values['bar'], values['baz']]
+
+    def test_file(self, tmp_path):
+        s = simtrie.Set(self.keys, wide=True)
+        data = s.tobytes()
+        major, flags = struct.unpack_from('=HxxI', data, 12)
+        assert major == 2 and flags & 1
+        assert len(data) > len(simtrie.Set(self.keys).tobytes())
+
+        loaded = simtrie.Set.load(data)
+        assert loaded.wide and list(loaded) == sorted(self.keys)
+        assert simtrie.Set().frombytes(data).wide
+        path = str(tmp_path / 'wide.bin')
+        with open(path, 'wb') as f:
+            s.dump(f)
+        mapped = simtrie.open(path)
+        assert mapped.wide and list(mapped.keys('ba')) == ['bar', 'baz']
+
+    def test_unknown_flags(self):
+        data = bytearray(simtrie.Set(self.keys, wide=True).tobytes())
+        struct.pack_into('=I', data, 16, 2)
+        with pytest.raises(IOError):
+            simtrie.Set.load(bytes(data))
+
+    def test_set_operations(self):
+        a = simtrie.Set(['foo', 'bar'], wide=True)
+        b = simtrie.Set(['bar', 'baz'])
+        assert (a | b).wide and (b & a).wide and not (b - b).wide
+        assert list(a | b) == ['bar', 'baz', 'foo']
+        assert list(b & a) == ['bar']
+        assert (a - b).tobytes() == simtrie.Set(['foo'], wide=True).tobytes()
+
+
+class TestSuccinct(object):
+
+    def keys(self):
+        return set(KEYS)
+
+    def test_lookups(self):
+        keys = self.keys()
+        s = simtrie.Set(keys, succinct=True)
+        expected = simtrie.Set(keys)
+        assert s.succinct and not expected.succinct
+        assert all(key in s for key in keys)
+        assert 'x' not in s and '' not in s
+        assert list(s) == list(expected)
+        assert list(s.keys('ab')) == list(expected.keys('ab'))
+        assert list(s.prefixes('abcdé')) == list(expected.prefixes('abcdé'))
+        assert list(s.similar('abéd', 2)) == list(expected.similar('abéd', 2))
+        assert list(s.lcs('xabcdx')) == list(expected.lcs('xabcdx'))
+        assert len(s.tobytes()) < len(expected.tobytes())
+
+    def test_dict(self):
+        values = dict((key, i * 3) for i, key in enumerate(sorted(self.keys())))
+        d = simtrie.Dict(values, succinct=True)
+        assert all(d[key] == value for key, value in values.items())
+        assert dict(d.items()) == values
+
+    def test_file(self, tmp_path):
+        s = simtrie.Set(self.keys(), succinct=True)
+        data = s.tobytes()
+        major, flags = struct.unpack_from('=HxxI', data, 12)
+        assert major == 2 and flags & 2
+        assert list(simtrie.Set.load(data)) == list(s)
+        assert simtrie.Set().frombytes(data).succinct
+        path = str(tmp_path / 'succinct.bin')
+        with open(path, 'wb') as f:
+            s.dump(f)
+        mapped = simtrie.open(path)
+        assert mapped.succinct and list(mapped.keys('ab')) == list(s.keys('ab'))
+
+    def test_set_operations(self):
+        keys = self.keys()
+        a = simtrie.Set(keys, succinct=True)
+        b = simtrie.Set(list(keys)[:1000])
+        assert (a | b).succinct and (b & a).succinct
+        assert (a - b).tobytes() == simtrie.Set(keys - set(b), succinct=True).tobytes()
+        assert list(b - a) == []
+        assert list(a ^ simtrie.Set(keys, wide=True)) == []
+
+
+class TestLocality(object):
+
+    def keys(self):
+        # enough keys for the trie to outgrow the region placed breadth
+        # first, and to be built in parallel with threads.
+        return set(random_keys(7, 'abcdefghijklmnopé', 10, 60000))
+
+    def test_lookups(self):
+        keys = self.keys()
+        expected = simtrie.Set(keys)
+        for s in (simtrie.Set(keys, locality=True),
+                  simtrie.Set(keys, locality=True, threads=2),
+                  simtrie.Set(keys, locality=True, wide=True)):
+            assert s.tobytes() != expected.tobytes()
+            assert all(key in s for key in keys)
+            assert 'x' not in s and 'abcdefghijk' not in s
+            assert list(s) == list(expected)
+            assert list(s.keys('gé')) == list(expected.keys('gé'))
+            assert list(s.similar('abéd', 2)) == list(expected.similar('abéd', 2))
+            assert list(s.lcs('xabcdx')) == list(expected.lcs('xabcdx'))
+
+    def test_dict_and_set_operations(self):
+        keys = sorted(self.keys())
+        values = dict((key, i) for i, key in enumerate(keys))
+        d = simtrie.Dict(values, locality=True)
+        assert all(d[key] == value for key, value in values.items())
+
+        a = simtrie.Set(keys, locality=True)
+        b = simtrie.Set(keys[:1000])
+        assert (a - b).tobytes() == simtrie.Set(keys[1000:], locality=True).tobytes()
+
+
+class TestInterleaved(object):
+
+    def keys(self):
+        return set(KEYS)
+
+    def test_lookups(self):
+        keys = self.keys()
+        s = simtrie.Set(keys, interleaved=True)
+        expected = simtrie.Set(keys)
+        assert s.interleaved and not expected.interleaved
+        assert all(key in s for key in keys)
+        assert 'x' not in s and '' not in s
+        assert list(s) == list(expected)
+        assert list(s.keys('ab')) == list(expected.keys('ab'))
+        assert list(s.prefixes('abcdé')) == list(expected.prefixes('abcdé'))
+        assert list(s.similar('abéd', 2)) == list(expected.similar('abéd', 2))
+        assert list(s.lcs('xabcdx')) == list(expected.lcs('xabcdx'))
+        assert not simtrie.Set(keys, interleaved=True, wide=True).interleaved
+        assert list(simtrie.Set([], interleaved=True)) == []
+
+    def test_dict(self):
+        values = dict((key, i * 3) for i, key in enumerate(sorted(self.keys())))
+        d = simtrie.Dict(values, interleaved=True, locality=True)
+        assert all(d[key] == value for key, value in values.items())
+        assert dict(d.items()) == values
+
+    def test_file(self, tmp_path):
+        s = simtrie.Set(self.keys(), interleaved=True)
+        data = s.tobytes()
+        major, flags = struct.unpack_from('=HxxI', data, 12)
+        assert major == 2 and flags & 4
+        assert list(simtrie.Set.load(data)) == list(s)
+        assert simtrie.Set().frombytes(data).interleaved
+        path = str(tmp_path / 'interleaved.bin')
+        with open(path, 'wb') as f:
+            s.dump(f)
+        mapped = simtrie.open(path)
+        assert mapped.interleaved and list(mapped.keys('ab')) == list(s.keys('ab'))
+
+    def test_set_operations(self):
+        keys = self.keys()
+        some = sorted(keys)[::3]
+        a = simtrie.Set(keys, interleaved=True)
+        b = simtrie.Set(some, completions=False)
+        assert (a | b).interleaved and (b & a).interleaved
+        assert list((b & a).keys('ab')) == list(simtrie.Set(some).keys('ab'))
+        assert (a - b).tobytes() == simtrie.Set(keys - set(some), interleaved=True).tobytes()
+        assert list(b - a) == []
+        assert list(a ^ simtrie.Set(keys, succinct=True)) == []
+
+
+class TestBatchLookup(object):
+
+    def keys(self):
+        return list(KEYS)
+
+    def queries(self, keys):
+        return keys[::2] + [key + 'x' for key in keys[::7]] + ['', 'é', b'ab', 'x\0']
+
+    def test_contains_many(self):
+        keys = self.keys()
+        queries = self.queries(keys)
+        for options in ({}, {'wide': True}, {'succinct': True}, {'interleaved': True}):
+            s = simtrie.Set(keys, **options)
+            found = s.contains_many(queries)
+            assert found.dtype == bool
+            assert list(found) == [key in s for key in queries]
+            assert list(s.contains_many(iter(keys))) == [True] * len(keys)
+        assert len(simtrie.Set(keys).contains_many([])) == 0
+        assert list(simtrie.Set([]).contains_many(['a', ''])) == [False, False]
+
+    def test_get_many(self):
+        keys = self.keys()
+        queries = self.queries(keys)
+        for options in ({}, {'wide': True}, {'succinct': True}, {'interleaved': True}):
+            d = simtrie.Dict(((key, i) for i, key in enumerate(keys)), **options)
+            values = d.get_many(queries, -1)
+            assert values.dtype.kind == 'i'
+            expected = dict((key, i) for i, key in enumerate(keys))
+            assert list(values) == [expected.get(key.decode('utf8') if isinstance(key, bytes) else key, -1)
+                                    for key in queries]
+            assert list(d.get_many(keys)) == list(range(len(keys)))
+
+    def test_get_many_objects(self):
+        d = simtrie.Dict({'a': 'x', 'b': (1, 2), 'c': None})
+        assert list(d.get_many(['a', 'b', 'c', 'd'], 0)) == ['x', (1, 2), None, 0]
+        values = simtrie.Dict({'a': 1.5, 'b': 2.5}).get_many(['b', 'c'])
+        assert values.dtype == object and list(values) == [2.5, None]
+        assert list(simtrie.Dict.load(d.tobytes()).get_many(['b'])) == [(1, 2)]
+
+
+class TestRanks(object):
+
+    def keys(self):
+        return list(KEYS)
+
+    def test_rank_and_key_at(self):
+        keys = self.keys()
+        for options in ({}, {'wide': True}, {'succinct': True}, {'interleaved': True}):
+            s = simtrie.Set(keys, ranks=True, **options)
+            assert s.ranks
+            assert [s.rank(key) for key in keys] == list(range(len(keys)))
+            assert [s.key_at(i) for i in range(len(keys))] == keys
+            assert s.key_at(-1) == keys[-1]
+            with pytest.raises(KeyError):
+                s.rank(keys[0] + 'x' * 7)
+            with pytest.raises(IndexError):
+                s.key_at(len(keys))
+
+    def test_needs_ranks(self):
+        s = simtrie.Set(self.keys())
+        assert not s.ranks
+        with pytest.raises(ValueError):
+            s.rank('a')
+        empty = simtrie.Set([], ranks=True)
+        with pytest.raises(IndexError):
+            empty.key_at(0)
+        with pytest.raises(KeyError):
+            empty.rank('a')
+
+    def test_file(self, tmp_path):
+        keys = self.keys()
+        for options in ({}, {'wide': True}):
+            s = simtrie.Set(keys, ranks=True, **options)
+            loaded = simtrie.Set.load(s.tobytes())
+            assert loaded.ranks and loaded.key_at(100) == keys[100]
+            path = str(tmp_path / 'ranks.bin')
+            with open(path, 'wb') as f:
+                s.dump(f)
+            mapped = simtrie.open(path)
+            assert mapped.ranks and mapped.rank(keys[200]) == 200
+
+    def test_set_operations(self):
+        keys = self.keys()
+        a = simtrie.Set(keys[::2], ranks=True)
+        b = simtrie.Set(keys[1::2])
+        union = a | b
+        assert union.ranks and union.key_at(1) == keys[1]
+        assert (b - a).ranks and (b - a).rank(keys[3]) == 1
+
+
+class TestInternedValues(object):
+
+    def items(self):
+        keys = set(random_keys(17, 'abcdé', 7, 5000))
+        tags = ['TAG%d' % i for i in range(40)]
+        return dict((key, tags[len(key) * 7 % 40]) for key in keys)
+
+    def test_lookups(self):
+        items = self.items()
+        d = simtrie.Dict(items, intern_values=True)
+        expected = simtrie.Dict(items)
+        assert len(d.tobytes()) * 2 < len(expected.tobytes())
+        assert len(d.tobytes()) < len(simtrie.Set(items).tobytes()) + 1000
+        assert all(d[key] == value for key, value in items.items())
+        assert len(d) == len(items)
+        assert list(d.items()) == list(expected.items())
+        assert list(d.values()) == list(expected.values())
+        assert list(d.values('ab')) == list(expected.values('ab'))
+        assert list(d.similar('abéd', 1)) == list(expected.similar('abéd', 1))
+        assert list(d.get_many(['a', 'ab', 'x'])) == [items.get(k) for k in ['a', 'ab', 'x']]
+
+    def test_types_and_files(self):
+        d = simtrie.Dict({'a': 1, 'b': True, 'c': 1.0, 'd': 1}, intern_values=True)
+        assert [type(d[key]) for key in 'abcd'] == [int, bool, float, int]
+        loaded = simtrie.Dict.load(d.tobytes())
+        assert list(loaded.values()) == [1, True, 1.0, 1]
+        with pytest.raises(TypeError):
+            simtrie.Dict({'a': [1]}, intern_values=True)
+
+    def test_set_operations(self):
+        items = self.items()
+        keys = sorted(items)
+        a = simtrie.Dict(dict((key, items[key]) for key in keys[::2]), intern_values=True)
+        b = simtrie.Dict(dict((key, items[key]) for key in keys[1::2]), intern_values=True)
+        assert dict((a | b).items()) == items
+        assert list((a - b).values()) == [items[key] for key in keys[::2]]
+
+    def test_mutable(self):
+        d = simtrie.MutableDict(self.items(), intern_values=True)
+        d['zz'] = 'TAG1'
+        d.compact()
+        assert d['zz'] == 'TAG1'
+
+    @pytest.mark.parametrize('reload', [False, True])
+    def test_compacted_base_stays_interned(self, reload):
+        items = self.items()
+        base = simtrie.Dict(items, intern_values=True)
+        if reload:
+            base = simtrie.Dict.load(base.tobytes())
+        d = simtrie.MutableDict(base)
+        d['zz'] = 'TAG1'
+        d.compact(wait=True)
+        items['zz'] = 'TAG1'
+        expected = simtrie.Dict(items, intern_values=True)
+        assert len(d.base.tobytes()) == len(expected.tobytes())
+        assert dict(d.base.items()) == items
+
+
+class TestPrefixCount(object):
+
+    def keys(self):
+        return list(KEYS)
+
+    def prefixes(self, keys):
+        return ['', 'a', 'ab', 'é', 'abc', 'x', 'abcdéa', keys[5], keys[5] + 'x', b'ab']
+
+    def expected(self, keys, prefix):
+        if isinstance(prefix, bytes):
+            prefix = prefix.decode('utf8')
+        return sum(1 for key in keys if key.startswith(prefix))
+
+    def test_count(self):
+        keys = self.keys()
+        prefixes = self.prefixes(keys)
+        expected = [self.expected(keys, prefix) for prefix in prefixes]
+        for options in ({}, {'ranks': True}, {'ranks': True, 'wide': True},
+                        {'ranks': True, 'succinct': True}, {'ranks': True, 'interleaved': True}):
+            s = simtrie.Set(keys, **options)
+            assert [s.count(prefix) for prefix in prefixes] == expected
+            assert list(s.count_many(prefixes)) == expected
+            assert [s.has_keys_with_prefix(prefix) for prefix in prefixes] == [n > 0 for n in expected]
+
+    def test_empty(self):
+        for options in ({}, {'ranks': True}):
+            s = simtrie.Set([], **options)
+            assert s.count() == 0 and s.count('a') == 0
+            assert list(s.count_many(['', 'a'])) == [0, 0]
+            assert not s.has_keys_with_prefix('')
+
+
+class TestKeyRange(object):
+
+    def keys(self):
+        return list(KEYS)
+
+    def expected(self, keys, prefix='', start=None, stop=None, limit=None):
+        result = [key for key in keys if key.startswith(prefix)
+                  and (start is None or key >= start) and (stop is None or key < stop)]
+        return result[:limit]
+
+    def test_range(self):
+        keys = self.keys()
+        bounds = [None, '', 'a', 'abc', 'abé', 'b\x00', 'c' + chr(0x10ffff), 'é', 'éééééé', 'z', keys[100]]
+        for options in ({}, {'wide': True}, {'succinct': True}, {'interleaved': True}):
+            s = simtrie.Set(keys, **options)
+            for prefix in ('', 'a', 'ab', 'x'):
+                for start in bounds:
+                    for stop in bounds[::3]:
+                        assert list(s.keys(prefix, start=start, stop=stop)) == \
+                            self.expected(keys, prefix, start, stop)
+                    assert list(s.keys(prefix, start=start, limit=7)) == \
+                        self.expected(keys, prefix, start, limit=7)
+
+    def test_cursor(self):
+        keys = self.keys()
+        for options in ({}, {'wide': True}, {'succinct': True}, {'interleaved': True}):
+            s = simtrie.Set(keys, **options)
+            pages, cursor = [], ''
+            while cursor is not None:
+                it = s.keys(start=cursor, stop='d', limit=100)
+                pages.append(list(it))
+                cursor = it.cursor
+            assert sum(pages, []) == self.expected(keys, stop='d')
+            assert all(len(page) == 100 for page in pages[:-1])
+
+    def test_dict(self):
+        keys = self.keys()
+        d = simtrie.Dict((key, i) for i, key in enumerate(keys))
+        it = d.items('a', start='ab', limit=3)
+        assert list(it) == [(key, keys.index(key)) for key in self.expected(keys, 'a', 'ab', limit=3)]
+        assert it.cursor == self.expected(keys, 'a', 'ab')[3]
+        assert list(d.values(stop='ab')) == list(range(len(self.expected(keys, stop='ab'))))
+
+    def test_empty(self):
+        it = simtrie.Set([]).keys(start='a', limit=10)
+        assert list(it) == [] and it.cursor is None
+        assert list(simtrie.Set(['a']).keys(limit=0)) == []
+        with pytest.raises(ValueError):
+            simtrie.Set(['a']).keys(limit=-1)